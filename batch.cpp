@@ -0,0 +1,390 @@
+#include "batch.hpp"
+#include "simd.hpp"
+
+namespace NEWTON {
+
+static inline Vector3 get( const ConstVector3Span& s, size_t i )
+{
+    size_t o = s.offset( i );
+    return Vector3( s.x[o], s.y[o], s.z[o] );
+}
+
+static inline void put( const Vector3Span& s, size_t i, const Vector3& v )
+{
+    size_t o = s.offset( i );
+    s.x[o] = v.x;
+    s.y[o] = v.y;
+    s.z[o] = v.z;
+}
+
+static inline bool sphere_visible( const Vector4* planes, size_t num_planes, const Vector3& c, real_t r )
+{
+    for ( size_t p = 0; p < num_planes; ++p )
+        if ( planes[p].x * c.x + planes[p].y * c.y + planes[p].z * c.z + planes[p].w < -r )
+            return false;
+    return true;
+}
+
+// scalar kernels; also used for the tails of the SIMD ones
+
+static void scalar_transform_points( const Matrix4& m, ConstVector3Span in, Vector3Span out, size_t begin )
+{
+    for ( size_t i = begin; i < in.size; ++i )
+        put( out, i, m.transform_point( get( in, i ) ) );
+}
+
+static void scalar_transform_vectors( const Matrix4& m, ConstVector3Span in, Vector3Span out, size_t begin )
+{
+    for ( size_t i = begin; i < in.size; ++i )
+        put( out, i, m.transform_vector( get( in, i ) ) );
+}
+
+static void scalar_rotate( const Quaternion& q, ConstVector3Span in, Vector3Span out, size_t begin )
+{
+    for ( size_t i = begin; i < in.size; ++i )
+        put( out, i, q * get( in, i ) );
+}
+
+static void scalar_normalize( ConstVector3Span in, Vector3Span out, size_t begin )
+{
+    for ( size_t i = begin; i < in.size; ++i )
+        put( out, i, normalize( get( in, i ) ) );
+}
+
+static void scalar_dot( ConstVector3Span a, ConstVector3Span b, real_t* out, size_t begin )
+{
+    for ( size_t i = begin; i < a.size; ++i )
+        out[i] = dot( get( a, i ), get( b, i ) );
+}
+
+static void scalar_cross( ConstVector3Span a, ConstVector3Span b, Vector3Span out, size_t begin )
+{
+    for ( size_t i = begin; i < a.size; ++i )
+        put( out, i, cross( get( a, i ), get( b, i ) ) );
+}
+
+static void scalar_relative_to_float( ConstVector3Span in, const Vector3& origin, float* out, size_t begin )
+{
+    for ( size_t i = begin; i < in.size; ++i ) {
+        Vector3 p = get( in, i ) - origin;
+        out[3 * i + 0] = float( p.x );
+        out[3 * i + 1] = float( p.y );
+        out[3 * i + 2] = float( p.z );
+    }
+}
+
+static size_t scalar_spheres_in_frustum( const Vector4* planes, size_t num_planes,
+                                         ConstVector3Span center, const real_t* radius,
+                                         unsigned char* visible, size_t begin )
+{
+    size_t count = 0;
+    for ( size_t i = begin; i < center.size; ++i ) {
+        visible[i] = sphere_visible( planes, num_planes, get( center, i ), radius[i] ) ? 1 : 0;
+        count += visible[i];
+    }
+    return count;
+}
+
+#if SIMD_HAVE_AVX2
+
+// Four consecutive elements of a span can be loaded as one vector when
+// they never straddle a block.
+template<typename P>
+static inline bool is_packed( const BasicVector3Span<P>& s )
+{
+    return s.lanes >= s.size || s.lanes % 4 == 0;
+}
+
+SIMD_AVX2 static inline __m256d load4( const real_t* p, const ConstVector3Span& s, size_t i, bool packed )
+{
+    if ( packed )
+        return _mm256_loadu_pd( p + s.offset( i ) );
+    return _mm256_set_pd( p[s.offset( i + 3 )], p[s.offset( i + 2 )], p[s.offset( i + 1 )], p[s.offset( i )] );
+}
+
+SIMD_AVX2 static inline void store4( real_t* p, const Vector3Span& s, size_t i, bool packed, __m256d v )
+{
+    if ( packed ) {
+        _mm256_storeu_pd( p + s.offset( i ), v );
+        return;
+    }
+    real_t tmp[4];
+    _mm256_storeu_pd( tmp, v );
+    for ( size_t k = 0; k < 4; ++k )
+        p[s.offset( i + k )] = tmp[k];
+}
+
+// a*x + b*y + c*z + d with scalar coefficients
+SIMD_AVX2 static inline __m256d affine4( real_t a, real_t b, real_t c, real_t d, __m256d x, __m256d y, __m256d z )
+{
+    __m256d r = _mm256_fmadd_pd( _mm256_set1_pd( a ), x, _mm256_set1_pd( d ) );
+    r = _mm256_fmadd_pd( _mm256_set1_pd( b ), y, r );
+    return _mm256_fmadd_pd( _mm256_set1_pd( c ), z, r );
+}
+
+SIMD_AVX2 static void avx2_transform_points( const Matrix4& m, ConstVector3Span in, Vector3Span out )
+{
+    bool pin = is_packed( in ), pout = is_packed( out );
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd( 1.0 );
+    size_t n4 = in.size & ~size_t( 3 );
+    for ( size_t i = 0; i < n4; i += 4 ) {
+        __m256d x = load4( in.x, in, i, pin );
+        __m256d y = load4( in.y, in, i, pin );
+        __m256d z = load4( in.z, in, i, pin );
+        __m256d rx = affine4( m._m[0][0], m._m[1][0], m._m[2][0], m._m[3][0], x, y, z );
+        __m256d ry = affine4( m._m[0][1], m._m[1][1], m._m[2][1], m._m[3][1], x, y, z );
+        __m256d rz = affine4( m._m[0][2], m._m[1][2], m._m[2][2], m._m[3][2], x, y, z );
+        __m256d rw = affine4( m._m[0][3], m._m[1][3], m._m[2][3], m._m[3][3], x, y, z );
+        // project(): divide by w unless it is zero
+        rw = _mm256_blendv_pd( rw, one, _mm256_cmp_pd( rw, zero, _CMP_EQ_OQ ) );
+        __m256d winv = _mm256_div_pd( one, rw );
+        store4( out.x, out, i, pout, _mm256_mul_pd( rx, winv ) );
+        store4( out.y, out, i, pout, _mm256_mul_pd( ry, winv ) );
+        store4( out.z, out, i, pout, _mm256_mul_pd( rz, winv ) );
+    }
+    scalar_transform_points( m, in, out, n4 );
+}
+
+SIMD_AVX2 static void avx2_transform_vectors( const Matrix4& m, ConstVector3Span in, Vector3Span out )
+{
+    bool pin = is_packed( in ), pout = is_packed( out );
+    size_t n4 = in.size & ~size_t( 3 );
+    for ( size_t i = 0; i < n4; i += 4 ) {
+        __m256d x = load4( in.x, in, i, pin );
+        __m256d y = load4( in.y, in, i, pin );
+        __m256d z = load4( in.z, in, i, pin );
+        store4( out.x, out, i, pout, affine4( m._m[0][0], m._m[1][0], m._m[2][0], 0, x, y, z ) );
+        store4( out.y, out, i, pout, affine4( m._m[0][1], m._m[1][1], m._m[2][1], 0, x, y, z ) );
+        store4( out.z, out, i, pout, affine4( m._m[0][2], m._m[1][2], m._m[2][2], 0, x, y, z ) );
+    }
+    scalar_transform_vectors( m, in, out, n4 );
+}
+
+// a × b, one component: a1*b2 - a2*b1
+SIMD_AVX2 static inline __m256d cross_component( __m256d a1, __m256d b2, __m256d a2, __m256d b1 )
+{
+    return _mm256_fmsub_pd( a1, b2, _mm256_mul_pd( a2, b1 ) );
+}
+
+SIMD_AVX2 static void avx2_rotate( const Quaternion& q, ConstVector3Span in, Vector3Span out )
+{
+    // same formula as Quaternion::operator*( const Vector3& )
+    bool pin = is_packed( in ), pout = is_packed( out );
+    const __m256d qx = _mm256_set1_pd( q.x ), qy = _mm256_set1_pd( q.y ), qz = _mm256_set1_pd( q.z );
+    const __m256d w2 = _mm256_set1_pd( 2.0 * q.w ), two = _mm256_set1_pd( 2.0 );
+    size_t n4 = in.size & ~size_t( 3 );
+    for ( size_t i = 0; i < n4; i += 4 ) {
+        __m256d x = load4( in.x, in, i, pin );
+        __m256d y = load4( in.y, in, i, pin );
+        __m256d z = load4( in.z, in, i, pin );
+        __m256d ux = cross_component( qy, z, qz, y );
+        __m256d uy = cross_component( qz, x, qx, z );
+        __m256d uz = cross_component( qx, y, qy, x );
+        __m256d uux = cross_component( qy, uz, qz, uy );
+        __m256d uuy = cross_component( qz, ux, qx, uz );
+        __m256d uuz = cross_component( qx, uy, qy, ux );
+        store4( out.x, out, i, pout, _mm256_fmadd_pd( two, uux, _mm256_fmadd_pd( w2, ux, x ) ) );
+        store4( out.y, out, i, pout, _mm256_fmadd_pd( two, uuy, _mm256_fmadd_pd( w2, uy, y ) ) );
+        store4( out.z, out, i, pout, _mm256_fmadd_pd( two, uuz, _mm256_fmadd_pd( w2, uz, z ) ) );
+    }
+    scalar_rotate( q, in, out, n4 );
+}
+
+SIMD_AVX2 static void avx2_normalize( ConstVector3Span in, Vector3Span out )
+{
+    bool pin = is_packed( in ), pout = is_packed( out );
+    const __m256d one = _mm256_set1_pd( 1.0 );
+    size_t n4 = in.size & ~size_t( 3 );
+    for ( size_t i = 0; i < n4; i += 4 ) {
+        __m256d x = load4( in.x, in, i, pin );
+        __m256d y = load4( in.y, in, i, pin );
+        __m256d z = load4( in.z, in, i, pin );
+        __m256d d = _mm256_fmadd_pd( z, z, _mm256_fmadd_pd( y, y, _mm256_mul_pd( x, x ) ) );
+        __m256d inv = _mm256_div_pd( one, _mm256_sqrt_pd( d ) );
+        store4( out.x, out, i, pout, _mm256_mul_pd( x, inv ) );
+        store4( out.y, out, i, pout, _mm256_mul_pd( y, inv ) );
+        store4( out.z, out, i, pout, _mm256_mul_pd( z, inv ) );
+    }
+    scalar_normalize( in, out, n4 );
+}
+
+SIMD_AVX2 static void avx2_dot( ConstVector3Span a, ConstVector3Span b, real_t* out )
+{
+    bool pa = is_packed( a ), pb = is_packed( b );
+    size_t n4 = a.size & ~size_t( 3 );
+    for ( size_t i = 0; i < n4; i += 4 ) {
+        __m256d d = _mm256_mul_pd( load4( a.x, a, i, pa ), load4( b.x, b, i, pb ) );
+        d = _mm256_fmadd_pd( load4( a.y, a, i, pa ), load4( b.y, b, i, pb ), d );
+        d = _mm256_fmadd_pd( load4( a.z, a, i, pa ), load4( b.z, b, i, pb ), d );
+        _mm256_storeu_pd( out + i, d );
+    }
+    scalar_dot( a, b, out, n4 );
+}
+
+SIMD_AVX2 static void avx2_cross( ConstVector3Span a, ConstVector3Span b, Vector3Span out )
+{
+    bool pa = is_packed( a ), pb = is_packed( b ), pout = is_packed( out );
+    size_t n4 = a.size & ~size_t( 3 );
+    for ( size_t i = 0; i < n4; i += 4 ) {
+        __m256d ax = load4( a.x, a, i, pa ), ay = load4( a.y, a, i, pa ), az = load4( a.z, a, i, pa );
+        __m256d bx = load4( b.x, b, i, pb ), by = load4( b.y, b, i, pb ), bz = load4( b.z, b, i, pb );
+        store4( out.x, out, i, pout, cross_component( ay, bz, az, by ) );
+        store4( out.y, out, i, pout, cross_component( az, bx, ax, bz ) );
+        store4( out.z, out, i, pout, cross_component( ax, by, ay, bx ) );
+    }
+    scalar_cross( a, b, out, n4 );
+}
+
+SIMD_AVX2 static void avx2_relative_to_float( ConstVector3Span in, const Vector3& origin, float* out )
+{
+    bool pin = is_packed( in );
+    const __m256d ox = _mm256_set1_pd( origin.x ), oy = _mm256_set1_pd( origin.y ), oz = _mm256_set1_pd( origin.z );
+    size_t n4 = in.size & ~size_t( 3 );
+    for ( size_t i = 0; i < n4; i += 4 ) {
+        float fx[4], fy[4], fz[4];
+        _mm_storeu_ps( fx, _mm256_cvtpd_ps( _mm256_sub_pd( load4( in.x, in, i, pin ), ox ) ) );
+        _mm_storeu_ps( fy, _mm256_cvtpd_ps( _mm256_sub_pd( load4( in.y, in, i, pin ), oy ) ) );
+        _mm_storeu_ps( fz, _mm256_cvtpd_ps( _mm256_sub_pd( load4( in.z, in, i, pin ), oz ) ) );
+        float* o = out + 3 * i;
+        for ( size_t k = 0; k < 4; ++k ) {
+            o[3 * k + 0] = fx[k];
+            o[3 * k + 1] = fy[k];
+            o[3 * k + 2] = fz[k];
+        }
+    }
+    scalar_relative_to_float( in, origin, out, n4 );
+}
+
+SIMD_AVX2 static size_t avx2_spheres_in_frustum( const Vector4* planes, size_t num_planes,
+                                                  ConstVector3Span center, const real_t* radius,
+                                                  unsigned char* visible )
+{
+    bool pc = is_packed( center );
+    const __m256d zero = _mm256_setzero_pd();
+    size_t count = 0;
+    size_t n4 = center.size & ~size_t( 3 );
+    for ( size_t i = 0; i < n4; i += 4 ) {
+        __m256d x = load4( center.x, center, i, pc );
+        __m256d y = load4( center.y, center, i, pc );
+        __m256d z = load4( center.z, center, i, pc );
+        __m256d r = _mm256_loadu_pd( radius + i );
+        int inside = 0xF;
+        for ( size_t p = 0; p < num_planes; ++p ) {
+            const Vector4& pl = planes[p];
+            __m256d d = _mm256_add_pd( affine4( pl.x, pl.y, pl.z, pl.w, x, y, z ), r );
+            inside &= _mm256_movemask_pd( _mm256_cmp_pd( d, zero, _CMP_GE_OQ ) );
+        }
+        for ( size_t k = 0; k < 4; ++k ) {
+            visible[i + k] = ( inside >> k ) & 1;
+            count += visible[i + k];
+        }
+    }
+    return count + scalar_spheres_in_frustum( planes, num_planes, center, radius, visible, n4 );
+}
+
+#endif /* SIMD_HAVE_AVX2 */
+
+// dispatch
+
+const char* batch_isa()
+{
+    return use_avx2() ? "avx2" : "scalar";
+}
+
+void batch_transform_points( const Matrix4& m, ConstVector3Span in, Vector3Span out )
+{
+    assert( in.size == out.size );
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() )
+        return avx2_transform_points( m, in, out );
+#endif
+    scalar_transform_points( m, in, out, 0 );
+}
+
+void batch_transform_vectors( const Matrix4& m, ConstVector3Span in, Vector3Span out )
+{
+    assert( in.size == out.size );
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() )
+        return avx2_transform_vectors( m, in, out );
+#endif
+    scalar_transform_vectors( m, in, out, 0 );
+}
+
+void batch_rotate( const Quaternion& q, ConstVector3Span in, Vector3Span out )
+{
+    assert( in.size == out.size );
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() )
+        return avx2_rotate( q, in, out );
+#endif
+    scalar_rotate( q, in, out, 0 );
+}
+
+void batch_normalize( ConstVector3Span in, Vector3Span out )
+{
+    assert( in.size == out.size );
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() )
+        return avx2_normalize( in, out );
+#endif
+    scalar_normalize( in, out, 0 );
+}
+
+void batch_dot( ConstVector3Span a, ConstVector3Span b, real_t* out )
+{
+    assert( a.size == b.size );
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() )
+        return avx2_dot( a, b, out );
+#endif
+    scalar_dot( a, b, out, 0 );
+}
+
+void batch_cross( ConstVector3Span a, ConstVector3Span b, Vector3Span out )
+{
+    assert( a.size == b.size && a.size == out.size );
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() )
+        return avx2_cross( a, b, out );
+#endif
+    scalar_cross( a, b, out, 0 );
+}
+
+void batch_relative_to_float( ConstVector3Span in, const Vector3& origin, float* out )
+{
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() )
+        return avx2_relative_to_float( in, origin, out );
+#endif
+    scalar_relative_to_float( in, origin, out, 0 );
+}
+
+size_t batch_spheres_in_frustum( const Vector4* planes, size_t num_planes,
+                                 ConstVector3Span center, const real_t* radius,
+                                 unsigned char* visible )
+{
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() )
+        return avx2_spheres_in_frustum( planes, num_planes, center, radius, visible );
+#endif
+    return scalar_spheres_in_frustum( planes, num_planes, center, radius, visible, 0 );
+}
+
+void frustum_side_planes( const Matrix4& clip, Vector4 planes[4] )
+{
+    // Gribb & Hartmann: each plane is the w row plus or minus the x or y row
+    Vector4 rows[4];
+    for ( int r = 0; r < 4; ++r )
+        rows[r] = Vector4( clip( 0, r ), clip( 1, r ), clip( 2, r ), clip( 3, r ) );
+
+    planes[0] = rows[3] + rows[0]; // left
+    planes[1] = rows[3] - rows[0]; // right
+    planes[2] = rows[3] + rows[1]; // bottom
+    planes[3] = rows[3] - rows[1]; // top
+    for ( int p = 0; p < 4; ++p )
+        planes[p] /= length( planes[p].xyz() );
+}
+
+} /* NEWTON */
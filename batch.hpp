@@ -0,0 +1,158 @@
+#ifndef _BATCH_HPP_
+#define _BATCH_HPP_
+
+#include <vector>
+
+#include "math.hpp"
+#include "matrix.hpp"
+#include "quaternion.hpp"
+#include "vector.hpp"
+
+namespace NEWTON {
+
+/*
+Batched versions of the Vector3/Quaternion/Matrix4 operations, applied
+to whole spans of vectors at once.
+
+A span names where the x, y and z of its first element live and how the
+rest follow. Elements come in blocks of `lanes` consecutive scalars per
+component, with `stride` scalars from one block to the next, so the
+same kernels read:
+  - SoA (separate x, y and z arrays): one block of `size` lanes,
+  - AoSoA (x[4] y[4] z[4] x[4] ...): lanes = 4, stride = 12,
+  - AoS (Vector3 or any struct holding one): lanes = 1, stride = the
+    struct size in scalars.
+
+The kernels are selected once at runtime: an AVX2/FMA version handles
+four doubles per instruction on CPUs that support it, otherwise plain
+scalar loops are used. Spans whose blocks are a multiple of four lanes
+(or a single block) are loaded directly; AoS spans are gathered.
+
+Input and output spans may be the same span but must not otherwise
+overlap.
+*/
+
+template<typename P>
+struct BasicVector3Span
+{
+    P x, y, z;
+    size_t size;
+    size_t lanes;   // consecutive elements per block
+    size_t stride;  // scalars from the start of one block to the next
+
+    // Offset, in scalars, of element i from x (or y, or z).
+    size_t offset( size_t i ) const {
+        return ( i / lanes ) * stride + i % lanes;
+    }
+
+    // A writable span can always be read from.
+    operator BasicVector3Span< const real_t* >() const {
+        BasicVector3Span< const real_t* > rv = { x, y, z, size, lanes, stride };
+        return rv;
+    }
+};
+
+typedef BasicVector3Span< real_t* > Vector3Span;
+typedef BasicVector3Span< const real_t* > ConstVector3Span;
+
+// Separate x, y and z arrays of n scalars each.
+inline Vector3Span soa_span( real_t* x, real_t* y, real_t* z, size_t n ) {
+    Vector3Span rv = { x, y, z, n, n > 0 ? n : 1, n };
+    return rv;
+}
+
+// Blocks of `lanes` x's, then y's, then z's, starting at base.
+inline Vector3Span aosoa_span( real_t* base, size_t n, size_t lanes ) {
+    Vector3Span rv = { base, base + lanes, base + 2 * lanes, n, lanes, 3 * lanes };
+    return rv;
+}
+
+// n Vector3s, each stride bytes after the previous, e.g. a member of an
+// array of structs. stride must be a multiple of sizeof(real_t).
+inline ConstVector3Span aos_span( const Vector3* first, size_t stride, size_t n ) {
+    assert( stride % sizeof( real_t ) == 0 );
+    const real_t* p = &first->x;
+    ConstVector3Span rv = { p, p + 1, p + 2, n, 1, stride / sizeof( real_t ) };
+    return rv;
+}
+
+inline Vector3Span aos_span( Vector3* first, size_t stride, size_t n ) {
+    assert( stride % sizeof( real_t ) == 0 );
+    real_t* p = &first->x;
+    Vector3Span rv = { p, p + 1, p + 2, n, 1, stride / sizeof( real_t ) };
+    return rv;
+}
+
+// Elements [begin, begin + n) of s. begin must be the start of a block
+// unless s is a single block.
+template<typename P>
+inline BasicVector3Span<P> subspan( const BasicVector3Span<P>& s, size_t begin, size_t n ) {
+    assert( begin % s.lanes == 0 || s.lanes >= s.size );
+    size_t o = s.offset( begin );
+    BasicVector3Span<P> rv = { s.x + o, s.y + o, s.z + o, n, s.lanes, s.stride };
+    return rv;
+}
+
+// Owning SoA storage.
+class Vector3Array
+{
+public:
+    Vector3Array() {}
+    explicit Vector3Array( size_t n ) { resize( n ); }
+
+    void resize( size_t n ) { x.resize( n ); y.resize( n ); z.resize( n ); }
+    size_t size() const { return x.size(); }
+
+    Vector3 get( size_t i ) const { return Vector3( x[i], y[i], z[i] ); }
+    void set( size_t i, const Vector3& v ) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+
+    Vector3Span span() {
+        return size() ? soa_span( &x[0], &y[0], &z[0], size() ) : soa_span( 0, 0, 0, 0 );
+    }
+    ConstVector3Span span() const {
+        return const_cast<Vector3Array*>( this )->span();
+    }
+
+    std::vector<real_t> x, y, z;
+};
+
+// out[i] = m.transform_point( in[i] )
+void batch_transform_points( const Matrix4& m, ConstVector3Span in, Vector3Span out );
+
+// out[i] = m.transform_vector( in[i] )
+void batch_transform_vectors( const Matrix4& m, ConstVector3Span in, Vector3Span out );
+
+// out[i] = q * in[i]
+void batch_rotate( const Quaternion& q, ConstVector3Span in, Vector3Span out );
+
+// out[i] = normalize( in[i] )
+void batch_normalize( ConstVector3Span in, Vector3Span out );
+
+// out[i] = dot( a[i], b[i] )
+void batch_dot( ConstVector3Span a, ConstVector3Span b, real_t* out );
+
+// out[i] = cross( a[i], b[i] )
+void batch_cross( ConstVector3Span a, ConstVector3Span b, Vector3Span out );
+
+// Writes in[i] - origin as interleaved float triples, out[3*i .. 3*i+2].
+void batch_relative_to_float( ConstVector3Span in, const Vector3& origin, float* out );
+
+// Sets visible[i] to 1 if the sphere at center[i] with radius[i] is on the
+// inner side of every plane, 0 otherwise. A plane (a,b,c,d) keeps points
+// with a*x + b*y + c*z + d >= 0. Returns the number of visible spheres.
+size_t batch_spheres_in_frustum( const Vector4* planes, size_t num_planes,
+                                 ConstVector3Span center, const real_t* radius,
+                                 unsigned char* visible );
+
+// Extracts the four side planes of the view frustum from a combined
+// projection * modelview matrix, normalized so plane distances are in
+// world units. Near and far are left out since they are degenerate for
+// an infinite projection.
+void frustum_side_planes( const Matrix4& clip, Vector4 planes[4] );
+
+// Name of the kernel set picked for this CPU, e.g. "avx2".
+const char* batch_isa();
+
+} /* NEWTON */
+
+#endif /* _BATCH_HPP_ */
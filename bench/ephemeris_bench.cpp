@@ -0,0 +1,87 @@
+/*
+Cost and accuracy of ChebyshevEphemeris.
+
+The game's inner solar system and Jupiter are fitted over two years,
+once from scratch and once reopened from the file the first call
+wrote. The fit is then compared every hour against a separate RK4
+integration in ten-minute steps, the same step the fit was sampled
+with, so the figures are the error of the fit itself. Finally it
+times random lookups.
+
+    g++ -O2 -std=c++14 -pthread -I.. ephemeris_bench.cpp \
+        ../chebyshev_ephemeris.cpp ../system.cpp ../integrator.cpp \
+        ../vector.cpp ../batch.cpp ../matrix.cpp ../quaternion.cpp \
+        -o ephemeris_bench
+    ./ephemeris_bench [file]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include "chebyshev_ephemeris.hpp"
+
+using namespace NEWTON;
+
+int main( int argc, char** argv )
+{
+    const char* path = argc > 1 ? argv[1] : "ephemeris_bench.cache";
+    const real_t duration = 2 * 365.25 * 86400, interval = 4 * 86400, step = 600;
+    const size_t degree = 13, lookups = 1000000;
+
+    System sys;
+    RungeKuttaIntegrator integrator;
+    sys.add_body( 1.989e30, Vector3( 0.0, 0.0, 0.0 ), Vector3( 0.0, 0.0, 0.0 ) );
+    sys.add_body( 3.3022e23, Vector3( 6.9817e10, 0.0, 0.0 ), Vector3( 0.0, 3.886e4, 0.0 ) );
+    sys.add_body( 4.8676e24, Vector3( 1.0894e11, 0.0, 0.0 ), Vector3( 0.0, 3.479e4, 0.0 ) );
+    sys.add_body( 5.97219e24, Vector3( 1.5210e11, 0.0, 0.0 ), Vector3( 0.0, 2.9300e4, 0.0 ) );
+    sys.add_body( 7.3477e22, Vector3( 1.5210e11 + 4.054e8, 0.0, 0.0 ), Vector3( 0.0, 2.9300e4 + 9.64e2, 0.0 ) );
+    sys.add_body( 6.4185e23, Vector3( 2.492e11, 0.0, 0.0 ), Vector3( 0.0, 2.1977e4, 0.0 ) );
+    sys.add_body( 1.89813e27, Vector3( 8.1652e11, 0.0, 0.0 ), Vector3( 0.0, 1.2435e4, 0.0 ) );
+    const char* names[] = { "Sun", "Mercury", "Venus", "Earth", "Moon", "Mars", "Jupiter" };
+
+    std::remove( path );
+    ChebyshevEphemeris ephemeris;
+    auto start = std::chrono::steady_clock::now();
+    if ( !ephemeris.open( path, sys, integrator, duration, interval, degree, step ) )
+        return 1;
+    std::chrono::duration<double> built = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    if ( !ephemeris.open( path, sys, integrator, duration, interval, degree, step ) )
+        return 1;
+    std::chrono::duration<double> reopened = std::chrono::steady_clock::now() - start;
+    std::printf( "%zu bodies over %.0f days: built in %.2f s, reopened in %.2f ms\n",
+                 ephemeris.get_bodies().size(), duration / 86400, built.count(), 1e3 * reopened.count() );
+
+    std::vector< real_t > worst_pos( sys.bodies.size(), 0 ), worst_vel( sys.bodies.size(), 0 );
+    System reference = sys;
+    while ( reference.time + 3600 <= ephemeris.end_time() ) {
+        for ( int k = 0; k < 6; ++k )
+            integrator.integrate( reference, step );
+        for ( size_t b = 0; b < sys.bodies.size(); ++b ) {
+            Vector3 p, v;
+            ephemeris.state( b, reference.time, p, v );
+            worst_pos[b] = std::max( worst_pos[b], length( p - reference.bodies[b].position ) );
+            worst_vel[b] = std::max( worst_vel[b], length( v - reference.bodies[b].velocity ) );
+        }
+    }
+    for ( size_t b = 0; b < sys.bodies.size(); ++b )
+        std::printf( "%-8s worst %.3g m, %.3g m/s\n", names[b], worst_pos[b], worst_vel[b] );
+
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution<double> u( ephemeris.start_time(), ephemeris.end_time() );
+    std::vector< real_t > times( lookups );
+    for ( size_t k = 0; k < lookups; ++k )
+        times[k] = u( rng );
+    real_t sum = 0;
+    start = std::chrono::steady_clock::now();
+    for ( size_t k = 0; k < lookups; ++k ) {
+        Vector3 p, v;
+        ephemeris.state( k % sys.bodies.size(), times[k], p, v );
+        sum += p.x + v.x;
+    }
+    std::chrono::duration<double> looked = std::chrono::steady_clock::now() - start;
+    std::printf( "%.0f ns per lookup (checksum %g)\n", 1e9 * looked.count() / lookups, sum );
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+Timing accuracy of EventLocator.
+
+A test particle on an orbit with e = 0.6 about a single mass is
+integrated for ten orbits, from periapsis, at a fixed number of steps
+per orbit. The locator reports its apsides (ApsisEvent) and its
+crossings of r = a (DistanceEvent). Periapsis and apoapsis lie at mean
+anomaly 0 and pi, and r = a (1 - e cos E) gives the eccentric anomaly
+of the crossings, so Kepler's equation gives the time of each.
+
+Two errors are reported, in units of the period. "ideal" is against
+the exact orbit, and includes the integrator's own drift along it.
+"step" is against the conic osculating at the start of the event's
+step, which the integrated orbit follows closely within one step; that
+is the error of the locator itself (the interpolant and the root
+finding).
+
+    g++ -O2 -std=c++14 -pthread -I.. event_bench.cpp ../event.cpp \
+        ../kepler.cpp ../batch.cpp ../matrix.cpp ../quaternion.cpp \
+        ../system.cpp ../integrator.cpp ../vector.cpp -o event_bench
+    ./event_bench [steps per orbit]
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "event.hpp"
+#include "kepler.hpp"
+
+using namespace NEWTON;
+
+static const int ORBITS = 10;
+
+// mean anomaly at which an event falls within an orbit of semi-major
+// axis a_orbit and eccentricity e, r = radius for the distance event
+static real_t event_anomaly( const EventRecord& r, real_t a_orbit, real_t e, real_t radius )
+{
+    if ( r.event == 0 )
+        return r.rising ? 0 : PI;
+    // r = a (1 - e cos E)
+    real_t E = std::acos( ( 1 - radius / a_orbit ) / e );
+    if ( !r.rising )
+        E = 2 * PI - E;
+    return E - e * std::sin( E );
+}
+
+static void run( const char* name, const Integrator& integrator, size_t steps_per_orbit )
+{
+    const real_t mass = 5.97219e24, a = 2e7, e = 0.6;
+    const real_t mu = G * mass;
+    const real_t period = 2 * PI * std::sqrt( a * a * a / mu );
+    const real_t rp = a * ( 1 - e ), vp = std::sqrt( mu * ( 1 + e ) / rp );
+
+    System sys;
+    sys.add_body( mass, Vector3::Zero, Vector3::Zero );
+    sys.add_body( 0, Vector3( rp, 0.0, 0.0 ), Vector3( 0.0, vp, 0.0 ), false );
+
+    ApsisEvent apsis( 1, 0 );
+    DistanceEvent mean_distance( 1, 0, a );
+    EventLocator events;
+    events.set_time_tolerance( 1e-9 * period );
+    events.add( &apsis );
+    events.add( &mean_distance );
+
+    real_t ideal[2] = { 0, 0 }, step[2] = { 0, 0 };
+    size_t count[2] = { 0, 0 };
+    std::vector< EventRecord > records;
+    real_t dt = period / real_t( steps_per_orbit );
+    for ( size_t s = 0; s < ORBITS * steps_per_orbit; ++s ) {
+        real_t t0 = sys.time;
+        OrbitalElements el = osculating_elements( sys, 1, 0 );
+        real_t n = std::sqrt( el.mu / ( el.semi_major_axis * el.semi_major_axis * el.semi_major_axis ) );
+        records.clear();
+        events.step( integrator, sys, dt, records );
+        for ( size_t k = 0; k < records.size(); ++k ) {
+            const EventRecord& r = records[k];
+            real_t m = event_anomaly( r, a, e, a );
+            // nearest orbit with an event of this kind
+            real_t orbit = std::floor( r.time / period - m / ( 2 * PI ) + real_t( 0.5 ) );
+            real_t expected = ( orbit + m / ( 2 * PI ) ) * period;
+            ideal[r.event] = std::max( ideal[r.event], std::fabs( r.time - expected ) / period );
+            // the same anomaly, next reached on the osculating conic
+            real_t m_osc = event_anomaly( r, el.semi_major_axis, el.eccentricity, a );
+            real_t dm = std::fmod( m_osc - el.mean_anomaly, 2 * PI );
+            if ( dm < -PI )
+                dm += 2 * PI;
+            else if ( dm > PI )
+                dm -= 2 * PI;
+            step[r.event] = std::max( step[r.event], std::fabs( r.time - ( t0 + dm / n ) ) / period );
+            ++count[r.event];
+        }
+    }
+    std::printf( "%-10s %6zu %10.3g %10.3g %6zu %10.3g %10.3g\n",
+                 name, count[0], ideal[0], step[0], count[1], ideal[1], step[1] );
+}
+
+int main( int argc, char** argv )
+{
+    size_t steps = argc > 1 ? std::strtoul( argv[1], 0, 10 ) : 200;
+    std::printf( "e = 0.6, %d orbits, %zu steps per orbit: worst error / period\n", ORBITS, steps );
+    std::printf( "%-10s %6s %10s %10s %6s %10s %10s\n", "", "apses", "ideal", "step", "r = a", "ideal", "step" );
+    RungeKuttaIntegrator rk;
+    LeapfrogIntegrator leapfrog;
+    run( "rk4", rk, steps );
+    run( "leapfrog", leapfrog, steps );
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+Accuracy and scaling of FmmGravity.
+
+Accuracy: for each expansion order, the RMS and largest relative error
+of the accelerations of a uniform random cluster against the direct sum
+in System, at theta 0.3, 0.5 and 0.7.
+
+Scaling: time per body of one evaluation at order 4, theta 0.5 as N
+grows by factors of four, next to the tiled direct sum while that is
+still affordable. Per-body time staying flat means O(N); below about
+16k bodies it is lower because bodies near the edge of a small cluster
+have fewer far cells to interact with.
+
+    g++ -O2 -std=c++14 -pthread -I.. fmm_bench.cpp ../fmm_gravity.cpp \
+        ../tiled_gravity.cpp ../cache_info.cpp ../system.cpp \
+        ../integrator.cpp ../vector.cpp -o fmm_bench
+    ./fmm_bench [accuracy bodies] [largest scaling N]
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "fmm_gravity.hpp"
+#include "tiled_gravity.hpp"
+
+using namespace NEWTON;
+
+static void build( System& sys, size_t n )
+{
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution<double> u( -1.0, 1.0 );
+    sys.bodies.clear();
+    for ( size_t i = 0; i < n; ++i ) {
+        Vector3 pos( 1e11 * u( rng ), 1e11 * u( rng ), 1e11 * u( rng ) );
+        sys.add_body( 1e24 * ( 1.5 + u( rng ) ), pos, Vector3::Zero );
+    }
+}
+
+// best of three, against other load on the machine
+template<typename F>
+static double seconds( F fn )
+{
+    double best = 0.0;
+    for ( int k = 0; k < 3; ++k ) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if ( k == 0 || elapsed.count() < best )
+            best = elapsed.count();
+    }
+    return best;
+}
+
+int main( int argc, char** argv )
+{
+    size_t n = argc > 1 ? std::strtoul( argv[1], 0, 10 ) : 4096;
+    size_t largest = argc > 2 ? std::strtoul( argv[2], 0, 10 ) : 1 << 18;
+
+    System sys;
+    build( sys, n );
+    sys.direct_gravity();
+    std::vector<Vector3> exact( n );
+    for ( size_t i = 0; i < n; ++i )
+        exact[i] = sys.bodies[i].acc_accumulator;
+
+    std::printf( "accuracy, %zu bodies: rms / max relative error\n", n );
+    std::printf( "%5s %24s %24s %24s\n", "order", "theta 0.3", "theta 0.5", "theta 0.7" );
+    for ( int p = 1; p <= 8; ++p ) {
+        std::printf( "%5d", p );
+        const double thetas[] = { 0.3, 0.5, 0.7 };
+        for ( int t = 0; t < 3; ++t ) {
+            FmmGravity fmm( p, thetas[t] );
+            fmm.accelerations( sys.bodies, SOFTENING_NONE );
+            double rms = 0.0, worst = 0.0;
+            for ( size_t i = 0; i < n; ++i ) {
+                double e = distance( sys.bodies[i].acc_accumulator, exact[i] ) / length( exact[i] );
+                rms += e * e;
+                worst = std::max( worst, e );
+            }
+            std::printf( "   %10.2e / %10.2e", std::sqrt( rms / n ), worst );
+        }
+        std::printf( "\n" );
+    }
+
+    std::printf( "\nscaling, order 4, theta 0.5: time per body\n" );
+    std::printf( "%10s %14s %14s\n", "bodies", "fmm", "tiled direct" );
+    for ( size_t m = 1024; m <= largest; m *= 4 ) {
+        build( sys, m );
+        FmmGravity fmm( 4, 0.5 );
+        double t_fmm = seconds( [&]() { fmm.accelerations( sys.bodies, SOFTENING_NONE ); } );
+        std::printf( "%10zu %11.3f us", m, 1e6 * t_fmm / m );
+        if ( m <= 65536 ) {
+            TiledGravity tiled;
+            double t_tiled = seconds( [&]() { tiled.accelerations( sys.bodies, SOFTENING_NONE ); } );
+            std::printf( " %11.3f us", 1e6 * t_tiled / m );
+        }
+        std::printf( "\n" );
+    }
+    return 0;
+}
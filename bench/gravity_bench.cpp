@@ -0,0 +1,128 @@
+/*
+Speed and accuracy of the gravity solvers against the double direct
+summation in System.
+
+Builds a sun with bodies on orbits from 0.5 to 5 AU, plus light bodies
+without exerts_grav close to the heavy ones, and reports for each
+solver the time per evaluation and the largest observed error
+
+    max_i |a~_i - a_i| / sum_j |a_ij|
+
+For the mixed-precision solver this is shown next to its documented
+bound (mixed_gravity.hpp).
+
+    g++ -O2 -std=c++14 -pthread -I.. gravity_bench.cpp ../system.cpp \
+        ../integrator.cpp ../vector.cpp ../mixed_gravity.cpp \
+        ../symmetric_gravity.cpp ../tiled_gravity.cpp ../cache_info.cpp \
+        ../fmm_gravity.cpp ../pm_gravity.cpp ../fft.cpp -o gravity_bench
+    ./gravity_bench [bodies] [repeats]
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "fmm_gravity.hpp"
+#include "mixed_gravity.hpp"
+#include "parallel.hpp"
+#include "pm_gravity.hpp"
+#include "symmetric_gravity.hpp"
+#include "tiled_gravity.hpp"
+
+using namespace NEWTON;
+
+typedef Vector<3, double> Vec;
+
+static void build( System& sys, size_t n )
+{
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution<double> u( -1.0, 1.0 );
+    const double m_sun = 2e30, au = 1.496e11;
+
+    sys.bodies.clear();
+    sys.add_body( m_sun, Vec::Zero, Vec::Zero );
+    for ( size_t i = 1; i < n; ++i ) {
+        double r = au * ( 2.75 + 2.25 * u( rng ) );
+        double a = PI * u( rng );
+        Vec pos( r * std::cos( a ), r * std::sin( a ), 0.01 * r * u( rng ) );
+        if ( i % 16 == 0 ) { // a spacecraft near the previous body
+            pos = sys.bodies[i - 1].position + Vec( 4e8 * u( rng ), 4e8 * u( rng ), 4e8 * u( rng ) );
+            sys.add_body( 1e4, pos, Vec::Zero, false );
+        } else {
+            sys.add_body( 1e24, pos, Vec::Zero );
+        }
+    }
+}
+
+template<typename F>
+static double seconds_per_call( F fn, size_t repeats )
+{
+    auto start = std::chrono::steady_clock::now();
+    for ( size_t r = 0; r < repeats; ++r )
+        fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / repeats;
+}
+
+static std::vector<Vec> exact;
+static std::vector<double> abs_sum;
+static double t_direct;
+
+static void report( const char* name, System& sys, GravitySolver& solver, size_t repeats )
+{
+    double t = seconds_per_call( [&]() { solver.accelerations( sys.bodies, SOFTENING_NONE ); }, repeats );
+    double worst = 0.0;
+    for ( size_t i = 0; i < sys.bodies.size(); ++i )
+        worst = std::max( worst, distance( sys.bodies[i].acc_accumulator, exact[i] ) / abs_sum[i] );
+    std::printf( "%-20s %10.3f ms %6.1fx %12.3g\n", name, 1e3 * t, t_direct / t, worst );
+}
+
+int main( int argc, char** argv )
+{
+    size_t n = argc > 1 ? std::strtoul( argv[1], 0, 10 ) : 4096;
+    size_t repeats = argc > 2 ? std::strtoul( argv[2], 0, 10 ) : 10;
+
+    System sys;
+    build( sys, n );
+
+    t_direct = seconds_per_call( [&]() { sys.direct_gravity(); }, repeats );
+    exact.resize( n );
+    abs_sum.assign( n, 0.0 );
+    for ( size_t i = 0; i < n; ++i ) {
+        exact[i] = sys.bodies[i].acc_accumulator;
+        for ( size_t j = 0; j < n; ++j ) {
+            if ( i == j || !sys.bodies[j].exerts_grav )
+                continue;
+            double r = distance( sys.bodies[i].position, sys.bodies[j].position );
+            abs_sum[i] += G * sys.bodies[j].mass / ( r * r );
+        }
+    }
+
+    std::printf( "%zu bodies, %zu threads\n", n, num_workers() );
+    std::printf( "%-20s %10s    %6s %12s\n", "solver", "time", "speed", "max error" );
+    std::printf( "%-20s %10.3f ms %6.1fx %12s\n", "direct (double)", 1e3 * t_direct, 1.0, "-" );
+
+    MixedPrecisionGravity mixed;
+    report( "mixed (float)", sys, mixed, repeats );
+    std::printf( "%-20s %36.3g\n", "  bound",
+                 MixedPrecisionGravity::pair_error_bound + ( n - 1 ) * std::ldexp( 1.0, -53 ) );
+
+    SymmetricGravity symmetric;
+    report( "symmetric", sys, symmetric, repeats );
+    std::printf( "  %zu bodies per tile\n", symmetric.get_tile_size() );
+
+    TiledGravity tiled;
+    report( "tiled", sys, tiled, repeats );
+    std::printf( "  %zu sources per tile x %zu targets per block\n", tiled.get_tiles().sources, tiled.block_size( n ) );
+
+    FmmGravity fmm;
+    report( "fmm", sys, fmm, repeats );
+    std::printf( "  order %d, theta %g\n", fmm.get_order(), fmm.get_theta() );
+
+    ParticleMeshGravity pm;
+    report( "p3m", sys, pm, repeats );
+    std::printf( "  %zu^3 grid, TSC\n", pm.get_grid_size() );
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+Burns against the rocket equation.
+
+A vessel coasting through empty space (no massive bodies, so nothing
+but its engine acts on it) makes a prograde burn whose start and end
+fall inside steps, so ManeuverEngine::advance() has to split them.
+Afterwards its mass should be m0 - mdot * duration and its change of
+speed isp g0 ln(m0 / m1). Reports the relative error of both for each
+integrator and a few step sizes.
+
+    g++ -O2 -std=c++14 -pthread -I.. maneuver_bench.cpp ../maneuver.cpp \
+        ../batch.cpp ../matrix.cpp ../quaternion.cpp ../system.cpp \
+        ../integrator.cpp ../vector.cpp -o maneuver_bench
+    ./maneuver_bench
+*/
+
+#include <cmath>
+#include <cstdio>
+
+#include "maneuver.hpp"
+
+using namespace NEWTON;
+
+static void run( const char* name, const Integrator& integrator, real_t dt )
+{
+    const real_t m0 = 1e4, speed = 1e3;
+    Burn burn = { 1, 0, Burn::PROGRADE, 37.3, 123.4, 1e5, 300 };
+
+    // the reference is massless too; it only gives the burn its frame
+    System sys;
+    sys.add_body( 0, Vector3::Zero, Vector3::Zero, false );
+    sys.add_body( m0, Vector3( 1e6, 0.0, 0.0 ), Vector3( speed, 0.0, 0.0 ), false );
+
+    ManeuverEngine engine;
+    engine.schedule( burn );
+    sys.thrust_model = &engine;
+    while ( sys.time < burn.start + burn.duration + 2 * dt )
+        engine.advance( integrator, sys, dt );
+
+    real_t mdot = burn.thrust / ( burn.isp * STANDARD_GRAVITY );
+    real_t m1 = m0 - mdot * burn.duration;
+    real_t dv = burn.isp * STANDARD_GRAVITY * std::log( m0 / m1 );
+    real_t mass_error = std::fabs( sys.bodies[1].mass - m1 ) / m1;
+    real_t dv_error = std::fabs( length( sys.bodies[1].velocity ) - speed - dv ) / dv;
+    std::printf( "%-10s %6g s %14.3g %14.3g\n", name, dt, mass_error, dv_error );
+}
+
+int main()
+{
+    std::printf( "%-10s %8s %14s %14s\n", "", "step", "mass error", "dv error" );
+    RungeKuttaIntegrator rk;
+    const real_t steps[] = { 1, 10, 60 };
+    for ( int k = 0; k < 3; ++k )
+        run( "rk4", rk, steps[k] );
+    for ( int k = 0; k < 3; ++k ) {
+        LeapfrogIntegrator leapfrog;
+        run( "leapfrog", leapfrog, steps[k] );
+    }
+    return 0;
+}
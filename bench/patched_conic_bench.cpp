@@ -0,0 +1,84 @@
+/*
+Cost and accuracy of PatchedConics.
+
+A Sun, Earth and Moon System is integrated with RK4 in ten-minute steps
+for a week while a fleet of vessels leaves low Earth orbit at speeds
+from circular to well past escape, many of them crossing into the
+Sun's or the Moon's SOI. Reports the time per end_step (the whole
+fleet, every step) and the SOI transitions found, and compares one
+vessel on a hyperbolic departure with the same vessel integrated as a
+test particle in the System, the size of the patched-conic
+approximation itself.
+
+    g++ -O2 -std=c++14 -pthread -I.. patched_conic_bench.cpp \
+        ../patched_conic.cpp ../kepler.cpp ../system.cpp ../integrator.cpp \
+        ../vector.cpp ../batch.cpp ../matrix.cpp ../quaternion.cpp \
+        -o patched_conic_bench
+    ./patched_conic_bench [vessels]
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "patched_conic.hpp"
+
+using namespace NEWTON;
+
+int main( int argc, char** argv )
+{
+    size_t vessels = argc > 1 ? std::atoi( argv[1] ) : 100000;
+    const real_t dt = 600, duration = 7 * 86400;
+
+    System sys;
+    RungeKuttaIntegrator integrator;
+    sys.add_body( 1.989e30, Vector3( 0.0, 0.0, 0.0 ), Vector3( 0.0, 0.0, 0.0 ) );
+    size_t earth = sys.add_body( 5.97219e24, Vector3( 1.5210e11, 0.0, 0.0 ), Vector3( 0.0, 2.9300e4, 0.0 ) );
+    sys.add_body( 7.3477e22, Vector3( 1.5210e11 + 4.054e8, 0.0, 0.0 ), Vector3( 0.0, 2.9300e4 + 9.64e2, 0.0 ) );
+
+    // the compared vessel: 10% over escape speed from 300 km, retrograde
+    real_t mu = G * sys.bodies[earth].mass, r0 = 6.678e6;
+    Vector3 pos = sys.bodies[earth].position - Vector3( r0, 0.0, 0.0 );
+    Vector3 vel = sys.bodies[earth].velocity - Vector3( 0.0, 1.1 * std::sqrt( 2 * mu / r0 ), 0.0 );
+    size_t particle = sys.add_body( 0, pos, vel, false );
+
+    PatchedConics conics;
+    conics.set_bodies( sys );
+    conics.add_vessel( sys, pos, vel );
+
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution<double> u( -1.0, 1.0 );
+    for ( size_t k = 1; k < vessels; ++k ) {
+        real_t r = r0 * ( 1 + 5 * ( u( rng ) + 1 ) );
+        Vector3 out = normalize( Vector3( u( rng ), u( rng ), 0.2 * u( rng ) ) );
+        Vector3 along = normalize( cross( out, Vector3::UnitZ ) );
+        real_t speed = std::sqrt( mu / r ) * ( 1 + 0.45 * ( u( rng ) + 1 ) );
+        conics.add_vessel( sys, sys.bodies[earth].position + out * r, sys.bodies[earth].velocity + along * speed );
+    }
+
+    std::vector< SoiTransition > transitions;
+    double seconds = 0;
+    int steps = 0;
+    while ( sys.time < duration ) {
+        conics.begin_step( sys );
+        integrator.integrate( sys, dt );
+        auto start = std::chrono::steady_clock::now();
+        conics.end_step( sys, &transitions );
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        seconds += elapsed.count();
+        ++steps;
+    }
+
+    std::printf( "%zu vessels: %.2f ms per step (%.0f ns per vessel), %zu SOI transitions\n",
+                 vessels, 1e3 * seconds / steps, 1e9 * seconds / steps / vessels, transitions.size() );
+    for ( size_t k = 0; k < transitions.size(); ++k )
+        if ( transitions[k].vessel == 0 )
+            std::printf( "compared vessel: body %zu to %zu at %.0f s\n", transitions[k].from, transitions[k].to, transitions[k].time );
+    real_t off = length( conics.get_position( 0 ) - sys.bodies[particle].position );
+    real_t from_earth = length( sys.bodies[particle].position - sys.bodies[earth].position );
+    std::printf( "after %.0f days it is %.0f km from the integrated particle, %.0f km from Earth\n",
+                 duration / 86400, off / 1e3, from_earth / 1e3 );
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+Earth to Mars porkchop plot for the solar system of Game::initialize.
+
+Integrates the planets for three years with daily samples into a
+SampledEphemeris, then sweeps departures over the first two years
+against arrivals up to three years out, one day apart, and reports the
+solve rate and the cheapest transfer. With a file name, writes the grid
+for plotting, e.g. in gnuplot:
+
+    set view map; set cbrange [0:20]
+    splot 'porkchop.dat' using ($1/86400):($2/86400):(($3+$4)/1000) with pm3d
+
+    g++ -O2 -std=c++14 -pthread -I.. porkchop_bench.cpp ../lambert.cpp \
+        ../ephemeris.cpp ../system.cpp ../integrator.cpp ../vector.cpp \
+        -o porkchop_bench
+    ./porkchop_bench [output file]
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+#include "lambert.hpp"
+#include "parallel.hpp"
+
+using namespace NEWTON;
+
+static const real_t DAY = 86400;
+
+int main( int argc, char** argv )
+{
+    // the planets of Game::initialize, at aphelion on the x axis
+    System sys;
+    size_t sun = sys.add_body( 1.989e30, Vector3( 0.0, 0.0, 0.0 ), Vector3( 0.0, 0.0, 0.0 ) );
+    sys.add_body( 3.3022e23, Vector3( 6.9817e10, 0.0, 0.0 ), Vector3( 0.0, 3.886e4, 0.0 ) );
+    sys.add_body( 4.8676e24, Vector3( 1.0894e11, 0.0, 0.0 ), Vector3( 0.0, 3.479e4, 0.0 ) );
+    size_t earth = sys.add_body( 5.97219e24, Vector3( 1.5210e11, 0.0, 0.0 ), Vector3( 0.0, 2.9300e4, 0.0 ) );
+    sys.add_body( 7.3477e22, Vector3( 1.5210e11 + 4.054e8, 0.0, 0.0 ), Vector3( 0.0, 2.9300e4 + 9.64e2, 0.0 ) );
+    size_t mars = sys.add_body( 6.4185e23, Vector3( 2.492e11, 0.0, 0.0 ), Vector3( 0.0, 2.1977e4, 0.0 ) );
+    sys.add_body( 1.89813e27, Vector3( 8.1652e11, 0.0, 0.0 ), Vector3( 0.0, 1.2435e4, 0.0 ) );
+    sys.add_body( 5.6846e26, Vector3( 1.513e12, 0.0, 0.0 ), Vector3( 0.0, 9.101e3, 0.0 ) );
+
+    // hourly steps, so the Moon's month is resolved; daily samples
+    SampledEphemeris ephemeris;
+    RungeKuttaIntegrator integrator;
+    ephemeris.record( sys );
+    for ( int day = 0; day < 3 * 365; ++day ) {
+        for ( int hour = 0; hour < 24; ++hour )
+            integrator.integrate( sys, DAY / 24 );
+        ephemeris.record( sys );
+    }
+
+    Porkchop porkchop( earth, mars, sun, G * sys.bodies[sun].mass );
+    porkchop.set_departures( 0, DAY, 2 * 365 );
+    porkchop.set_arrivals( 60 * DAY, DAY, 3 * 365 - 60 );
+
+    auto start = std::chrono::steady_clock::now();
+    porkchop.sweep( ephemeris );
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t cells = porkchop.num_departures() * porkchop.num_arrivals(), solved = 0;
+    for ( size_t d = 0; d < porkchop.num_departures(); ++d )
+        for ( size_t a = 0; a < porkchop.num_arrivals(); ++a )
+            solved += porkchop.total( d, a ) == porkchop.total( d, a );
+    std::printf( "%zu cells, %zu transfers in %.3f s: %.0f ns per transfer on %zu threads\n",
+                 cells, solved, elapsed.count(), 1e9 * elapsed.count() / solved, num_workers() );
+
+    size_t d, a;
+    if ( porkchop.best( d, a ) )
+        std::printf( "cheapest: depart day %.0f, arrive day %.0f, excess speeds %.2f + %.2f km/s\n",
+                     porkchop.departure_time( d ) / DAY, porkchop.arrival_time( a ) / DAY,
+                     porkchop.departure_excess( d, a ) / 1e3, porkchop.arrival_excess( d, a ) / 1e3 );
+
+    if ( argc > 1 ) {
+        std::ofstream out( argv[1] );
+        porkchop.write( out );
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+Throughput and accuracy of the physics core per scalar type.
+
+Builds the same sun-and-planetesimals system in float, double and
+double-double, advances each with the Runge-Kutta integrator, and
+reports pair interactions per second and the relative energy error
+after the run. "double+c" is double with compensated summation in
+both the force sum and the state update. At the default one-hour step
+RK4's own truncation error, about 1e-16, hides the rounding of every
+type but float; at ten-minute steps it drops to a few 1e-21 and the
+rows separate:
+
+    64 bodies, 2000 steps of 600 s
+    float       6.2e-08
+    double      8.6e-16
+    double+c    1.9e-17
+    dd_real     2.7e-21
+
+    g++ -O2 -std=c++14 -I.. precision_bench.cpp ../system.cpp \
+        ../integrator.cpp ../vector.cpp -o precision_bench
+    ./precision_bench [bodies] [steps] [step in s]
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+#include "system.hpp"
+
+using namespace NEWTON;
+
+template<typename T>
+static void build( BasicSystem<T>& sys, size_t n )
+{
+    typedef Vector<3, T> Vec;
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution<double> u( -1.0, 1.0 );
+
+    // a sun with light bodies on near-circular orbits from 0.5 to 5 AU
+    const double m_sun = 2e30, au = 1.496e11;
+    sys.bodies.clear();
+    sys.time = T( 0 );
+    sys.add_body( T( m_sun ), Vec::Zero, Vec::Zero );
+    for ( size_t i = 1; i < n; ++i ) {
+        double r = au * ( 2.75 + 2.25 * u( rng ) );
+        double a = PI * u( rng );
+        double z = 0.01 * r * u( rng );
+        double v = std::sqrt( G * m_sun / r );
+        Vec pos( T( r * std::cos( a ) ), T( r * std::sin( a ) ), T( z ) );
+        Vec vel( T( -v * std::sin( a ) ), T( v * std::cos( a ) ), T( 0 ) );
+        sys.add_body( T( 1e22 ), pos, vel );
+    }
+}
+
+// Total energy, always summed in double-double from the full values and
+// left in double-double for the difference, so the measurement does not
+// add error of its own.
+template<typename T>
+static Vector<3, dd_real> to_dd( const Vector<3, T>& v )
+{
+    return Vector<3, dd_real>( dd_real( v.x ), dd_real( v.y ), dd_real( v.z ) );
+}
+
+template<typename T>
+static dd_real energy( const BasicSystem<T>& sys )
+{
+    dd_real e = 0.0;
+    size_t n = sys.bodies.size();
+    for ( size_t i = 0; i < n; ++i ) {
+        dd_real m_i = dd_real( sys.bodies[i].mass );
+        Vector<3, dd_real> p_i = to_dd( sys.bodies[i].position );
+        e += dd_real( 0.5 ) * m_i * squared_length( to_dd( sys.bodies[i].velocity ) );
+        for ( size_t j = i + 1; j < n; ++j ) {
+            Vector<3, dd_real> r = to_dd( sys.bodies[j].position ) - p_i;
+            e -= dd_real( G ) * m_i * dd_real( sys.bodies[j].mass ) / length( r );
+        }
+    }
+    return e;
+}
+
+template<typename T>
+static void run( const char* name, size_t n, size_t steps, double step, bool compensated = false )
+{
+    BasicSystem<T> sys;
+    BasicRungeKuttaIntegrator<T> rk( compensated );
+    build( sys, n );
+    sys.compensated = compensated;
+
+    dd_real e0 = energy( sys );
+    const T dt = T( step );
+
+    auto start = std::chrono::steady_clock::now();
+    for ( size_t s = 0; s < steps; ++s )
+        rk.integrate( sys, dt );
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    dd_real e1 = energy( sys );
+    double pairs = 4.0 * steps * n * ( n - 1 ); // four evaluations per RK4 step
+    std::printf( "%-8s %10.3f s %12.4g pairs/s %12.3g rel. energy error\n",
+                 name, elapsed.count(), pairs / elapsed.count(), std::fabs( double( ( e1 - e0 ) / e0 ) ) );
+}
+
+int main( int argc, char** argv )
+{
+    size_t n = argc > 1 ? std::strtoul( argv[1], 0, 10 ) : 64;
+    size_t steps = argc > 2 ? std::strtoul( argv[2], 0, 10 ) : 2000;
+    double step = argc > 3 ? std::strtod( argv[3], 0 ) : 3600;
+
+    std::printf( "%zu bodies, %zu steps of %g s\n", n, steps, step );
+    run<float>( "float", n, steps, step );
+    run<double>( "double", n, steps, step );
+    run<double>( "double+c", n, steps, step, true );
+    run<dd_real>( "dd_real", n, steps, step );
+    return 0;
+}
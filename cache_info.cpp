@@ -0,0 +1,128 @@
+#include "cache_info.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#if defined( _WIN32 )
+#include <windows.h>
+#include <vector>
+#elif defined( __APPLE__ )
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace NEWTON {
+
+static const CacheSizes DEFAULT_CACHE_SIZES = { 32 * 1024, 256 * 1024, 8 * 1024 * 1024 };
+
+#if defined( _WIN32 )
+
+static void query( CacheSizes& c )
+{
+    DWORD bytes = 0;
+    GetLogicalProcessorInformation( 0, &bytes );
+    std::vector< SYSTEM_LOGICAL_PROCESSOR_INFORMATION > info( bytes / sizeof( SYSTEM_LOGICAL_PROCESSOR_INFORMATION ) );
+    if ( info.empty() || !GetLogicalProcessorInformation( &info[0], &bytes ) )
+        return;
+    for ( size_t i = 0; i < info.size(); ++i ) {
+        if ( info[i].Relationship != RelationCache )
+            continue;
+        const CACHE_DESCRIPTOR& d = info[i].Cache;
+        if ( d.Level == 1 && ( d.Type == CacheData || d.Type == CacheUnified ) )
+            c.l1d = d.Size;
+        else if ( d.Level == 2 )
+            c.l2 = d.Size;
+        else if ( d.Level == 3 )
+            c.l3 = d.Size;
+    }
+}
+
+#elif defined( __APPLE__ )
+
+static void query_one( const char* name, size_t& out )
+{
+    long long v = 0;
+    size_t len = sizeof v;
+    if ( sysctlbyname( name, &v, &len, 0, 0 ) == 0 && v > 0 )
+        out = size_t( v );
+}
+
+static void query( CacheSizes& c )
+{
+    query_one( "hw.l1dcachesize", c.l1d );
+    query_one( "hw.l2cachesize", c.l2 );
+    query_one( "hw.l3cachesize", c.l3 );
+}
+
+#else
+
+// e.g. "48K" from /sys/devices/system/cpu/cpu0/cache/index0/size
+static size_t sysfs_size( int index, const char* want_type, int want_level )
+{
+    char path[96];
+    char text[32];
+    int level = 0;
+    size_t size = 0;
+    char unit = 0;
+
+    std::snprintf( path, sizeof path, "/sys/devices/system/cpu/cpu0/cache/index%d/level", index );
+    FILE* f = std::fopen( path, "r" );
+    if ( !f )
+        return 0;
+    bool ok = std::fscanf( f, "%d", &level ) == 1;
+    std::fclose( f );
+    if ( !ok || level != want_level )
+        return 0;
+
+    std::snprintf( path, sizeof path, "/sys/devices/system/cpu/cpu0/cache/index%d/type", index );
+    if ( !( f = std::fopen( path, "r" ) ) )
+        return 0;
+    ok = std::fscanf( f, "%31s", text ) == 1;
+    std::fclose( f );
+    if ( !ok || ( std::strcmp( text, want_type ) != 0 && std::strcmp( text, "Unified" ) != 0 ) )
+        return 0;
+
+    std::snprintf( path, sizeof path, "/sys/devices/system/cpu/cpu0/cache/index%d/size", index );
+    if ( !( f = std::fopen( path, "r" ) ) )
+        return 0;
+    ok = std::fscanf( f, "%zu%c", &size, &unit ) >= 1;
+    std::fclose( f );
+    if ( !ok )
+        return 0;
+    return unit == 'K' ? size * 1024 : unit == 'M' ? size * 1024 * 1024 : size;
+}
+
+static void query( CacheSizes& c )
+{
+#if defined( _SC_LEVEL1_DCACHE_SIZE )
+    long v;
+    if ( ( v = sysconf( _SC_LEVEL1_DCACHE_SIZE ) ) > 0 ) c.l1d = size_t( v );
+    if ( ( v = sysconf( _SC_LEVEL2_CACHE_SIZE ) ) > 0 ) c.l2 = size_t( v );
+    if ( ( v = sysconf( _SC_LEVEL3_CACHE_SIZE ) ) > 0 ) c.l3 = size_t( v );
+#endif
+    // sysconf returns 0 on some libcs and under some hypervisors
+    for ( int i = 0; i < 8; ++i ) {
+        if ( !c.l1d ) c.l1d = sysfs_size( i, "Data", 1 );
+        if ( !c.l2 ) c.l2 = sysfs_size( i, "Data", 2 );
+        if ( !c.l3 ) c.l3 = sysfs_size( i, "Data", 3 );
+    }
+}
+
+#endif
+
+const CacheSizes& cache_sizes()
+{
+    static const CacheSizes sizes = []() {
+        CacheSizes c = { 0, 0, 0 };
+        query( c );
+        if ( !c.l1d ) c.l1d = DEFAULT_CACHE_SIZES.l1d;
+        if ( !c.l2 ) c.l2 = DEFAULT_CACHE_SIZES.l2;
+        if ( !c.l3 ) c.l3 = DEFAULT_CACHE_SIZES.l3;
+        return c;
+    }();
+    return sizes;
+}
+
+} /* NEWTON */
@@ -0,0 +1,22 @@
+#ifndef _CACHE_INFO_HPP_
+#define _CACHE_INFO_HPP_
+
+#include <cstddef>
+
+namespace NEWTON {
+
+// Data cache sizes, in bytes, of the CPU the program runs on.
+struct CacheSizes
+{
+    size_t l1d;
+    size_t l2;
+    size_t l3;
+};
+
+// Read from the operating system on first use. Levels it doesn't report
+// get typical desktop values (32 KB, 256 KB, 8 MB).
+const CacheSizes& cache_sizes();
+
+} /* NEWTON */
+
+#endif /* _CACHE_INFO_HPP_ */
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+
+#include "chebyshev_ephemeris.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace NEWTON {
+
+static const char EPHEMERIS_MAGIC[4] = { 'N', 'B', 'C', 'E' };
+static const uint32_t EPHEMERIS_VERSION = 1;
+
+struct EphemerisHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t real_size;    // sizeof(real_t) the coefficients were written with
+    uint32_t degree;
+    uint32_t num_bodies;
+    uint32_t reserved;
+    uint64_t num_records;
+    uint64_t scenario;     // hash of the initial conditions and fit settings
+    double start;
+    double interval;
+};
+
+const size_t ChebyshevEphemeris::NO_SLOT;
+
+static size_t align8( size_t n ) { return ( n + 7 ) & ~size_t( 7 ); }
+
+static size_t coefficients_offset( size_t num_bodies )
+{
+    return align8( sizeof( EphemerisHeader ) + num_bodies * sizeof( uint32_t ) );
+}
+
+// FNV-1a over the bytes of each value
+static void hash_bytes( uint64_t& h, const void* p, size_t n )
+{
+    const unsigned char* b = (const unsigned char*) p;
+    for ( size_t i = 0; i < n; ++i ) {
+        h ^= b[i];
+        h *= 1099511628211ULL;
+    }
+}
+
+static uint64_t scenario_hash( const System& sys, real_t duration, real_t interval, size_t degree, real_t max_step )
+{
+    uint64_t h = 14695981039346656037ULL;
+    hash_bytes( h, &sys.time, sizeof sys.time );
+    for ( size_t i = 0; i < sys.bodies.size(); ++i ) {
+        const Body& b = sys.bodies[i];
+        if ( !b.exerts_grav || !( b.mass > 0 ) )
+            continue;
+        uint64_t index = i;
+        hash_bytes( h, &index, sizeof index );
+        hash_bytes( h, &b.mass, sizeof b.mass );
+        hash_bytes( h, &b.position, sizeof b.position );
+        hash_bytes( h, &b.velocity, sizeof b.velocity );
+    }
+    uint64_t d = degree;
+    hash_bytes( h, &duration, sizeof duration );
+    hash_bytes( h, &interval, sizeof interval );
+    hash_bytes( h, &d, sizeof d );
+    hash_bytes( h, &max_step, sizeof max_step );
+    return h;
+}
+
+ChebyshevEphemeris::ChebyshevEphemeris()
+    : start( 0 ), interval( 0 ), degree( 0 ), num_records( 0 ), scenario( 0 ), coefficients( 0 ),
+      mapping( 0 ), mapping_size( 0 ) { }
+
+ChebyshevEphemeris::~ChebyshevEphemeris()
+{
+    close();
+}
+
+void ChebyshevEphemeris::close()
+{
+    bodies.clear();
+    slots.clear();
+    coefficients = 0;
+    num_records = 0;
+    buffer.clear();
+#ifndef _WIN32
+    if ( mapping )
+        munmap( mapping, mapping_size );
+#endif
+    mapping = 0;
+    mapping_size = 0;
+}
+
+void ChebyshevEphemeris::build( const System& sys, const Integrator& integrator, real_t duration,
+                                real_t interval, size_t degree, real_t max_step )
+{
+    close();
+
+    // only the massive bodies, integrated on their own
+    System fit;
+    fit.time = sys.time;
+    fit.compensated = sys.compensated;
+    fit.softening_kernel = sys.softening_kernel;
+    std::vector< uint32_t > fitted;
+    for ( size_t i = 0; i < sys.bodies.size(); ++i )
+        if ( sys.bodies[i].exerts_grav && sys.bodies[i].mass > 0 ) {
+            fit.bodies.push_back( sys.bodies[i] );
+            fitted.push_back( uint32_t( i ) );
+        }
+
+    size_t n = degree + 1, nb = fitted.size();
+    size_t records = std::max( size_t( 1 ), size_t( std::ceil( duration / interval ) ) );
+    std::vector< real_t > basis( n * n ); // T_j at node k
+    for ( size_t j = 0; j < n; ++j )
+        for ( size_t k = 0; k < n; ++k )
+            basis[j * n + k] = std::cos( PI * real_t( j ) * ( real_t( k ) + real_t( 0.5 ) ) / real_t( n ) );
+
+    std::vector< real_t > coeffs( records * nb * 3 * n ), samples( nb * 3 * n );
+    for ( size_t r = 0; r < records; ++r ) {
+        real_t mid = sys.time + ( real_t( r ) + real_t( 0.5 ) ) * interval;
+        // nodes x_k = cos(pi (k + 1/2) / n) fall as k rises; visit them in time order
+        for ( size_t k = n; k-- > 0; ) {
+            real_t t = mid + interval / 2 * basis[n + k];
+            real_t gap = t - fit.time;
+            if ( gap > 0 ) {
+                size_t steps = size_t( std::ceil( gap / max_step ) );
+                for ( size_t s = 0; s < steps; ++s )
+                    integrator.integrate( fit, gap / real_t( steps ) );
+            }
+            for ( size_t b = 0; b < nb; ++b )
+                for ( int c = 0; c < 3; ++c )
+                    samples[( b * 3 + c ) * n + k] = fit.bodies[b].position[c];
+        }
+        for ( size_t row = 0; row < nb * 3; ++row )
+            for ( size_t j = 0; j < n; ++j ) {
+                real_t sum = 0;
+                for ( size_t k = 0; k < n; ++k )
+                    sum += samples[row * n + k] * basis[j * n + k];
+                coeffs[( r * nb * 3 + row ) * n + j] = sum * ( j == 0 ? real_t( 1 ) : real_t( 2 ) ) / real_t( n );
+            }
+    }
+
+    EphemerisHeader header;
+    memcpy( header.magic, EPHEMERIS_MAGIC, sizeof header.magic );
+    header.version = EPHEMERIS_VERSION;
+    header.real_size = sizeof( real_t );
+    header.degree = uint32_t( degree );
+    header.num_bodies = uint32_t( nb );
+    header.reserved = 0;
+    header.num_records = records;
+    header.scenario = scenario_hash( sys, duration, interval, degree, max_step );
+    header.start = sys.time;
+    header.interval = interval;
+
+    size_t offset = coefficients_offset( nb );
+    buffer.assign( offset + coeffs.size() * sizeof( real_t ), 0 );
+    memcpy( &buffer[0], &header, sizeof header );
+    if ( nb > 0 )
+        memcpy( &buffer[sizeof header], &fitted[0], nb * sizeof( uint32_t ) );
+    memcpy( &buffer[offset], &coeffs[0], coeffs.size() * sizeof( real_t ) );
+    parse( &buffer[0], buffer.size() );
+}
+
+bool ChebyshevEphemeris::parse( const char* data, size_t size )
+{
+    if ( size < sizeof( EphemerisHeader ) )
+        return false;
+    EphemerisHeader header;
+    memcpy( &header, data, sizeof header );
+    if ( memcmp( header.magic, EPHEMERIS_MAGIC, sizeof header.magic ) != 0 ||
+         header.version != EPHEMERIS_VERSION ||
+         header.real_size != sizeof( real_t ) ||
+         header.num_records == 0 || !( header.interval > 0 ) )
+        return false;
+    size_t n = size_t( header.degree ) + 1, nb = header.num_bodies;
+    size_t offset = coefficients_offset( nb );
+    if ( size < offset || ( size - offset ) / sizeof( real_t ) / 3 / n / std::max( nb, size_t( 1 ) ) < header.num_records )
+        return false;
+
+    const uint32_t* indices = (const uint32_t*)( data + sizeof header );
+    bodies.assign( indices, indices + nb );
+    slots.clear();
+    for ( size_t s = 0; s < nb; ++s ) {
+        if ( slots.size() <= bodies[s] )
+            slots.resize( bodies[s] + 1, NO_SLOT );
+        slots[bodies[s]] = s;
+    }
+    start = header.start;
+    interval = header.interval;
+    degree = header.degree;
+    num_records = size_t( header.num_records );
+    scenario = header.scenario;
+    coefficients = (const real_t*)( data + offset );
+    return true;
+}
+
+bool ChebyshevEphemeris::map_file( const std::string& path )
+{
+#ifndef _WIN32
+    int fd = ::open( path.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        return false;
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size <= 0 ) {
+        ::close( fd );
+        return false;
+    }
+    void* p = mmap( 0, size_t( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( p == MAP_FAILED )
+        return false;
+    mapping = p;
+    mapping_size = size_t( st.st_size );
+    if ( !parse( (const char*) mapping, mapping_size ) ) {
+        close();
+        return false;
+    }
+    return true;
+#else
+    // no mmap here; a single bulk read is the next best thing
+    FILE* fp = fopen( path.c_str(), "rb" );
+    if ( !fp )
+        return false;
+    fseek( fp, 0, SEEK_END );
+    long size = ftell( fp );
+    fseek( fp, 0, SEEK_SET );
+    bool ok = size > 0;
+    if ( ok ) {
+        buffer.resize( size_t( size ) );
+        ok = fread( &buffer[0], 1, buffer.size(), fp ) == buffer.size();
+    }
+    fclose( fp );
+    if ( !ok || !parse( &buffer[0], buffer.size() ) ) {
+        close();
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool ChebyshevEphemeris::load( const std::string& path )
+{
+    close();
+    return map_file( path );
+}
+
+bool ChebyshevEphemeris::save( const std::string& path ) const
+{
+    const char* data = mapping ? (const char*) mapping : ( buffer.empty() ? 0 : &buffer[0] );
+    size_t size = mapping ? mapping_size : buffer.size();
+    if ( !data )
+        return false;
+    FILE* fp = fopen( path.c_str(), "wb" );
+    if ( !fp )
+        return false;
+    bool written = fwrite( data, 1, size, fp ) == size;
+    return fclose( fp ) == 0 && written;
+}
+
+bool ChebyshevEphemeris::open( const std::string& path, const System& sys, const Integrator& integrator,
+                               real_t duration, real_t interval, size_t degree, real_t max_step )
+{
+    uint64_t expected = scenario_hash( sys, duration, interval, degree, max_step );
+    if ( load( path ) && scenario == expected )
+        return true;
+
+    build( sys, integrator, duration, interval, degree, max_step );
+    if ( save( path ) ) {
+        if ( load( path ) && scenario == expected )
+            return true;
+        build( sys, integrator, duration, interval, degree, max_step );
+    } else {
+        std::cout << "WARNING: could not write ephemeris cache " << path << std::endl;
+    }
+    return num_records > 0;
+}
+
+void ChebyshevEphemeris::state( size_t body, real_t time, Vector3& position, Vector3& velocity ) const
+{
+    assert( covers( body ) && coefficients );
+    real_t f = std::floor( ( time - start ) / interval );
+    size_t r = f < 0 ? 0 : std::min( num_records - 1, size_t( f ) );
+    real_t half = interval / 2;
+    real_t x = ( time - ( start + ( real_t( r ) + real_t( 0.5 ) ) * interval ) ) / half;
+    x = std::max( real_t( -1 ), std::min( real_t( 1 ), x ) );
+
+    size_t n = degree + 1;
+    const real_t* c = coefficients + ( r * bodies.size() + slots[body] ) * 3 * n;
+    // T_j(x) and T_j'(x) by their recurrences, summed for all three
+    // coordinates as they go
+    real_t t0 = 1, t1 = x, d0 = 0, d1 = 1;
+    Vector3 p( c[0], c[n], c[2 * n] ), v( 0, 0, 0 );
+    for ( size_t j = 1; j < n; ++j ) {
+        p += Vector3( c[j], c[n + j], c[2 * n + j] ) * t1;
+        v += Vector3( c[j], c[n + j], c[2 * n + j] ) * d1;
+        real_t t2 = 2 * x * t1 - t0, d2 = 2 * t1 + 2 * x * d1 - d0;
+        t0 = t1; t1 = t2;
+        d0 = d1; d1 = d2;
+    }
+    position = p;
+    velocity = v / half;
+}
+
+void EphemerisRails::add( size_t body )
+{
+    railed.push_back( body );
+    if ( flags.size() <= body )
+        flags.resize( body + 1, false );
+    flags[body] = true;
+}
+
+bool EphemerisRails::in_span( real_t time ) const
+{
+    return ephemeris && time >= ephemeris->start_time() && time <= ephemeris->end_time();
+}
+
+bool EphemerisRails::on_rails( size_t body, real_t time ) const
+{
+    return body < flags.size() && flags[body] && in_span( time );
+}
+
+void EphemerisRails::apply( std::vector< Body >& bodies, real_t time )
+{
+    if ( !in_span( time ) )
+        return;
+    for ( size_t k = 0; k < railed.size(); ++k ) {
+        Body& b = bodies[railed[k]];
+        ephemeris->state( railed[k], time, b.position, b.velocity );
+    }
+}
+
+} // NEWTON
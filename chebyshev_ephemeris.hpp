@@ -0,0 +1,118 @@
+#ifndef _CHEBYSHEV_EPHEMERIS_HPP_
+#define _CHEBYSHEV_EPHEMERIS_HPP_
+
+#include <string>
+#include <vector>
+
+#include "ephemeris.hpp"
+
+namespace NEWTON {
+
+/*
+Trajectories of the massive bodies fitted once and stored, in the manner
+of SPICE type 2 segments: time is cut into records of equal length, and
+in each record every coordinate of every body is a Chebyshev series in
+the record's scaled time x in [-1, 1],
+
+    x(t) = sum_j c_j T_j(x),
+
+interpolating the integrated positions at the record's Chebyshev nodes.
+Velocities are the derivative of the same series. A lookup is an index
+computation and one pass of the Chebyshev recurrence over degree + 1
+terms, whatever the time.
+
+The fit is built by integrating a copy of the system straight to each
+node time (in steps no longer than max_step), so the samples are as
+good as the integrator. With the default 4 day records at degree 13 the
+fit itself adds a metre or two; at the default max_step of an hour the
+samples for Mercury and the Moon are already tens of metres from a
+finer integration.
+
+The coefficients live in a binary file laid out for mapping: a header,
+the System indices of the fitted bodies, then the coefficients as
+[record][body][coordinate][degree + 1]. The header holds a hash of the
+scenario the fit was made from (masses, states, time and fit settings),
+so open() notices a file made for different initial conditions and
+refits instead.
+*/
+class ChebyshevEphemeris : public Ephemeris {
+public:
+    ChebyshevEphemeris();
+    ~ChebyshevEphemeris();
+
+    // Fits the massive bodies (exerts_grav, mass > 0) of sys over
+    // [sys.time, sys.time + duration]; sys itself isn't changed.
+    void build( const System& sys, const Integrator& integrator, real_t duration,
+                real_t interval = 4 * 86400, size_t degree = 13, real_t max_step = 3600 );
+
+    bool save( const std::string& path ) const;
+    // Maps a file written by save(). False if it is missing or invalid.
+    bool load( const std::string& path );
+
+    // Maps the file at path if it was fitted from this scenario with
+    // these settings, otherwise builds the fit and writes it there. As
+    // with IcosphereCache, a file that can't be written is kept in
+    // memory.
+    bool open( const std::string& path, const System& sys, const Integrator& integrator, real_t duration,
+               real_t interval = 4 * 86400, size_t degree = 13, real_t max_step = 3600 );
+    void close();
+
+    bool covers( size_t body ) const { return body < slots.size() && slots[body] != NO_SLOT; }
+    // System indices of the fitted bodies.
+    const std::vector< size_t >& get_bodies() const { return bodies; }
+
+    // body is a System index; times outside the fit are clamped to it.
+    virtual void state( size_t body, real_t time, Vector3& position, Vector3& velocity ) const;
+
+    virtual real_t start_time() const { return start; }
+    virtual real_t end_time() const { return start + interval * real_t( num_records ); }
+
+private:
+    static const size_t NO_SLOT = size_t( -1 );
+
+    ChebyshevEphemeris( const ChebyshevEphemeris& );
+    ChebyshevEphemeris& operator=( const ChebyshevEphemeris& );
+
+    bool map_file( const std::string& path );
+    bool parse( const char* data, size_t size );
+
+    real_t start, interval;
+    size_t degree, num_records;
+    unsigned long long scenario;
+    std::vector< size_t > bodies, slots;
+    const real_t* coefficients;
+
+    // exactly one of these backs coefficients
+    void* mapping;
+    size_t mapping_size;
+    std::vector< char > buffer;
+};
+
+// Moves bodies along an ephemeris instead of integrating them (see
+// System::rails). Outside the ephemeris' span they are left alone, so
+// the integrator carries them on from where it ends; inside it they are
+// on_rails, so gravity on them isn't computed either and with every
+// massive body railed only the test particles' pairs remain.
+class EphemerisRails : public Rails {
+public:
+    explicit EphemerisRails( const Ephemeris* ephemeris = 0 ) : ephemeris( ephemeris ) { }
+    virtual ~EphemerisRails() { }
+
+    void set_ephemeris( const Ephemeris* e ) { ephemeris = e; }
+    void add( size_t body );
+    void clear() { railed.clear(); flags.clear(); }
+
+    virtual void apply( std::vector< Body >& bodies, real_t time );
+    virtual bool on_rails( size_t body, real_t time ) const;
+
+private:
+    bool in_span( real_t time ) const;
+
+    const Ephemeris* ephemeris;
+    std::vector< size_t > railed;
+    std::vector< bool > flags; // per body: in railed
+};
+
+} // NEWTON
+
+#endif
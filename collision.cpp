@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <ostream>
+
+#include "collision.hpp"
+
+namespace NEWTON {
+
+CollisionDetector::CollisionDetector() : start_time( 0 ), candidates( 0 ), dirty( true )
+{
+}
+
+void CollisionDetector::resize( size_t n )
+{
+    if ( radii.size() < n ) {
+        radii.resize( n, 0 );
+        reach.resize( n, 0 );
+        dirty = true;
+    }
+}
+
+void CollisionDetector::set_radius( size_t body, real_t r )
+{
+    resize( body + 1 );
+    radii[body] = r;
+    dirty = true;
+}
+
+void CollisionDetector::set_encounter_distance( size_t body, real_t d )
+{
+    resize( body + 1 );
+    reach[body] = d;
+    dirty = true;
+}
+
+void CollisionDetector::remove( size_t body )
+{
+    if ( body < radii.size() ) {
+        radii[body] = 0;
+        reach[body] = 0;
+        dirty = true;
+    }
+}
+
+void CollisionDetector::begin_step( const System& sys )
+{
+    size_t n = sys.bodies.size();
+    resize( n );
+    start.resize( n );
+    for ( size_t i = 0; i < n; ++i )
+        start[i] = sys.bodies[i].position;
+    start_time = sys.time;
+}
+
+// moves allowed per body before the insertion sort gives up
+static const size_t MAX_SORT_MOVES = 8;
+
+// Insertion sort on lo.x: bodies move little per step, so the order from
+// the last step is nearly right and this is close to linear. A fresh or
+// badly scrambled order falls back to a full sort.
+void CollisionDetector::sort_axis( bool fresh )
+{
+    size_t budget = MAX_SORT_MOVES * order.size();
+    for ( size_t k = 1; !fresh && k < order.size(); ++k ) {
+        size_t body = order[k];
+        real_t x = lo[body].x;
+        size_t m = k;
+        for ( ; m > 0 && lo[order[m - 1]].x > x; --m )
+            order[m] = order[m - 1];
+        order[m] = body;
+        budget -= std::min( budget, k - m );
+        fresh = budget == 0;
+    }
+    if ( fresh ) {
+        const std::vector< Vector3 >& l = lo;
+        std::sort( order.begin(), order.end(), [&l]( size_t a, size_t b ) { return l[a].x < l[b].x; } );
+    }
+}
+
+void CollisionDetector::end_step( const System& sys )
+{
+    size_t n = std::min( sys.bodies.size(), start.size() );
+    bool fresh = dirty;
+    if ( dirty ) {
+        order.clear();
+        for ( size_t i = 0; i < n; ++i )
+            if ( radii[i] > 0 || reach[i] > 0 )
+                order.push_back( i );
+        dirty = false;
+    }
+
+    // boxes around each body's path over the step, wide enough for both
+    // contact and the encounter distance
+    lo.resize( n );
+    hi.resize( n );
+    for ( size_t k = 0; k < order.size(); ++k ) {
+        size_t i = order[k];
+        Vector3 extent = Vector3::filled( std::max( radii[i], reach[i] ) );
+        const Vector3& p = sys.bodies[i].position;
+        lo[i] = vmin( start[i], p ) - extent;
+        hi[i] = vmax( start[i], p ) + extent;
+    }
+    sort_axis( fresh );
+
+    candidates = 0;
+    for ( size_t k = 0; k < order.size(); ++k ) {
+        size_t i = order[k];
+        for ( size_t m = k + 1; m < order.size(); ++m ) {
+            size_t j = order[m];
+            if ( lo[j].x > hi[i].x )
+                break;
+            if ( lo[j].y > hi[i].y || lo[i].y > hi[j].y || lo[j].z > hi[i].z || lo[i].z > hi[j].z )
+                continue;
+            ++candidates;
+            narrow_phase( std::min( i, j ), std::max( i, j ), sys );
+        }
+    }
+}
+
+// The pair moves in a straight line relative to each other over the
+// step: d(t) = d0 + t v for t in [0, 1].
+void CollisionDetector::narrow_phase( size_t a, size_t b, const System& sys )
+{
+    const Body& body_a = sys.bodies[a];
+    const Body& body_b = sys.bodies[b];
+    Vector3 d0 = start[b] - start[a];
+    Vector3 v = ( body_b.position - body_a.position ) - d0;
+    real_t vv = squared_length( v ), dv = dot( d0, v ), dd = squared_length( d0 );
+    real_t dt = sys.time - start_time;
+
+    Encounter e;
+    e.a = a;
+    e.b = b;
+    e.relative_velocity = body_b.velocity - body_a.velocity;
+
+    // first contact: |d(t)| = r_a + r_b
+    real_t contact = radii[a] + radii[b];
+    if ( contact > 0 && dv < 0 ) {
+        real_t c = dd - contact * contact;
+        real_t disc = dv * dv - vv * c;
+        real_t t = -1;
+        if ( c <= 0 )
+            t = 0; // already touching and still closing
+        else if ( disc >= 0 )
+            t = c / ( -dv + sqrt( disc ) ); // smaller root, stable form
+        if ( t >= 0 && t <= 1 ) {
+            Vector3 d = d0 + v * t;
+            e.type = Encounter::IMPACT;
+            e.time = start_time + t * dt;
+            e.distance = length( d );
+            e.normal = e.distance > 0 ? d / e.distance : Vector3::Zero;
+            events.push( e );
+            return;
+        }
+    }
+
+    // closest approach, if it falls inside this step
+    real_t range = std::max( reach[a], reach[b] );
+    if ( range > 0 && vv > 0 && dv < 0 ) {
+        real_t t = -dv / vv;
+        if ( t <= 1 ) {
+            Vector3 d = d0 + v * t;
+            real_t dist = length( d );
+            if ( dist < range ) {
+                e.type = Encounter::CLOSE_APPROACH;
+                e.time = start_time + t * dt;
+                e.distance = dist;
+                e.normal = dist > 0 ? d / dist : Vector3::Zero;
+                events.push( e );
+            }
+        }
+    }
+}
+
+void CollisionDetector::add_handler( Encounter::Type type, EncounterHandler* handler )
+{
+    handlers[type].push_back( handler );
+}
+
+void CollisionDetector::handle_events( System& sys )
+{
+    while ( !events.empty() ) {
+        Encounter e = events.top();
+        events.pop();
+        // a handler may have removed one of the bodies since
+        if ( radii[e.a] <= 0 && reach[e.a] <= 0 )
+            continue;
+        if ( radii[e.b] <= 0 && reach[e.b] <= 0 )
+            continue;
+        std::vector< EncounterHandler* >& list = handlers[e.type];
+        for ( size_t h = 0; h < list.size(); ++h )
+            list[h]->handle( sys, *this, e );
+    }
+}
+
+void EncounterLog::handle( System&, CollisionDetector&, const Encounter& e )
+{
+    out << ( e.type == Encounter::IMPACT ? "Impact" : "Close approach" )
+        << " between bodies " << e.a << " and " << e.b
+        << " at t = " << e.time << " s: distance " << e.distance
+        << " m, relative speed " << length( e.relative_velocity ) << " m/s" << std::endl;
+}
+
+// splits a change in relative velocity between the bodies so momentum
+// is kept; a massless body takes all of it
+static void mass_fractions( const Body& a, const Body& b, real_t& fa, real_t& fb )
+{
+    real_t total = a.mass + b.mass;
+    if ( total > 0 ) {
+        fa = b.mass / total;
+        fb = a.mass / total;
+    } else {
+        fa = fb = real_t( 0.5 );
+    }
+}
+
+void EncounterBounce::handle( System& sys, CollisionDetector&, const Encounter& e )
+{
+    Body& a = sys.bodies[e.a];
+    Body& b = sys.bodies[e.b];
+    // the line of centres at contact: by the end of a step a fast pair
+    // may already be past each other
+    const Vector3& normal = e.normal;
+    real_t approach = dot( b.velocity - a.velocity, normal );
+    if ( approach >= 0 )
+        return;
+
+    real_t fa, fb;
+    mass_fractions( a, b, fa, fb );
+    Vector3 change = normal * ( -( 1 + restitution ) * approach );
+    a.velocity -= change * fa;
+    b.velocity += change * fb;
+}
+
+void EncounterMerge::handle( System& sys, CollisionDetector& detector, const Encounter& e )
+{
+    size_t keep = e.a, lose = e.b;
+    if ( sys.bodies[lose].mass > sys.bodies[keep].mass )
+        std::swap( keep, lose );
+    Body& k = sys.bodies[keep];
+    Body& l = sys.bodies[lose];
+
+    real_t total = k.mass + l.mass;
+    if ( total > 0 ) {
+        k.position = ( k.position * k.mass + l.position * l.mass ) / total;
+        k.velocity = ( k.velocity * k.mass + l.velocity * l.mass ) / total;
+    }
+    k.mass = total;
+    k.exerts_grav = k.exerts_grav || l.exerts_grav;
+
+    // same volume
+    real_t rk = detector.get_radius( keep ), rl = detector.get_radius( lose );
+    detector.set_radius( keep, std::cbrt( rk * rk * rk + rl * rl * rl ) );
+    detector.set_encounter_distance( keep, std::max( detector.get_encounter_distance( keep ),
+                                                     detector.get_encounter_distance( lose ) ) );
+
+    l.mass = 0;
+    l.exerts_grav = false;
+    l.thrust = Vector3::Zero;
+    detector.remove( lose );
+}
+
+} // NEWTON
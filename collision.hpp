@@ -0,0 +1,142 @@
+#ifndef _COLLISION_HPP_
+#define _COLLISION_HPP_
+
+#include <iosfwd>
+#include <queue>
+#include <vector>
+
+#include "system.hpp"
+#include "vector.hpp"
+
+namespace NEWTON {
+
+// A contact or close approach between bodies a < b found during a step.
+struct Encounter
+{
+    enum Type { IMPACT, CLOSE_APPROACH, NUM_TYPES };
+
+    Type type;
+    size_t a, b;
+    real_t time;               // system time of first contact or closest approach
+    real_t distance;           // centre separation then
+    Vector3 normal;            // unit vector from a to b then
+    Vector3 relative_velocity; // of b with respect to a, at the end of the step
+};
+
+class CollisionDetector;
+
+// Reacts to encounters as they are taken off the queue. Handlers are
+// registered per encounter type and not owned by the detector.
+class EncounterHandler {
+public:
+    virtual ~EncounterHandler() { }
+    virtual void handle( System& sys, CollisionDetector& detector, const Encounter& e ) = 0;
+};
+
+/*
+Finds bodies that touch or pass close during a step.
+
+Each body has a radius and optionally an encounter distance: an approach
+within the larger encounter distance of a pair is reported once, at its
+closest point, and spheres that come into contact are reported as an
+impact at the moment they first touch. Bodies with neither (the default)
+are ignored, so large swarms of points cost nothing until given a size.
+
+begin_step() remembers where the bodies are, end_step() sweeps each
+body's bounding box over the step and finds the pairs whose boxes
+overlap by sweep and prune along x. The order of bodies along x is kept
+between steps and repaired by insertion sort, which is nearly linear
+when bodies move a little per step (a full sort takes over when they
+don't), and the sweep only visits pairs
+that overlap on x, so the broad phase costs O(N + overlaps) rather than
+O(N^2). Candidate pairs are tested exactly for their relative straight
+line motion over the step (swept spheres), so fast bodies can't tunnel
+through each other between steps.
+
+Encounters wait in a queue ordered by time until handle_events() passes
+each to the handlers registered for its type.
+*/
+class CollisionDetector {
+public:
+    CollisionDetector();
+
+    void set_radius( size_t body, real_t r );
+    real_t get_radius( size_t body ) const { return body < radii.size() ? radii[body] : 0; }
+    void set_encounter_distance( size_t body, real_t d );
+    real_t get_encounter_distance( size_t body ) const { return body < reach.size() ? reach[body] : 0; }
+
+    // Stops reporting a body, as after it has been merged into another.
+    void remove( size_t body );
+
+    void begin_step( const System& sys );
+    void end_step( const System& sys );
+
+    void add_handler( Encounter::Type type, EncounterHandler* handler );
+    void handle_events( System& sys );
+
+    bool pending() const { return !events.empty(); }
+    const Encounter& next() const { return events.top(); }
+    void pop() { events.pop(); }
+
+    size_t num_candidates() const { return candidates; }
+
+private:
+    struct Later
+    {
+        bool operator()( const Encounter& x, const Encounter& y ) const { return x.time > y.time; }
+    };
+
+    void resize( size_t n );
+    void sort_axis( bool fresh );
+    void narrow_phase( size_t a, size_t b, const System& sys );
+
+    std::vector< real_t > radii;
+    std::vector< real_t > reach;
+
+    // positions at begin_step and the time then
+    std::vector< Vector3 > start;
+    real_t start_time;
+
+    // swept boxes and the bodies with a size in order of lo.x
+    std::vector< Vector3 > lo, hi;
+    std::vector< size_t > order;
+
+    size_t candidates;
+    bool dirty; // order must be rebuilt
+    std::priority_queue< Encounter, std::vector< Encounter >, Later > events;
+    std::vector< EncounterHandler* > handlers[Encounter::NUM_TYPES];
+};
+
+// Prints each encounter on a line.
+class EncounterLog : public EncounterHandler {
+public:
+    explicit EncounterLog( std::ostream& out ) : out( out ) { }
+    virtual void handle( System& sys, CollisionDetector& detector, const Encounter& e );
+
+private:
+    std::ostream& out;
+};
+
+// Reflects the approaching part of the relative velocity along the line
+// of centres at contact, keeping momentum: restitution 1 is elastic, 0
+// stops the approach dead. Positions are left alone.
+class EncounterBounce : public EncounterHandler {
+public:
+    explicit EncounterBounce( real_t restitution = 1 ) : restitution( restitution ) { }
+    virtual void handle( System& sys, CollisionDetector& detector, const Encounter& e );
+
+private:
+    real_t restitution;
+};
+
+// Folds the lighter body into the heavier at their centre of mass,
+// keeping mass and momentum. Body indices must stay valid, so the lighter
+// one is left in place as a massless, non-colliding test particle.
+class EncounterMerge : public EncounterHandler {
+public:
+    virtual void handle( System& sys, CollisionDetector& detector, const Encounter& e );
+};
+
+} // NEWTON
+
+#endif
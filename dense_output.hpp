@@ -0,0 +1,130 @@
+#ifndef _DENSE_OUTPUT_HPP_
+#define _DENSE_OUTPUT_HPP_
+
+#include <vector>
+
+#include "math.hpp"
+#include "double_double.hpp"
+
+namespace NEWTON {
+
+template<typename T> class BasicIntegrableSystem;
+
+/*
+Dense output: the state of an integrable system at any time inside the
+last step, without stepping there. Integrators that keep one return it
+from dense_output(). Event location (event.hpp) samples it to find when
+a crossing happened, so it can pin event times down to a tolerance
+however long the steps are, and output (trails, exported trajectories)
+can be taken at its own cadence rather than once per step.
+*/
+template<typename T>
+class BasicDenseOutput {
+public:
+    virtual ~BasicDenseOutput() { }
+
+    // Fills out with the state at time t, for t0 <= t <= t1.
+    virtual void state( T t, T* out ) const = 0;
+
+    // Sets a system of the size the step was taken with to its state at
+    // time t. scratch is resized as needed.
+    void apply( BasicIntegrableSystem<T>& sys, T t, std::vector< T >& scratch ) const
+    {
+        scratch.resize( sys.size() );
+        state( t, &scratch[0] );
+        sys.set_state( &scratch[0], t );
+    }
+
+    T start_time() const { return t0; }
+    T end_time() const { return t1; }
+
+protected:
+    BasicDenseOutput() : t0( 0 ), t1( 0 ) { }
+    T t0, t1;
+};
+
+/*
+Cubic Hermite interpolation of each state element from its value and
+derivative at both ends of the step. Works for any integrator; the
+error is O(h^4), a step's worth of third-order accuracy. For a system
+of positions and velocities this is the usual Hermite scheme: positions
+from x and v at both ends, velocities from v and a.
+*/
+template<typename T>
+class BasicHermiteDenseOutput : public BasicDenseOutput<T> {
+public:
+    typedef std::vector< T > StateList;
+
+    // y and f are the state and its derivative (from eval_deriv), n long.
+    void set( size_t n, T t0, const T* y0, const T* f0, T t1, const T* y1, const T* f1 )
+    {
+        this->t0 = t0;
+        this->t1 = t1;
+        a.assign( y0, y0 + n ); b.assign( y1, y1 + n );
+        da.assign( f0, f0 + n ); db.assign( f1, f1 + n );
+    }
+
+    virtual void state( T t, T* out ) const
+    {
+        T h = this->t1 - this->t0;
+        T s = h != T( 0 ) ? ( t - this->t0 ) / h : T( 0 );
+        T s2 = s * s, s3 = s2 * s;
+        T h00 = 2 * s3 - 3 * s2 + 1, h01 = 3 * s2 - 2 * s3;
+        T h10 = ( s3 - 2 * s2 + s ) * h, h11 = ( s3 - s2 ) * h;
+        for ( size_t i = 0; i < a.size(); ++i )
+            out[i] = h00 * a[i] + h10 * da[i] + h01 * b[i] + h11 * db[i];
+    }
+
+private:
+    StateList a, b, da, db;
+};
+
+/*
+The continuous extension of classical RK4 (Hairer, Norsett & Wanner,
+II.6), built from the step's own stages:
+
+    y(t0 + s h) = y0 + h ( b1(s) k1 + b2(s) (k2 + k3) + b4(s) k4 )
+
+    b1 = s - 3 s^2 / 2 + 2 s^3 / 3,  b2 = s^2 - 2 s^3 / 3,
+    b4 = -s^2 / 2 + 2 s^3 / 3
+
+Third order, exact at both ends, and free: no extra evaluations. It
+reads the integrator's buffers, so it is valid until the next step.
+*/
+template<typename T>
+class BasicRungeKuttaDenseOutput : public BasicDenseOutput<T> {
+public:
+    BasicRungeKuttaDenseOutput() : n( 0 ), y0( 0 ), k1( 0 ), k2( 0 ), k3( 0 ), k4( 0 ) { }
+
+    void set( size_t size, T start, T dt, const T* y, const T* a, const T* b, const T* c, const T* d )
+    {
+        n = size;
+        this->t0 = start;
+        this->t1 = start + dt;
+        y0 = y; k1 = a; k2 = b; k3 = c; k4 = d;
+    }
+
+    virtual void state( T t, T* out ) const
+    {
+        T h = this->t1 - this->t0;
+        T s = h != T( 0 ) ? ( t - this->t0 ) / h : T( 0 );
+        T s2 = s * s, s3 = s2 * s;
+        T b1 = ( s - T( 1.5 ) * s2 + T( 2 ) * s3 / T( 3 ) ) * h;
+        T b2 = ( s2 - T( 2 ) * s3 / T( 3 ) ) * h;
+        T b4 = ( T( 2 ) * s3 / T( 3 ) - T( 0.5 ) * s2 ) * h;
+        for ( size_t i = 0; i < n; ++i )
+            out[i] = y0[i] + b1 * k1[i] + b2 * ( k2[i] + k3[i] ) + b4 * k4[i];
+    }
+
+private:
+    size_t n;
+    const T *y0, *k1, *k2, *k3, *k4;
+};
+
+typedef BasicDenseOutput< real_t > DenseOutput;
+typedef BasicHermiteDenseOutput< real_t > HermiteDenseOutput;
+typedef BasicRungeKuttaDenseOutput< real_t > RungeKuttaDenseOutput;
+
+} // NEWTON
+
+#endif
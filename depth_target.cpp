@@ -0,0 +1,90 @@
+#include "depth_target.hpp"
+#include "math.hpp"
+
+namespace NEWTON {
+
+ReversedZTarget::ReversedZTarget()
+    : fbo( 0 ), color( 0 ), depth( 0 ), width( 0 ), height( 0 ) { }
+
+bool ReversedZTarget::create( int w, int h )
+{
+    load_gl_extensions();
+    destroy();
+    if ( !gl_ext.has_framebuffers || !gl_ext.has_clip_control || !gl_ext.has_depth_float )
+        return false;
+
+    width = w;
+    height = h;
+
+    gl_ext.GenRenderbuffers( 1, &color );
+    gl_ext.BindRenderbuffer( GL_RENDERBUFFER, color );
+    gl_ext.RenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+    gl_ext.GenRenderbuffers( 1, &depth );
+    gl_ext.BindRenderbuffer( GL_RENDERBUFFER, depth );
+    gl_ext.RenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height );
+    gl_ext.BindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+    gl_ext.GenFramebuffers( 1, &fbo );
+    gl_ext.BindFramebuffer( GL_FRAMEBUFFER, fbo );
+    gl_ext.FramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color );
+    gl_ext.FramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth );
+    bool complete = gl_ext.CheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE;
+    gl_ext.BindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+    if ( !complete ) {
+        destroy();
+        return false;
+    }
+
+    gl_ext.ClipControl( GL_LOWER_LEFT, GL_ZERO_TO_ONE );
+    glClearDepth( 0.0 );
+    glDepthFunc( GL_GEQUAL );
+    return true;
+}
+
+void ReversedZTarget::destroy()
+{
+    if ( fbo ) {
+        gl_ext.DeleteFramebuffers( 1, &fbo );
+        gl_ext.ClipControl( GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE );
+        glClearDepth( 1.0 );
+        glDepthFunc( GL_LEQUAL );
+    }
+    if ( color )
+        gl_ext.DeleteRenderbuffers( 1, &color );
+    if ( depth )
+        gl_ext.DeleteRenderbuffers( 1, &depth );
+    fbo = color = depth = 0;
+}
+
+void ReversedZTarget::begin_frame()
+{
+    if ( fbo )
+        gl_ext.BindFramebuffer( GL_FRAMEBUFFER, fbo );
+}
+
+void ReversedZTarget::end_frame()
+{
+    if ( !fbo )
+        return;
+    gl_ext.BindFramebuffer( GL_READ_FRAMEBUFFER, fbo );
+    gl_ext.BindFramebuffer( GL_DRAW_FRAMEBUFFER, 0 );
+    gl_ext.BlitFramebuffer( 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST );
+    gl_ext.BindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+void reversed_z_perspective( GLdouble fovY, GLdouble aspect, GLdouble zNear )
+{
+    // column major; clip z is the constant zNear and clip w is -z_eye, so
+    // depth = zNear / -z_eye: 1 at the near plane, 0 at infinity
+    GLdouble f = 1.0 / tan( fovY / 360 * PI );
+    GLdouble m[16] = {
+        f / aspect, 0, 0,     0,
+        0,          f, 0,     0,
+        0,          0, 0,    -1,
+        0,          0, zNear, 0
+    };
+    glLoadMatrixd( m );
+}
+
+} /* NEWTON */
@@ -0,0 +1,50 @@
+#ifndef _DEPTH_TARGET_HPP_
+#define _DEPTH_TARGET_HPP_
+
+#include "gl_ext.hpp"
+
+namespace NEWTON {
+
+/*
+An offscreen framebuffer with a 32-bit floating point depth buffer, set
+up for reversed-Z: depth 1 at the near plane falling toward 0 at
+infinity, compared with GL_GEQUAL. Floating point is densest near zero,
+so mapping the far field there spreads precision almost evenly over
+distance, which a 24-bit fixed point buffer with a 0.1 m near plane
+can't do across solar-system scales.
+
+Scenes are drawn into the target between begin_frame() and end_frame(),
+which then copies the colour into the window. If the context lacks
+clip control (4.5 or ARB_clip_control), framebuffer objects or float
+depth (3.0 or the ARB extensions), create() fails and rendering should
+use the conventional depth setup.
+*/
+class ReversedZTarget {
+public:
+    ReversedZTarget();
+
+    // Must be called with a current context. Also switches the global
+    // depth state (clip control, clear depth, depth func) to reversed-Z.
+    bool create( int width, int height );
+    void destroy();
+    bool is_active() const { return fbo != 0; }
+
+    void begin_frame();
+    void end_frame();
+
+private:
+    GLuint fbo;
+    GLuint color;
+    GLuint depth;
+    int width;
+    int height;
+};
+
+// Loads a reversed-Z perspective projection with an infinite far plane
+// into the current matrix. Needs the clip control set up by
+// ReversedZTarget::create.
+void reversed_z_perspective( GLdouble fovY, GLdouble aspect, GLdouble zNear );
+
+} /* NEWTON */
+
+#endif /* _DEPTH_TARGET_HPP_ */
@@ -0,0 +1,136 @@
+#ifndef _DOUBLE_DOUBLE_HPP_
+#define _DOUBLE_DOUBLE_HPP_
+
+#include <cmath>
+#include <iostream>
+
+namespace NEWTON {
+
+/*
+A double-double number: an unevaluated sum hi + lo of two doubles with
+|lo| <= ulp(hi)/2, giving about 106 bits of significand (~32 decimal
+digits) at roughly 10-20x the cost of double. The algorithms are the
+error-free transformations of Dekker and Knuth as used in the QD
+library; products rely on a fused multiply-add for the exact low part.
+
+Only what the physics core needs is provided: arithmetic, comparisons,
+sqrt and abs. The exponent range is that of double.
+*/
+struct dd_real
+{
+    double hi, lo;
+
+    constexpr dd_real() : hi( 0.0 ), lo( 0.0 ) {}
+    constexpr dd_real( double d ) : hi( d ), lo( 0.0 ) {}
+    constexpr dd_real( double hi, double lo ) : hi( hi ), lo( lo ) {}
+
+    explicit operator double() const { return hi + lo; }
+    explicit operator float() const { return float( hi + lo ); }
+
+    dd_real& operator+=( const dd_real& b );
+    dd_real& operator-=( const dd_real& b );
+    dd_real& operator*=( const dd_real& b );
+    dd_real& operator/=( const dd_real& b );
+};
+
+// s + e == a + b exactly, given |a| >= |b|
+inline dd_real quick_two_sum( double a, double b )
+{
+    double s = a + b;
+    return dd_real( s, b - ( s - a ) );
+}
+
+// s + e == a + b exactly
+inline dd_real two_sum( double a, double b )
+{
+    double s = a + b;
+    double bb = s - a;
+    return dd_real( s, ( a - ( s - bb ) ) + ( b - bb ) );
+}
+
+// p + e == a * b exactly
+inline dd_real two_prod( double a, double b )
+{
+    double p = a * b;
+    return dd_real( p, std::fma( a, b, -p ) );
+}
+
+inline dd_real operator+( const dd_real& a, const dd_real& b )
+{
+    dd_real s = two_sum( a.hi, b.hi );
+    dd_real t = two_sum( a.lo, b.lo );
+    s.lo += t.hi;
+    s = quick_two_sum( s.hi, s.lo );
+    s.lo += t.lo;
+    return quick_two_sum( s.hi, s.lo );
+}
+
+inline dd_real operator-( const dd_real& a )
+{
+    return dd_real( -a.hi, -a.lo );
+}
+
+inline dd_real operator-( const dd_real& a, const dd_real& b )
+{
+    return a + -b;
+}
+
+inline dd_real operator*( const dd_real& a, const dd_real& b )
+{
+    dd_real p = two_prod( a.hi, b.hi );
+    p.lo += a.hi * b.lo + a.lo * b.hi;
+    return quick_two_sum( p.hi, p.lo );
+}
+
+inline dd_real operator/( const dd_real& a, const dd_real& b )
+{
+    // long division: two correction steps on the double quotient
+    double q1 = a.hi / b.hi;
+    dd_real r = a - b * dd_real( q1 );
+    double q2 = r.hi / b.hi;
+    r -= b * dd_real( q2 );
+    double q3 = r.hi / b.hi;
+    dd_real q = quick_two_sum( q1, q2 );
+    return q + dd_real( q3 );
+}
+
+inline dd_real& dd_real::operator+=( const dd_real& b ) { return *this = *this + b; }
+inline dd_real& dd_real::operator-=( const dd_real& b ) { return *this = *this - b; }
+inline dd_real& dd_real::operator*=( const dd_real& b ) { return *this = *this * b; }
+inline dd_real& dd_real::operator/=( const dd_real& b ) { return *this = *this / b; }
+
+inline bool operator==( const dd_real& a, const dd_real& b ) { return a.hi == b.hi && a.lo == b.lo; }
+inline bool operator!=( const dd_real& a, const dd_real& b ) { return !( a == b ); }
+inline bool operator<( const dd_real& a, const dd_real& b ) { return a.hi < b.hi || ( a.hi == b.hi && a.lo < b.lo ); }
+inline bool operator>( const dd_real& a, const dd_real& b ) { return b < a; }
+inline bool operator<=( const dd_real& a, const dd_real& b ) { return !( b < a ); }
+inline bool operator>=( const dd_real& a, const dd_real& b ) { return !( a < b ); }
+
+// The overloads below would otherwise hide std::sqrt and std::fabs from
+// unqualified calls anywhere in NEWTON.
+using std::sqrt;
+using std::fabs;
+
+inline dd_real sqrt( const dd_real& a )
+{
+    // one Newton step from the double square root doubles its precision
+    if ( a.hi <= 0.0 )
+        return dd_real( std::sqrt( a.hi ) );
+    double x = std::sqrt( a.hi );
+    dd_real r = a - two_prod( x, x );
+    return quick_two_sum( x, r.hi / ( 2.0 * x ) );
+}
+
+inline dd_real fabs( const dd_real& a )
+{
+    return a.hi < 0.0 ? -a : a;
+}
+
+inline std::ostream& operator<<( std::ostream& os, const dd_real& a )
+{
+    return os << a.hi << ( a.lo < 0 ? "-" : "+" ) << std::fabs( a.lo );
+}
+
+} /* NEWTON */
+
+#endif /* _DOUBLE_DOUBLE_HPP_ */
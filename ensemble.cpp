@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "ensemble.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+namespace NEWTON {
+
+static const size_t BLOCK = 8; // members per thread work item: one cache line of doubles
+static const size_t MIN_BLOCKS_PER_THREAD = 4;
+
+// Views of the state rows handed to the force kernels; see Ensemble.
+struct EnsembleArrays
+{
+    const real_t* y;
+    real_t* f;
+    const real_t* gm;
+    const size_t* sources;
+    size_t num_sources, num_bodies, width;
+};
+
+// Accelerations of every body for members [m0, m0 + BLOCK), with the
+// operations in the order of System::direct_gravity so each member's
+// forces round the same way. Coincident bodies contribute nothing.
+static void scalar_accelerations( const EnsembleArrays& e, size_t m0 )
+{
+    size_t w = e.width;
+    for ( size_t i = 0; i < e.num_bodies; ++i ) {
+        const real_t *xi = e.y + ( i * 6 + 0 ) * w, *yi = e.y + ( i * 6 + 1 ) * w, *zi = e.y + ( i * 6 + 2 ) * w;
+        real_t *ax = e.f + ( i * 6 + 3 ) * w, *ay = e.f + ( i * 6 + 4 ) * w, *az = e.f + ( i * 6 + 5 ) * w;
+        for ( size_t m = m0; m < m0 + BLOCK; ++m ) {
+            real_t axm = 0, aym = 0, azm = 0;
+            for ( size_t s = 0; s < e.num_sources; ++s ) {
+                size_t j = e.sources[s];
+                if ( j == i )
+                    continue;
+                real_t dx = e.y[( j * 6 + 0 ) * w + m] - xi[m];
+                real_t dy = e.y[( j * 6 + 1 ) * w + m] - yi[m];
+                real_t dz = e.y[( j * 6 + 2 ) * w + m] - zi[m];
+                real_t r2 = dx * dx + dy * dy + dz * dz;
+                real_t f = e.gm[j] * ( r2 > 0 ? 1 / ( r2 * std::sqrt( r2 ) ) : 0 );
+                axm += dx * f; aym += dy * f; azm += dz * f;
+            }
+            ax[m] = axm; ay[m] = aym; az[m] = azm;
+        }
+    }
+}
+
+#if SIMD_HAVE_AVX2
+// Same, four members per instruction; the two halves of the block are
+// kept in separate registers so their dependency chains overlap.
+// Compiled without FMA so no product and sum get fused, which would
+// round differently from the scalar path.
+SIMD_AVX2_NO_FMA static inline __m256d avx2_gm_inv_r3( __m256d gm, __m256d r2 )
+{
+    __m256d one = _mm256_set1_pd( 1.0 ), zero = _mm256_setzero_pd();
+    __m256d inv = _mm256_div_pd( one, _mm256_mul_pd( r2, _mm256_sqrt_pd( r2 ) ) );
+    return _mm256_mul_pd( gm, _mm256_and_pd( inv, _mm256_cmp_pd( r2, zero, _CMP_GT_OQ ) ) );
+}
+
+SIMD_AVX2_NO_FMA static void avx2_accelerations( const EnsembleArrays& e, size_t m0 )
+{
+    size_t w = e.width;
+    for ( size_t i = 0; i < e.num_bodies; ++i ) {
+        const real_t *xi = e.y + ( i * 6 + 0 ) * w + m0, *yi = e.y + ( i * 6 + 1 ) * w + m0, *zi = e.y + ( i * 6 + 2 ) * w + m0;
+        __m256d xa = _mm256_loadu_pd( xi ), ya = _mm256_loadu_pd( yi ), za = _mm256_loadu_pd( zi );
+        __m256d xb = _mm256_loadu_pd( xi + 4 ), yb = _mm256_loadu_pd( yi + 4 ), zb = _mm256_loadu_pd( zi + 4 );
+        __m256d axa = _mm256_setzero_pd(), aya = _mm256_setzero_pd(), aza = _mm256_setzero_pd();
+        __m256d axb = _mm256_setzero_pd(), ayb = _mm256_setzero_pd(), azb = _mm256_setzero_pd();
+        for ( size_t s = 0; s < e.num_sources; ++s ) {
+            size_t j = e.sources[s];
+            if ( j == i )
+                continue;
+            const real_t *xj = e.y + ( j * 6 + 0 ) * w + m0, *yj = e.y + ( j * 6 + 1 ) * w + m0, *zj = e.y + ( j * 6 + 2 ) * w + m0;
+            __m256d gm = _mm256_set1_pd( e.gm[j] );
+
+            __m256d dx = _mm256_sub_pd( _mm256_loadu_pd( xj ), xa );
+            __m256d dy = _mm256_sub_pd( _mm256_loadu_pd( yj ), ya );
+            __m256d dz = _mm256_sub_pd( _mm256_loadu_pd( zj ), za );
+            __m256d r2 = _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( dx, dx ), _mm256_mul_pd( dy, dy ) ), _mm256_mul_pd( dz, dz ) );
+            __m256d f = avx2_gm_inv_r3( gm, r2 );
+            axa = _mm256_add_pd( axa, _mm256_mul_pd( dx, f ) );
+            aya = _mm256_add_pd( aya, _mm256_mul_pd( dy, f ) );
+            aza = _mm256_add_pd( aza, _mm256_mul_pd( dz, f ) );
+
+            dx = _mm256_sub_pd( _mm256_loadu_pd( xj + 4 ), xb );
+            dy = _mm256_sub_pd( _mm256_loadu_pd( yj + 4 ), yb );
+            dz = _mm256_sub_pd( _mm256_loadu_pd( zj + 4 ), zb );
+            r2 = _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( dx, dx ), _mm256_mul_pd( dy, dy ) ), _mm256_mul_pd( dz, dz ) );
+            f = avx2_gm_inv_r3( gm, r2 );
+            axb = _mm256_add_pd( axb, _mm256_mul_pd( dx, f ) );
+            ayb = _mm256_add_pd( ayb, _mm256_mul_pd( dy, f ) );
+            azb = _mm256_add_pd( azb, _mm256_mul_pd( dz, f ) );
+        }
+        real_t *ax = e.f + ( i * 6 + 3 ) * w + m0, *ay = e.f + ( i * 6 + 4 ) * w + m0, *az = e.f + ( i * 6 + 5 ) * w + m0;
+        _mm256_storeu_pd( ax, axa ); _mm256_storeu_pd( ax + 4, axb );
+        _mm256_storeu_pd( ay, aya ); _mm256_storeu_pd( ay + 4, ayb );
+        _mm256_storeu_pd( az, aza ); _mm256_storeu_pd( az + 4, azb );
+    }
+}
+#endif
+
+Ensemble::Ensemble( const System& scenario, size_t members )
+    : scenario( scenario ), members( members ), width( ( members + BLOCK - 1 ) / BLOCK * BLOCK ), time( scenario.time )
+{
+    assert( members > 0 );
+    size_t n = scenario.bodies.size();
+    gm.resize( n );
+    for ( size_t i = 0; i < n; ++i ) {
+        gm[i] = G * scenario.bodies[i].mass;
+        if ( scenario.bodies[i].exerts_grav && scenario.bodies[i].mass > 0 )
+            sources.push_back( i );
+    }
+
+    size_t rows = n * 6;
+    state.resize( rows * width );
+    tmp.resize( rows * width );
+    k1.resize( rows * width ); k2.resize( rows * width );
+    k3.resize( rows * width ); k4.resize( rows * width );
+    for ( size_t i = 0; i < n; ++i )
+        for ( size_t m = 0; m < width; ++m )
+            set_state( m, i, scenario.bodies[i].position, scenario.bodies[i].velocity );
+}
+
+void Ensemble::set_state( size_t member, size_t body, const Vector3& position, const Vector3& velocity )
+{
+    assert( member < width && body < num_bodies() );
+    for ( int c = 0; c < 3; ++c ) {
+        at( state, body, c, member ) = position[c];
+        at( state, body, c + 3, member ) = velocity[c];
+    }
+    // padding follows member 0
+    if ( member == 0 )
+        for ( size_t m = members; m < width; ++m )
+            set_state( m, body, position, velocity );
+}
+
+Vector3 Ensemble::get_position( size_t member, size_t body ) const
+{
+    return Vector3( at( state, body, 0, member ), at( state, body, 1, member ), at( state, body, 2, member ) );
+}
+
+Vector3 Ensemble::get_velocity( size_t member, size_t body ) const
+{
+    return Vector3( at( state, body, 3, member ), at( state, body, 4, member ), at( state, body, 5, member ) );
+}
+
+System Ensemble::get_member( size_t member ) const
+{
+    System out( scenario );
+    for ( size_t i = 0; i < out.bodies.size(); ++i ) {
+        out.bodies[i].position = get_position( member, i );
+        out.bodies[i].velocity = get_velocity( member, i );
+    }
+    out.time = time;
+    return out;
+}
+
+void Ensemble::deriv( const std::vector< real_t >& y, std::vector< real_t >& f, size_t m0 ) const
+{
+    size_t n = num_bodies();
+    for ( size_t i = 0; i < n; ++i )
+        for ( int c = 0; c < 3; ++c )
+            std::copy( &y[( i * 6 + c + 3 ) * width + m0], &y[( i * 6 + c + 3 ) * width + m0] + BLOCK,
+                       &f[( i * 6 + c ) * width + m0] );
+
+    EnsembleArrays e = { &y[0], &f[0], &gm[0], sources.empty() ? 0 : &sources[0], sources.size(), n, width };
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() ) {
+        avx2_accelerations( e, m0 );
+        return;
+    }
+#endif
+    scalar_accelerations( e, m0 );
+}
+
+// Classical RK4 on members [m0, m0 + BLOCK); the other members' columns
+// of the shared buffers are left alone.
+void Ensemble::step_block( real_t dt, size_t m0 )
+{
+    size_t rows = num_bodies() * 6;
+    real_t half = dt / 2, sixth = dt / 6;
+
+    deriv( state, k1, m0 );
+    for ( size_t r = 0; r < rows; ++r )
+        for ( size_t m = r * width + m0; m < r * width + m0 + BLOCK; ++m )
+            tmp[m] = state[m] + half * k1[m];
+    deriv( tmp, k2, m0 );
+    for ( size_t r = 0; r < rows; ++r )
+        for ( size_t m = r * width + m0; m < r * width + m0 + BLOCK; ++m )
+            tmp[m] = state[m] + half * k2[m];
+    deriv( tmp, k3, m0 );
+    for ( size_t r = 0; r < rows; ++r )
+        for ( size_t m = r * width + m0; m < r * width + m0 + BLOCK; ++m )
+            tmp[m] = state[m] + dt * k3[m];
+    deriv( tmp, k4, m0 );
+    for ( size_t r = 0; r < rows; ++r )
+        for ( size_t m = r * width + m0; m < r * width + m0 + BLOCK; ++m )
+            state[m] += sixth * ( k1[m] + 2 * k2[m] + 2 * k3[m] + k4[m] );
+
+    update_trackers( m0 );
+}
+
+void Ensemble::step( real_t dt )
+{
+    parallel_for( 0, width / BLOCK, [this, dt]( size_t b ) { step_block( dt, b * BLOCK ); }, MIN_BLOCKS_PER_THREAD );
+    time += dt;
+}
+
+size_t Ensemble::track_miss_distance( size_t body, size_t target )
+{
+    assert( body < num_bodies() && target < num_bodies() );
+    MissTracker t;
+    t.body = body;
+    t.target = target;
+    t.last.resize( 3 * width );
+    t.min.resize( members );
+    for ( size_t m = 0; m < width; ++m ) {
+        Vector3 d = get_position( m, body ) - get_position( m, target );
+        for ( int c = 0; c < 3; ++c )
+            t.last[c * width + m] = d[c];
+        if ( m < members )
+            t.min[m] = length( d );
+    }
+    trackers.push_back( t );
+    return trackers.size() - 1;
+}
+
+// Closest approach over the step, taking the relative position to move
+// in a straight line from its value at the last step to its value now.
+void Ensemble::update_trackers( size_t m0 )
+{
+    size_t m1 = std::min( m0 + BLOCK, members );
+    for ( size_t k = 0; k < trackers.size(); ++k ) {
+        MissTracker& t = trackers[k];
+        for ( size_t m = m0; m < m1; ++m ) {
+            Vector3 d1 = get_position( m, t.body ) - get_position( m, t.target );
+            Vector3 d0( t.last[m], t.last[width + m], t.last[2 * width + m] );
+            Vector3 e = d1 - d0;
+            real_t e2 = dot( e, e );
+            real_t s = e2 > 0 ? std::min( real_t( 1 ), std::max( real_t( 0 ), -dot( d0, e ) / e2 ) ) : real_t( 0 );
+            t.min[m] = std::min( t.min[m], length( d0 + e * s ) );
+            for ( int c = 0; c < 3; ++c )
+                t.last[c * width + m] = d1[c];
+        }
+    }
+}
+
+real_t percentile( std::vector< real_t > values, real_t p )
+{
+    assert( !values.empty() );
+    real_t pos = std::min( std::max( p, real_t( 0 ) ), real_t( 100 ) ) / 100 * real_t( values.size() - 1 );
+    size_t lo = size_t( pos );
+    std::nth_element( values.begin(), values.begin() + lo, values.end() );
+    real_t a = values[lo];
+    if ( lo + 1 >= values.size() )
+        return a;
+    real_t b = *std::min_element( values.begin() + lo + 1, values.end() );
+    return a + ( b - a ) * ( pos - real_t( lo ) );
+}
+
+} // NEWTON
@@ -0,0 +1,97 @@
+#ifndef _ENSEMBLE_HPP_
+#define _ENSEMBLE_HPP_
+
+#include <vector>
+
+#include "system.hpp"
+
+namespace NEWTON {
+
+/*
+Many copies of one scenario, each with its own initial conditions,
+stepped together: Monte Carlo dispersion runs without a process (or a
+System) per sample.
+
+Every member has the same bodies, masses and exerts_grav flags as the
+scenario it was built from; only positions and velocities differ. The
+state is stored SoA with the member index fastest, so for any body and
+component the values of all members sit side by side:
+
+    state[( body * 6 + component ) * width + member]
+
+with width the member count rounded up to a multiple of eight (padded
+with copies of member 0). The force kernel takes one target and one
+source at a time and four members per AVX2 instruction, so the SIMD
+lanes are ensemble members, never bodies, and no lane is wasted however
+few bodies there are. Members are handed to threads in blocks of eight,
+one cache line of each row, and each thread runs whole RK4 steps on its
+blocks, so threads neither share lines nor wait on each other within a
+step. Only bodies with exerts_grav are sources, as in System; the
+scenario's gravity solver, softening and thrust aren't used, so this is
+for ballistic dispersion (launch or injection errors), not powered
+flight. The kernels and the RK4 update do their arithmetic in the same
+order as System::direct_gravity and RungeKuttaIntegrator, without FMA,
+so a member follows exactly the trajectory a lone System would when
+that is built without FMA contraction too.
+
+Statistics are gathered while stepping. A miss distance tracker keeps,
+per member, the closest approach of one body to another, taken from
+the straight-line relative motion across each step so a fast flyby
+between steps isn't missed; percentile() then summarises the members.
+*/
+class Ensemble {
+public:
+    Ensemble( const System& scenario, size_t members );
+
+    size_t num_members() const { return members; }
+    size_t num_bodies() const { return scenario.bodies.size(); }
+    real_t get_time() const { return time; }
+
+    void set_state( size_t member, size_t body, const Vector3& position, const Vector3& velocity );
+    Vector3 get_position( size_t member, size_t body ) const;
+    Vector3 get_velocity( size_t member, size_t body ) const;
+
+    // The scenario with one member's state, e.g. to continue it alone.
+    System get_member( size_t member ) const;
+
+    // One RK4 step of dt for every member.
+    void step( real_t dt );
+
+    // Starts tracking the closest approach of body to target, from the
+    // current state on. Returns an index for miss_distances().
+    size_t track_miss_distance( size_t body, size_t target );
+    // Closest approach so far, per member.
+    const std::vector< real_t >& miss_distances( size_t tracker ) const { return trackers[tracker].min; }
+
+private:
+    struct MissTracker
+    {
+        size_t body, target;
+        std::vector< real_t > last; // relative position at the last step, 3 rows of width
+        std::vector< real_t > min;  // per member
+    };
+
+    real_t& at( std::vector< real_t >& s, size_t body, int c, size_t m ) const { return s[( body * 6 + c ) * width + m]; }
+    real_t at( const std::vector< real_t >& s, size_t body, int c, size_t m ) const { return s[( body * 6 + c ) * width + m]; }
+
+    void deriv( const std::vector< real_t >& y, std::vector< real_t >& f, size_t m0 ) const;
+    void step_block( real_t dt, size_t m0 );
+    void update_trackers( size_t m0 );
+
+    System scenario; // masses and flags
+    std::vector< size_t > sources;
+    std::vector< real_t > gm;
+    size_t members, width;
+    real_t time;
+
+    std::vector< real_t > state, tmp, k1, k2, k3, k4;
+    std::vector< MissTracker > trackers;
+};
+
+// The p-th percentile (0 <= p <= 100) of values, interpolating linearly
+// between order statistics. Takes a copy since it reorders.
+real_t percentile( std::vector< real_t > values, real_t p );
+
+} // NEWTON
+
+#endif
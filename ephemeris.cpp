@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <cassert>
+
+#include "ephemeris.hpp"
+
+namespace NEWTON {
+
+void SampledEphemeris::record( const System& sys )
+{
+    assert( times.empty() || ( sys.time > times.back() && sys.bodies.size() == num_bodies ) );
+    num_bodies = sys.bodies.size();
+    times.push_back( sys.time );
+    for ( size_t i = 0; i < num_bodies; ++i ) {
+        positions.push_back( sys.bodies[i].position );
+        velocities.push_back( sys.bodies[i].velocity );
+    }
+}
+
+void SampledEphemeris::generate( System sys, const Integrator& integrator, real_t interval, real_t duration )
+{
+    assert( interval > 0 );
+    real_t end = sys.time + duration;
+    record( sys );
+    while ( sys.time < end ) {
+        integrator.integrate( sys, std::min( interval, end - sys.time ) );
+        record( sys );
+    }
+}
+
+void SampledEphemeris::state( size_t body, real_t time, Vector3& position, Vector3& velocity ) const
+{
+    assert( !times.empty() && body < num_bodies );
+    if ( times.size() == 1 || time <= times.front() ) {
+        position = positions[body];
+        velocity = velocities[body];
+        return;
+    }
+    if ( time >= times.back() ) {
+        position = positions[( times.size() - 1 ) * num_bodies + body];
+        velocity = velocities[( times.size() - 1 ) * num_bodies + body];
+        return;
+    }
+
+    size_t k = std::upper_bound( times.begin(), times.end(), time ) - times.begin() - 1;
+    const Vector3& p0 = positions[k * num_bodies + body];
+    const Vector3& p1 = positions[( k + 1 ) * num_bodies + body];
+    const Vector3& v0 = velocities[k * num_bodies + body];
+    const Vector3& v1 = velocities[( k + 1 ) * num_bodies + body];
+    real_t h = times[k + 1] - times[k];
+    real_t s = ( time - times[k] ) / h;
+    real_t s2 = s * s, s3 = s2 * s;
+
+    real_t h00 = 2 * s3 - 3 * s2 + 1, h01 = 3 * s2 - 2 * s3;
+    real_t h10 = ( s3 - 2 * s2 + s ) * h, h11 = ( s3 - s2 ) * h;
+    position = p0 * h00 + v0 * h10 + p1 * h01 + v1 * h11;
+
+    // d/dt of the same cubic
+    real_t d00 = ( 6 * s2 - 6 * s ) / h, d01 = -d00;
+    real_t d10 = 3 * s2 - 4 * s + 1, d11 = 3 * s2 - 2 * s;
+    velocity = p0 * d00 + v0 * d10 + p1 * d01 + v1 * d11;
+}
+
+} // NEWTON
@@ -0,0 +1,63 @@
+#ifndef _EPHEMERIS_HPP_
+#define _EPHEMERIS_HPP_
+
+#include <vector>
+
+#include "integrator.hpp"
+#include "system.hpp"
+
+namespace NEWTON {
+
+// Positions and velocities of bodies at any time in a span, without
+// integrating there: what mission planning asks for millions of times.
+class Ephemeris {
+public:
+    virtual ~Ephemeris() { }
+
+    virtual void state( size_t body, real_t time, Vector3& position, Vector3& velocity ) const = 0;
+
+    virtual real_t start_time() const = 0;
+    virtual real_t end_time() const = 0;
+};
+
+/*
+An ephemeris cached from simulation output: the states of every body at
+a series of sample times, interpolated between them with cubic Hermite
+polynomials in position and velocity (velocities from the derivative of
+the same cubic). The position error is about h^4 w^4 r / 384 for a body
+on an orbit of radius r and angular rate w sampled every h; a planet
+sampled daily is off by tens of metres at Earth's distance, and by less
+further out. Lookups are a binary search and one cubic, so the samples
+can be spaced unevenly, e.g. as the integrator's own steps.
+*/
+class SampledEphemeris : public Ephemeris {
+public:
+    SampledEphemeris() : num_bodies( 0 ) { }
+    virtual ~SampledEphemeris() { }
+
+    void clear() { times.clear(); positions.clear(); velocities.clear(); num_bodies = 0; }
+
+    // Appends the state of sys at sys.time, which must be later than the
+    // last sample's. All samples must have the same number of bodies.
+    void record( const System& sys );
+
+    // Integrates a copy of sys for duration, recording every interval.
+    void generate( System sys, const Integrator& integrator, real_t interval, real_t duration );
+
+    size_t num_samples() const { return times.size(); }
+
+    // Times outside the samples are clamped to the first or last.
+    virtual void state( size_t body, real_t time, Vector3& position, Vector3& velocity ) const;
+
+    virtual real_t start_time() const { return times.empty() ? real_t( 0 ) : times.front(); }
+    virtual real_t end_time() const { return times.empty() ? real_t( 0 ) : times.back(); }
+
+private:
+    size_t num_bodies;
+    std::vector< real_t > times;
+    std::vector< Vector3 > positions, velocities; // [sample * num_bodies + body]
+};
+
+} // NEWTON
+
+#endif
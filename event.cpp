@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+
+#include "event.hpp"
+#include "root_finding.hpp"
+
+namespace NEWTON {
+
+static const real_t DEFAULT_TIME_TOLERANCE = 1e-3; // s
+static const size_t DEFAULT_SAMPLES = 4;
+
+real_t ApsisEvent::value( const System& sys ) const
+{
+    const Body& b = sys.bodies[body];
+    const Body& p = sys.bodies[primary];
+    return dot( b.position - p.position, b.velocity - p.velocity );
+}
+
+real_t DistanceEvent::value( const System& sys ) const
+{
+    return length( sys.bodies[body].position - sys.bodies[primary].position ) - radius;
+}
+
+EventLocator::EventLocator()
+    : tolerance( DEFAULT_TIME_TOLERANCE ), samples( DEFAULT_SAMPLES ), dense( 0 ), have_end( false ), end_generation( 0 )
+{
+}
+
+size_t EventLocator::add( EventFunction* f, Direction d )
+{
+    functions.push_back( f );
+    directions.push_back( d );
+    return functions.size() - 1;
+}
+
+real_t EventLocator::value_at( size_t f, System& sys, real_t t )
+{
+    dense->state( t, &scratch[0] );
+    sys.set_state( &scratch[0], t );
+    return functions[f]->value( sys );
+}
+
+real_t EventLocator::locate( size_t f, System& sys, real_t a, real_t ga, real_t b, real_t gb )
+{
+    illinois( [&]( real_t t ) { return value_at( f, sys, t ); }, a, ga, b, gb, tolerance );
+    return ( a + b ) / 2;
+}
+
+void EventLocator::step( const Integrator& integrator, System& sys, real_t dt, std::vector< EventRecord >& out )
+{
+    size_t n = sys.size();
+    if ( functions.empty() || n == 0 ) {
+        integrator.integrate( sys, dt );
+        have_end = false;
+        return;
+    }
+
+    real_t t0, t1;
+    y0.resize( n ); scratch.resize( n );
+    sys.get_state( &y0[0], &t0 );
+    size_t num_functions = functions.size();
+    values.resize( num_functions );
+    for ( size_t f = 0; f < num_functions; ++f )
+        values[f] = functions[f]->value( sys );
+
+    // without the integrator's own dense output, interpolate from the
+    // derivative at both ends; the last step's end is this step's start
+    // unless someone moved the bodies or changed the forces in between
+    if ( !integrator.dense_output() ) {
+        f0.resize( n );
+        if ( have_end && y1.size() == n && y0 == y1 && sys.force_generation() == end_generation )
+            f0.swap( f1 );
+        else
+            sys.eval_deriv( &f0[0] );
+    }
+
+    integrator.integrate( sys, dt );
+    y1.resize( n );
+    sys.get_state( &y1[0], &t1 );
+    end_values.resize( num_functions );
+    for ( size_t f = 0; f < num_functions; ++f )
+        end_values[f] = functions[f]->value( sys );
+
+    // an integrator that keeps dense output has it from its first step on
+    dense = integrator.dense_output();
+    if ( !dense ) {
+        f1.resize( n );
+        sys.eval_deriv( &f1[0] );
+        hermite.set( n, t0, &y0[0], &f0[0], t1, &y1[0], &f1[0] );
+        dense = &hermite;
+        end_generation = sys.force_generation();
+    }
+    have_end = dense == &hermite;
+
+    found.clear();
+    for ( size_t f = 0; f < num_functions; ++f ) {
+        real_t a = t0, ga = values[f];
+        for ( size_t k = 1; k <= samples; ++k ) {
+            real_t b = k == samples ? t1 : t0 + ( t1 - t0 ) * real_t( k ) / real_t( samples );
+            real_t gb = k == samples ? end_values[f] : value_at( f, sys, b );
+            bool rising = ga < 0 && gb >= 0, falling = ga >= 0 && gb < 0;
+            if ( ( rising && ( directions[f] & RISING ) ) || ( falling && ( directions[f] & FALLING ) ) ) {
+                EventRecord r = { f, locate( f, sys, a, ga, b, gb ), rising };
+                found.push_back( r );
+            }
+            a = b;
+            ga = gb;
+        }
+    }
+    sys.set_state( &y1[0], t1 );
+
+    std::sort( found.begin(), found.end(), []( const EventRecord& x, const EventRecord& y ) { return x.time < y.time; } );
+    out.insert( out.end(), found.begin(), found.end() );
+}
+
+} // NEWTON
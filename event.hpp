@@ -0,0 +1,108 @@
+#ifndef _EVENT_HPP_
+#define _EVENT_HPP_
+
+#include <vector>
+
+#include "dense_output.hpp"
+#include "system.hpp"
+
+namespace NEWTON {
+
+// A scalar function of the system state; its zero crossings are events.
+class EventFunction {
+public:
+    virtual ~EventFunction() { }
+    virtual real_t value( const System& sys ) const = 0;
+};
+
+// Rising crossings of dot(r, v) for body relative to primary are
+// periapses, falling ones apoapses.
+class ApsisEvent : public EventFunction {
+public:
+    ApsisEvent( size_t body, size_t primary ) : body( body ), primary( primary ) { }
+    virtual real_t value( const System& sys ) const;
+
+private:
+    size_t body, primary;
+};
+
+// |r| - radius for body relative to primary: falling crossings enter the
+// sphere (an SOI entry, or a surface impact for the primary's radius),
+// rising ones leave it.
+class DistanceEvent : public EventFunction {
+public:
+    DistanceEvent( size_t body, size_t primary, real_t radius ) : body( body ), primary( primary ), radius( radius ) { }
+    virtual real_t value( const System& sys ) const;
+
+private:
+    size_t body, primary;
+    real_t radius;
+};
+
+struct EventRecord
+{
+    size_t event;  // index of the EventFunction, in order added
+    real_t time;
+    bool rising;   // the function went from negative to non-negative
+};
+
+/*
+Finds the times at which registered event functions cross zero.
+
+step() advances the system one step with any integrator and takes the
+integrator's dense output for the step (dense_output.hpp), or failing
+that a Hermite interpolant from the state and its derivative at both
+ends. Each function is sampled on that interpolant at a few points
+across the step; a sign change between
+samples is then narrowed down with the Illinois variant of regula falsi
+until the bracket is shorter than the time tolerance. The system is
+only ever advanced by the caller's dt, so events don't shrink the steps.
+Beyond the event functions at the sample and root-finding points, the
+cost is nothing with the integrator's dense output, or otherwise one
+force evaluation per step for the derivative at the end (reused as the
+start of the next step).
+
+Sampling several points per step catches a function that crosses and
+crosses back within one step (a periapsis on a short, eccentric orbit);
+crossings closer together than a sample spacing can still be missed.
+*/
+class EventLocator {
+public:
+    enum Direction { RISING = 1, FALLING = 2, BOTH = 3 };
+
+    EventLocator();
+
+    // Functions aren't owned. Returns the index reported in EventRecord.
+    size_t add( EventFunction* f, Direction d = BOTH );
+    void clear() { functions.clear(); directions.clear(); have_end = false; }
+
+    void set_time_tolerance( real_t t ) { tolerance = t; }
+    real_t get_time_tolerance() const { return tolerance; }
+    void set_samples( size_t n ) { samples = n > 0 ? n : 1; }
+    size_t get_samples() const { return samples; }
+
+    // Integrates sys by dt and appends the events found in the step, in
+    // time order.
+    void step( const Integrator& integrator, System& sys, real_t dt, std::vector< EventRecord >& out );
+
+private:
+    real_t value_at( size_t f, System& sys, real_t t );
+    real_t locate( size_t f, System& sys, real_t a, real_t ga, real_t b, real_t gb );
+
+    std::vector< EventFunction* > functions;
+    std::vector< Direction > directions;
+    real_t tolerance;
+    size_t samples;
+
+    const DenseOutput* dense; // the integrator's, or hermite
+    HermiteDenseOutput hermite;
+    std::vector< real_t > y0, f0, y1, f1, scratch;
+    bool have_end; // y1, f1 hold the end of the last step
+    unsigned long end_generation; // sys.force_generation() for f1
+    std::vector< real_t > values, end_values;
+    std::vector< EventRecord > found;
+};
+
+} // NEWTON
+
+#endif
@@ -0,0 +1,72 @@
+#include "fft.hpp"
+#include "math.hpp"
+#include "parallel.hpp"
+
+namespace NEWTON {
+
+// lines per thread; below this a pass runs on one thread
+static const size_t MIN_LINES_PER_THREAD = 16;
+
+void fft_twiddles( size_t n, int sign, std::vector< complex_t >& out )
+{
+    out.resize( n / 2 );
+    for ( size_t k = 0; k < n / 2; ++k )
+        out[k] = std::polar( 1.0, sign * 2 * PI * double( k ) / double( n ) );
+}
+
+void fft( complex_t* data, size_t n, const complex_t* twiddles )
+{
+    // bit reversal permutation
+    for ( size_t i = 1, j = 0; i < n; ++i ) {
+        size_t bit = n >> 1;
+        for ( ; j & bit; bit >>= 1 )
+            j ^= bit;
+        j |= bit;
+        if ( i < j )
+            std::swap( data[i], data[j] );
+    }
+
+    // butterflies; a stage of length len uses every (n / len)th twiddle
+    for ( size_t len = 2; len <= n; len <<= 1 ) {
+        size_t half = len / 2, step = n / len;
+        for ( size_t i = 0; i < n; i += len )
+            for ( size_t k = 0; k < half; ++k ) {
+                complex_t u = data[i + k];
+                complex_t v = data[i + k + half] * twiddles[k * step];
+                data[i + k] = u + v;
+                data[i + k + half] = u - v;
+            }
+    }
+}
+
+void fft3d( complex_t* grid, size_t n, int sign )
+{
+    std::vector< complex_t > twiddles;
+    fft_twiddles( n, sign, twiddles );
+    const complex_t* tw = twiddles.data();
+
+    // x lines are contiguous
+    parallel_for( 0, n * n, [=]( size_t line ) {
+        fft( grid + line * n, n, tw );
+    }, MIN_LINES_PER_THREAD );
+
+    // y and z lines are gathered into a buffer and scattered back
+    const size_t strides[2] = { n, n * n };
+    for ( int axis = 0; axis < 2; ++axis ) {
+        size_t stride = strides[axis];
+        parallel_for( 0, n * n, [=]( size_t line ) {
+            thread_local std::vector< complex_t > buf;
+            buf.resize( n );
+            // line = a * n + b over the two other axes
+            size_t a = line / n, b = line % n;
+            complex_t* base = axis == 0 ? grid + a * n * n + b : grid + a * n + b;
+            for ( size_t i = 0; i < n; ++i )
+                buf[i] = base[i * stride];
+            fft( buf.data(), n, tw );
+            for ( size_t i = 0; i < n; ++i )
+                base[i * stride] = buf[i];
+        }, MIN_LINES_PER_THREAD );
+    }
+}
+
+} /* NEWTON */
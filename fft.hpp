@@ -0,0 +1,29 @@
+#ifndef _FFT_HPP_
+#define _FFT_HPP_
+
+#include <complex>
+#include <vector>
+
+namespace NEWTON {
+
+typedef std::complex< double > complex_t;
+
+/*
+Radix-2 complex FFTs. Sizes must be powers of two. sign = -1 gives the
+forward transform, sign = +1 the inverse; neither is scaled, so a round
+trip multiplies by the number of points.
+*/
+
+// Twiddle factors exp(sign * 2 pi i k / n) for k < n / 2.
+void fft_twiddles( size_t n, int sign, std::vector< complex_t >& out );
+
+// In place on n contiguous values.
+void fft( complex_t* data, size_t n, const complex_t* twiddles );
+
+// In place on an n * n * n grid stored x fastest. Each pass transforms
+// all lines along one axis, spread across threads with parallel_for.
+void fft3d( complex_t* grid, size_t n, int sign );
+
+} /* NEWTON */
+
+#endif /* _FFT_HPP_ */
@@ -0,0 +1,424 @@
+#include <cassert>
+
+#include "fmm_gravity.hpp"
+
+namespace NEWTON {
+
+static const int MAX_ORDER = 10;
+static const int MAX_DEPTH = 64;
+
+// number of multi-indices of degree <= p
+static size_t terms_up_to( int p )
+{
+    return size_t( p + 1 ) * ( p + 2 ) * ( p + 3 ) / 6;
+}
+
+FmmGravity::FmmGravity( int order, real_t theta, size_t leaf_size )
+    : order( 0 ), theta( theta ), leaf_size( leaf_size > 0 ? leaf_size : 1 )
+{
+    set_order( order );
+}
+
+void FmmGravity::set_order( int p )
+{
+    p = clamp( p, 1, MAX_ORDER );
+    if ( p == order )
+        return;
+    order = p;
+    build_tables();
+}
+
+void FmmGravity::build_tables()
+{
+    const int P = order, N = 2 * order, side = N + 1;
+
+    lookup.assign( side * side * side, -1 );
+    degree.clear(); mi_t.clear(); mi_u.clear(); mi_v.clear();
+    for ( int n = 0; n <= N; ++n )
+        for ( int t = n; t >= 0; --t )
+            for ( int u = n - t; u >= 0; --u ) {
+                int v = n - t - u;
+                lookup[( t * side + u ) * side + v] = int( degree.size() );
+                degree.push_back( n );
+                mi_t.push_back( t ); mi_u.push_back( u ); mi_v.push_back( v );
+            }
+    num_terms = terms_up_to( P );
+    num_terms_2p = degree.size();
+
+    m2l_terms.clear();
+    shift_terms.clear();
+    for ( size_t a = 0; a < num_terms; ++a )
+        for ( size_t b = 0; b < num_terms; ++b ) {
+            if ( degree[a] + degree[b] <= P ) {
+                // L[b] = -sum_a (-1)^|a| M[a] D[a + b]
+                Term m = { (unsigned short)a, (unsigned short)b,
+                           (unsigned short)index( mi_t[a] + mi_t[b], mi_u[a] + mi_u[b], mi_v[a] + mi_v[b] ),
+                           (signed char)( degree[a] % 2 ? 1 : -1 ) };
+                m2l_terms.push_back( m );
+            }
+            if ( mi_t[b] <= mi_t[a] && mi_u[b] <= mi_u[a] && mi_v[b] <= mi_v[a] ) {
+                Term s = { (unsigned short)a, (unsigned short)b,
+                           (unsigned short)index( mi_t[a] - mi_t[b], mi_u[a] - mi_u[b], mi_v[a] - mi_v[b] ), 1 };
+                shift_terms.push_back( s );
+            }
+        }
+
+    // R(n; a) from R(n+1; a - e_k) and R(n+1; a - 2 e_k), along the first
+    // axis k where a is nonzero; count is a_k - 1 (0 drops the second term)
+    recurrence.assign( num_terms_2p, Recurrence() );
+    for ( size_t i = 1; i < num_terms_2p; ++i ) {
+        int t = mi_t[i], u = mi_u[i], v = mi_v[i];
+        int k = t > 0 ? 0 : u > 0 ? 1 : 2;
+        int a[3] = { t, u, v };
+        Recurrence& q = recurrence[i];
+        q.axis = (unsigned char)k;
+        q.count = (unsigned char)( a[k] - 1 );
+        a[k] -= 1;
+        q.prev = (unsigned short)index( a[0], a[1], a[2] );
+        if ( a[k] > 0 ) {
+            a[k] -= 1;
+            q.prev2 = (unsigned short)index( a[0], a[1], a[2] );
+        } else {
+            q.prev2 = 0;
+        }
+    }
+
+    // an M2L costs a derivative tensor (about 2p multiply-adds per
+    // entry) and two multiply-adds per term, a mutual pair about 20 flops
+    m2l_pairs = ( 2 * order * num_terms_2p + 4 * m2l_terms.size() ) / 20;
+
+    for ( int k = 0; k < 3; ++k ) {
+        grad[k].clear();
+        for ( size_t b = 0; b < terms_up_to( P - 1 ); ++b )
+            grad[k].push_back( (unsigned short)index( mi_t[b] + ( k == 0 ), mi_u[b] + ( k == 1 ), mi_v[b] + ( k == 2 ) ) );
+    }
+}
+
+// out[i] = d^a / a! for every multi-index a of degree <= p
+void FmmGravity::monomials( const Vector3& d, int p, real_t* out ) const
+{
+    out[0] = 1;
+    for ( size_t i = 1, n = terms_up_to( p ); i < n; ++i ) {
+        int t = mi_t[i], u = mi_u[i], v = mi_v[i];
+        if ( t > 0 )
+            out[i] = out[index( t - 1, u, v )] * d.x / t;
+        else if ( u > 0 )
+            out[i] = out[index( t, u - 1, v )] * d.y / u;
+        else
+            out[i] = out[index( t, u, v - 1 )] * d.z / v;
+    }
+}
+
+// out[i] = the derivative d^a (1/|r|) for every multi-index a of degree
+// <= 2p, by the McMurchie-Davidson recurrence: with
+//   R(n; 0,0,0) = (-1)^n (2n-1)!! / |r|^(2n+1),
+//   R(n; t+1,u,v) = t R(n+1; t-1,u,v) + x R(n+1; t,u,v)
+// (and likewise for u and v), the derivatives are R(0; t,u,v).
+void FmmGravity::derivatives( const Vector3& r, real_t* out )
+{
+    const int N = 2 * order;
+    const size_t stride = N + 1;
+    work.resize( num_terms_2p * stride );
+
+    // work[i * stride + n] = R(n; a_i)
+    real_t r_s = squared_length( r );
+    real_t f = 1 / sqrt( r_s );
+    for ( int n = 0; n <= N; ++n ) {
+        work[n] = f;
+        f *= -( 2 * n + 1 ) / r_s;
+    }
+
+    for ( size_t i = 1; i < num_terms_2p; ++i ) {
+        const Recurrence& q = recurrence[i];
+        const real_t x = r[q.axis], c = q.count;
+        const real_t* prev = &work[q.prev * stride + 1];
+        const real_t* prev2 = &work[q.prev2 * stride + 1];
+        real_t* o = &work[i * stride];
+        for ( int n = 0; n <= N - degree[i]; ++n )
+            o[n] = x * prev[n] + c * prev2[n];
+    }
+
+    for ( size_t i = 0; i < num_terms_2p; ++i )
+        out[i] = work[i * stride];
+}
+
+void FmmGravity::build_tree( size_t n )
+{
+    Vector3 lo = pos[0], hi = pos[0];
+    for ( size_t i = 1; i < n; ++i ) {
+        lo = vmin( lo, pos[i] );
+        hi = vmax( hi, pos[i] );
+    }
+    Vector3 extent = hi - lo;
+    real_t half = std::max( extent.x, std::max( extent.y, extent.z ) ) / 2;
+
+    sorted.resize( n );
+    for ( size_t i = 0; i < n; ++i )
+        sorted[i] = i;
+
+    cells.clear();
+    Cell root = { ( lo + hi ) / 2, half, 0, n, 0, 0, Vector3::Zero, 0 };
+    cells.push_back( root );
+    split( 0, 0 );
+
+    // bodies into tree order
+    std::vector< Vector3 > p( n );
+    std::vector< real_t > m( n );
+    for ( size_t i = 0; i < n; ++i ) {
+        p[i] = pos[sorted[i]];
+        m[i] = gm[sorted[i]];
+    }
+    pos.swap( p );
+    gm.swap( m );
+}
+
+void FmmGravity::split( size_t c, int depth )
+{
+    if ( cells[c].count <= leaf_size || depth >= MAX_DEPTH )
+        return;
+
+    const Vector3 center = cells[c].box_center;
+    const real_t half = cells[c].box_half / 2;
+    const size_t first = cells[c].first, count = cells[c].count;
+
+    // counting sort of the cell's bodies by octant
+    size_t start[9] = { 0 };
+    octant.resize( count );
+    for ( size_t i = 0; i < count; ++i ) {
+        const Vector3& x = pos[sorted[first + i]];
+        octant[i] = ( x.x > center.x ) | ( x.y > center.y ) << 1 | ( x.z > center.z ) << 2;
+        ++start[octant[i] + 1];
+    }
+    for ( int k = 0; k < 8; ++k )
+        start[k + 1] += start[k];
+    reorder.resize( count );
+    size_t next[8];
+    std::copy( start, start + 8, next );
+    for ( size_t i = 0; i < count; ++i )
+        reorder[next[octant[i]]++] = sorted[first + i];
+    std::copy( reorder.begin(), reorder.begin() + count, sorted.begin() + first );
+
+    size_t child = cells.size();
+    for ( int k = 0; k < 8; ++k ) {
+        if ( start[k + 1] == start[k] )
+            continue;
+        Vector3 offset( k & 1 ? half : -half, k & 2 ? half : -half, k & 4 ? half : -half );
+        Cell cc = { center + offset, half, first + start[k], start[k + 1] - start[k], 0, 0, Vector3::Zero, 0 };
+        cells.push_back( cc );
+    }
+    cells[c].child = child;
+    cells[c].children = cells.size() - child;
+
+    for ( size_t k = child; k < child + cells[c].children; ++k )
+        split( k, depth + 1 );
+}
+
+// P2M at the leaves and M2M up the tree. Children always come after
+// their parent in cells, so a reverse sweep visits children first.
+void FmmGravity::upward()
+{
+    std::vector< real_t > mono( num_terms );
+    for ( size_t c = cells.size(); c-- > 0; ) {
+        Cell& cell = cells[c];
+        real_t* M = &multipoles[c * num_terms];
+
+        real_t mass = 0;
+        Vector3 z = Vector3::Zero;
+        if ( !cell.children ) {
+            for ( size_t i = cell.first; i < cell.first + cell.count; ++i ) {
+                mass += gm[i];
+                z = madd( z, pos[i], gm[i] );
+            }
+        } else {
+            for ( size_t k = cell.child; k < cell.child + cell.children; ++k ) {
+                real_t m = multipoles[k * num_terms];
+                mass += m;
+                z = madd( z, cells[k].z, m );
+            }
+        }
+        cell.z = mass > 0 ? z / mass : cell.box_center;
+
+        cell.r = 0;
+        if ( !cell.children ) {
+            for ( size_t i = cell.first; i < cell.first + cell.count; ++i ) {
+                Vector3 d = pos[i] - cell.z;
+                cell.r = std::max( cell.r, length( d ) );
+                monomials( d, order, &mono[0] );
+                for ( size_t a = 0; a < num_terms; ++a )
+                    M[a] += gm[i] * mono[a];
+            }
+        } else {
+            for ( size_t k = cell.child; k < cell.child + cell.children; ++k ) {
+                Vector3 s = cells[k].z - cell.z;
+                cell.r = std::max( cell.r, length( s ) + cells[k].r );
+                monomials( s, order, &mono[0] );
+                const real_t* Mk = &multipoles[k * num_terms];
+                for ( size_t i = 0; i < shift_terms.size(); ++i ) {
+                    const Term& t = shift_terms[i];
+                    M[t.a] += Mk[t.b] * mono[t.c];
+                }
+            }
+            // the box bounds the bodies too, sometimes more tightly
+            cell.r = std::min( cell.r, length( cell.z - cell.box_center ) + cell.box_half * sqrt( real_t( 3 ) ) );
+        }
+    }
+}
+
+void FmmGravity::interact_self( size_t a )
+{
+    const Cell& A = cells[a];
+    if ( !A.children ) {
+        p2p_self( a );
+        return;
+    }
+    for ( size_t i = A.child; i < A.child + A.children; ++i ) {
+        interact_self( i );
+        for ( size_t j = i + 1; j < A.child + A.children; ++j )
+            interact( i, j );
+    }
+}
+
+void FmmGravity::interact( size_t a, size_t b )
+{
+    const Cell& A = cells[a];
+    const Cell& B = cells[b];
+    if ( A.r + B.r < theta * distance( A.z, B.z ) ) {
+        // two small leaves are cheaper summed directly
+        if ( !A.children && !B.children && A.count * B.count <= m2l_pairs )
+            p2p( a, b );
+        else
+            m2l( a, b );
+        return;
+    }
+    if ( !A.children && !B.children ) {
+        p2p( a, b );
+        return;
+    }
+    // split the larger cell
+    if ( !B.children || ( A.children && A.r >= B.r ) ) {
+        for ( size_t i = A.child; i < A.child + A.children; ++i )
+            interact( i, b );
+    } else {
+        for ( size_t j = B.child; j < B.child + B.children; ++j )
+            interact( a, j );
+    }
+}
+
+// far field of a at b and of b at a from one set of derivatives
+void FmmGravity::m2l( size_t a, size_t b )
+{
+    tensor.resize( num_terms_2p );
+    derivatives( cells[b].z - cells[a].z, &tensor[0] );
+
+    const real_t* Ma = &multipoles[a * num_terms];
+    const real_t* Mb = &multipoles[b * num_terms];
+    real_t* La = &locals[a * num_terms];
+    real_t* Lb = &locals[b * num_terms];
+    for ( size_t i = 0; i < m2l_terms.size(); ++i ) {
+        const Term& t = m2l_terms[i];
+        real_t d = t.sign * tensor[t.c];
+        Lb[t.b] += Ma[t.a] * d;
+        // D(-r) = (-1)^|c| D(r)
+        La[t.b] += Mb[t.a] * ( degree[t.c] % 2 ? -d : d );
+    }
+}
+
+void FmmGravity::p2p( size_t a, size_t b )
+{
+    const Cell& A = cells[a];
+    const Cell& B = cells[b];
+    for ( size_t i = A.first; i < A.first + A.count; ++i ) {
+        Vector3 ai = Vector3::Zero;
+        for ( size_t j = B.first; j < B.first + B.count; ++j ) {
+            Vector3 d = pos[j] - pos[i];
+            real_t r_s = squared_length( d );
+            if ( !( r_s > 0 ) )
+                continue;
+            real_t s = 1 / ( r_s * sqrt( r_s ) );
+            ai = madd( ai, d, gm[j] * s );
+            acc[j] = madd( acc[j], d, -gm[i] * s );
+        }
+        acc[i] += ai;
+    }
+}
+
+void FmmGravity::p2p_self( size_t a )
+{
+    const Cell& A = cells[a];
+    for ( size_t i = A.first; i < A.first + A.count; ++i ) {
+        Vector3 ai = Vector3::Zero;
+        for ( size_t j = i + 1; j < A.first + A.count; ++j ) {
+            Vector3 d = pos[j] - pos[i];
+            real_t r_s = squared_length( d );
+            if ( !( r_s > 0 ) )
+                continue;
+            real_t s = 1 / ( r_s * sqrt( r_s ) );
+            ai = madd( ai, d, gm[j] * s );
+            acc[j] = madd( acc[j], d, -gm[i] * s );
+        }
+        acc[i] += ai;
+    }
+}
+
+// L2L down the tree and L2P at the leaves
+void FmmGravity::downward()
+{
+    std::vector< real_t > mono( num_terms );
+    for ( size_t c = 0; c < cells.size(); ++c ) {
+        const Cell& cell = cells[c];
+        const real_t* L = &locals[c * num_terms];
+        if ( cell.children ) {
+            for ( size_t k = cell.child; k < cell.child + cell.children; ++k ) {
+                monomials( cells[k].z - cell.z, order, &mono[0] );
+                real_t* Lk = &locals[k * num_terms];
+                for ( size_t i = 0; i < shift_terms.size(); ++i ) {
+                    const Term& t = shift_terms[i];
+                    Lk[t.b] += L[t.a] * mono[t.c];
+                }
+            }
+            continue;
+        }
+        // a = -grad phi, phi(z + e) = sum_b L[b] e^b / b!
+        size_t n = grad[0].size();
+        for ( size_t i = cell.first; i < cell.first + cell.count; ++i ) {
+            monomials( pos[i] - cell.z, order - 1, &mono[0] );
+            Vector3 a = Vector3::Zero;
+            for ( size_t b = 0; b < n; ++b ) {
+                a.x -= L[grad[0][b]] * mono[b];
+                a.y -= L[grad[1][b]] * mono[b];
+                a.z -= L[grad[2][b]] * mono[b];
+            }
+            acc[i] += a;
+        }
+    }
+}
+
+void FmmGravity::accelerations( std::vector< Body >& bodies, SofteningKernel kernel )
+{
+    assert( kernel == SOFTENING_NONE );
+    (void) kernel;
+    size_t n = bodies.size();
+    if ( n == 0 )
+        return;
+
+    pos.resize( n );
+    gm.resize( n );
+    for ( size_t i = 0; i < n; ++i ) {
+        pos[i] = bodies[i].position;
+        gm[i] = bodies[i].exerts_grav ? G * bodies[i].mass : 0;
+    }
+    build_tree( n );
+
+    multipoles.assign( cells.size() * num_terms, 0 );
+    locals.assign( cells.size() * num_terms, 0 );
+    acc.assign( n, Vector3::Zero );
+
+    upward();
+    interact_self( 0 );
+    downward();
+
+    for ( size_t i = 0; i < n; ++i )
+        bodies[sorted[i]].acc_accumulator = acc[i];
+}
+
+} // NEWTON
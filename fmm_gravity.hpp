@@ -0,0 +1,137 @@
+#ifndef _FMM_GRAVITY_HPP_
+#define _FMM_GRAVITY_HPP_
+
+#include <vector>
+
+#include "system.hpp"
+
+namespace NEWTON {
+
+/*
+Gravity by the fast multipole method, with Cartesian Taylor expansions
+of configurable order, an adaptive octree and dual-tree traversal
+(after Dehnen, "A hierarchical O(N) force calculation algorithm", 2002).
+
+Each cell holds the multipole moments of its sources about their centre
+of mass (so the dipole term vanishes) up to order p. Traversal starts
+with the root against itself. Two cells that are well separated,
+
+    r_A + r_B < theta * |z_A - z_B|,
+
+exchange field tensors both ways (M2L), so each far interaction is
+evaluated once for both cells. Otherwise the larger cell is split, and
+two leaves sum directly over their bodies, also both ways, as do
+well-separated leaves with fewer body pairs than an M2L costs. The local
+expansions are then pushed down the tree (L2L) and evaluated at the
+bodies (L2P).
+
+The force error falls roughly as theta^p. For a uniform cluster the
+RMS relative error is about 3e-4 at order 4, theta 0.5 (the defaults),
+2e-5 at order 4, theta 0.3 and 1e-8 at order 8, theta 0.3. Cost is O(N)
+for a fixed order and theta, about 20-25 us per body at the defaults on
+one core from 16k bodies up; bench/fmm_bench.cpp measures both.
+
+The error is relative to the pull of each interacting cell, so one
+dominant mass (a sun among planets) leaves errors of about theta^p of
+its own pull on the bodies around it: 2e-2 at the defaults in
+bench/gravity_bench.cpp. Such systems are better served by the direct
+solvers or a high order and small theta.
+
+Sources without exerts_grav have no moments but still receive forces.
+Coincident bodies contribute nothing to each other. Bodies are points:
+no softening kernel.
+*/
+class FmmGravity : public GravitySolver {
+public:
+    explicit FmmGravity( int order = 4, real_t theta = 0.5, size_t leaf_size = 32 );
+    virtual ~FmmGravity() { }
+    virtual void accelerations( std::vector< Body >& bodies, SofteningKernel kernel );
+
+    void set_order( int p );
+    int get_order() const { return order; }
+    void set_theta( real_t t ) { theta = t; }
+    real_t get_theta() const { return theta; }
+    void set_leaf_size( size_t n ) { leaf_size = n > 0 ? n : 1; }
+    size_t get_leaf_size() const { return leaf_size; }
+
+    size_t num_cells() const { return cells.size(); }
+
+private:
+    struct Cell
+    {
+        Vector3 box_center;
+        real_t box_half;
+        size_t first, count;    // bodies, in sorted order
+        size_t child, children; // first child index and count, 0 if leaf
+        Vector3 z;              // expansion centre
+        real_t r;               // distance from z to its farthest body
+    };
+
+    // An entry of a sum over multi-index pairs: out[a] += in[b] * w[c]
+    // (M2L, M2M, L2L) with a sign for M2L.
+    struct Term
+    {
+        unsigned short a, b, c;
+        signed char sign;
+    };
+
+    void build_tables();
+    size_t index( int t, int u, int v ) const { return lookup[( t * ( 2 * order + 1 ) + u ) * ( 2 * order + 1 ) + v]; }
+    void monomials( const Vector3& d, int p, real_t* out ) const;
+    void derivatives( const Vector3& r, real_t* out );
+
+    void build_tree( size_t n );
+    void split( size_t cell, int depth );
+    void upward();
+    void interact( size_t a, size_t b );
+    void interact_self( size_t a );
+    void m2l( size_t a, size_t b );
+    void p2p( size_t a, size_t b );
+    void p2p_self( size_t a );
+    void downward();
+
+    int order;
+    real_t theta;
+    size_t leaf_size;
+
+    // multi-indices (t, u, v) of total degree <= 2 * order, sorted by
+    // degree, with (t, u, v) -> position in lookup
+    size_t num_terms;      // of degree <= order
+    size_t num_terms_2p;   // of degree <= 2 * order
+    std::vector< int > lookup;
+    std::vector< int > degree;
+    std::vector< int > mi_t, mi_u, mi_v;
+    std::vector< Term > m2l_terms;  // |a| + |b| <= p: L[b] += sign * M[a] * D[a + b]
+    std::vector< Term > shift_terms; // b <= a: M'[a] += M[b] * s^(a-b); L'[b] += L[a] * t^(a-b)
+    std::vector< unsigned short > grad[3]; // index of b + e_k, for |b| < p
+
+    struct Recurrence
+    {
+        unsigned short prev, prev2;
+        unsigned char axis, count;
+    };
+    std::vector< Recurrence > recurrence; // per multi-index, see derivatives()
+
+    std::vector< Cell > cells;
+    std::vector< real_t > multipoles; // num_terms per cell
+    std::vector< real_t > locals;     // num_terms per cell
+
+    // bodies in tree order
+    std::vector< size_t > sorted;
+    std::vector< Vector3 > pos;
+    std::vector< real_t > gm;
+    std::vector< Vector3 > acc;
+
+    // leaf pairs with no more body pairs than this skip M2L
+    size_t m2l_pairs;
+
+    // scratch
+    std::vector< real_t > work;
+    std::vector< real_t > tensor;
+    std::vector< unsigned char > octant; // split()
+    std::vector< size_t > reorder;       // split()
+};
+
+} // NEWTON
+
+#endif
@@ -2,7 +2,16 @@
 
 namespace NEWTON {
 
-void Game::initialize() {
+#define SPHERE_CACHE_FILE "icosphere.cache"
+#define SPHERE_CACHE_LEVELS 6 // highest level kept in the cache
+#define SPHERE_LEVEL 3        // level used for body meshes
+#define EPHEMERIS_CACHE_FILE "ephemeris.cache"
+#define EPHEMERIS_YEARS 10    // span of the ephemeris fitted for the massive bodies
+#define TRAIL_CAPACITY 2048   // samples kept per body
+#define TRAIL_DECIMATION 20   // steps between samples
+#define MOON_ENCOUNTER_DISTANCE 66100e3 // roughly the Moon's sphere of influence
+
+bool Game::initialize() {
 
 	engines_on = false;
 	engine_thrust = 1e6;
@@ -11,6 +20,12 @@ void Game::initialize() {
 
 //	sys.initialize();
 
+	if(!sphere_cache.open(SPHERE_CACHE_FILE, SPHERE_CACHE_LEVELS) || !sphere_cache.get(SPHERE_LEVEL)) {
+		std::cout << "ERROR: could not build sphere meshes" << std::endl;
+		return false;
+	}
+	IcosphereLevel const & sphere = *sphere_cache.get(SPHERE_LEVEL);
+
 	Vector3 earth_pos = Vector3(1.5210e11, 0.0, 0.0);
 	Vector3 earth_vel = Vector3(0.0, 2.9300e4, 0.0);
 
@@ -21,44 +36,94 @@ void Game::initialize() {
 
 	// body 0 is spaceship
 	body_num = sys.add_body(30.3e3, earth_pos + Vector3(6556e3, 0.0, 0.0), earth_vel + Vector3(0.0, 7.796e3, 0.0), false);
-	objects.push_back(GameObject(true, body_num, 5));
+	objects.push_back(GameObject(true, body_num, 5, sphere));
 
 	body_num = sys.add_body(1.989e30,   Vector3(0.0, 0.0, 0.0), Vector3(0.0, 0.0, 0.0)); // SUN
-	objects.push_back(GameObject(true, body_num, 696342e3));
+	objects.push_back(GameObject(true, body_num, 696342e3, sphere));
+	size_t sun = body_num;
 	body_num = sys.add_body(3.3022e23,  Vector3(6.9817e10, 0.0, 0.0), Vector3(0.0, 3.886e4, 0.0)); // MERCURY
-	objects.push_back(GameObject(true, body_num, 2439.7e3));
+	objects.push_back(GameObject(true, body_num, 2439.7e3, sphere));
 	body_num = sys.add_body(4.8676e24,  Vector3(1.0894e11, 0.0, 0.0), Vector3(0.0, 3.479e4, 0.0)); // VENUS
-	objects.push_back(GameObject(true, body_num, 6051.8e3));
+	objects.push_back(GameObject(true, body_num, 6051.8e3, sphere));
 	body_num = sys.add_body(5.97219e24, earth_pos, earth_vel); // EARTH
-	objects.push_back(GameObject(true, body_num, 6371.0e3));
+	objects.push_back(GameObject(true, body_num, 6371.0e3, sphere));
+	size_t earth = body_num;
+	reference_body = earth;
 	body_num = sys.add_body(7.3477e22,  earth_pos + Vector3(4.054e8, 0.0, 0.0), earth_vel + Vector3(0.0, 9.64e2, 0.0)); // MOON
-	objects.push_back(GameObject(true, body_num, 1737.10e3));
+	objects.push_back(GameObject(true, body_num, 1737.10e3, sphere));
+	collisions.set_encounter_distance(body_num, MOON_ENCOUNTER_DISTANCE);
+	size_t moon = body_num;
 	body_num = sys.add_body(6.4185e23,  Vector3(2.492e11, 0.0, 0.0), Vector3(0.0, 2.1977e4, 0.0)); // MARS
-	objects.push_back(GameObject(true, body_num, 3389.5e3));
+	objects.push_back(GameObject(true, body_num, 3389.5e3, sphere));
 	body_num = sys.add_body(1.89813e27, Vector3(8.1652e11, 0.0, 0.0), Vector3(0.0, 1.2435e4, 0.0)); // JUPITER
-	objects.push_back(GameObject(true, body_num, 69911e3));
+	objects.push_back(GameObject(true, body_num, 69911e3, sphere));
+	size_t jupiter = body_num;
 	body_num = sys.add_body(5.6846e26,  Vector3(1.513e12, 0.0, 0.0), Vector3(0.0, 9.101e3, 0.0)); // SATURN
-	objects.push_back(GameObject(true, body_num, 58232e3));
+	objects.push_back(GameObject(true, body_num, 58232e3, sphere));
 	body_num = sys.add_body(8.68e25,    Vector3(3.006e12, 0.0, 0.0), Vector3(0.0, 6.486e3, 0.0)); // URANUS
-	objects.push_back(GameObject(true, body_num, 25362e3));
+	objects.push_back(GameObject(true, body_num, 25362e3, sphere));
 	body_num = sys.add_body(1.0243e26,  Vector3(4.538e12, 0.0, 0.0), Vector3(0.0, 5.385e3, 0.0)); // NEPTUNE
-	objects.push_back(GameObject(true, body_num, 24622e3));
+	objects.push_back(GameObject(true, body_num, 24622e3, sphere));
 
 	sys.translate(-earth_pos);
 
-	for(int j=0; j<3; j++) {
-		for(size_t i=0; i < objects.size(); i++)
-			objects[i].subdivide_mesh();
-		for(size_t i=0; i < objects.size(); i++)
-			objects[i].make_spherical();
+	// the outer planets barely feel the rest over a session: closed-form
+	// orbits about the sun
+	for(size_t i = jupiter; i < sys.bodies.size(); i++)
+		rails.add(sys, i, sun);
+	sys.rails = &rails;
+
+	// better still, every massive body along a fitted ephemeris, so only
+	// the ship is integrated and only the gravity on it computed; after
+	// it runs out they are integrated again
+	if(ephemeris.open(EPHEMERIS_CACHE_FILE, sys, runge_kutta_integrator, EPHEMERIS_YEARS*365.25*86400)) {
+		ephemeris_rails.set_ephemeris(&ephemeris);
+		for(size_t i = 0; i < ephemeris.get_bodies().size(); i++)
+			ephemeris_rails.add(ephemeris.get_bodies()[i]);
+		sys.rails = &ephemeris_rails;
 	}
 
+	for(size_t i = 0; i < objects.size(); i++)
+		if(objects[i].is_body())
+			collisions.set_radius(objects[i].get_body_num(), objects[i].get_radius());
+	collisions.add_handler(Encounter::IMPACT, &encounter_log);
+	collisions.add_handler(Encounter::IMPACT, &encounter_bounce);
+	collisions.add_handler(Encounter::CLOSE_APPROACH, &encounter_log);
+	sys.thrust_model = &maneuvers;
+
+	// the ship's apsides about Earth and its passages through the Moon's SOI
+	add_event(new ApsisEvent(0, earth), "Apoapsis", "Periapsis");
+	add_event(new DistanceEvent(0, moon, MOON_ENCOUNTER_DISTANCE), "Entered lunar SOI", "Left lunar SOI");
+
+	trails.configure(sys.bodies.size(), TRAIL_CAPACITY, TRAIL_DECIMATION);
+	trails.set_enabled(true);
+	return true;
+}
+
+void Game::add_event(EventFunction* f, const char* falling, const char* rising) {
+	event_functions.push_back(std::unique_ptr<EventFunction>(f));
+	events.add(f);
+	event_names.push_back(std::make_pair(falling, rising));
 }
 
 void Game::update(real_t dt) {
-	if(engines_on)
-		sys.bodies[0].thrust = engine_thrust*normalize(sys.bodies[0].velocity - sys.bodies[4].velocity);
-	runge_kutta_integrator.integrate(sys, dt);
+	collisions.begin_step(sys);
+	event_records.clear();
+	// steps are cut where burns start or end
+	maneuvers.update(sys);
+	maneuvers.split(sys.time, dt, step_pieces);
+	for(size_t i = 0; i < step_pieces.size(); i++) {
+		events.step(runge_kutta_integrator, sys, step_pieces[i], event_records);
+		maneuvers.update(sys);
+	}
+	for(size_t i = 0; i < event_records.size(); i++) {
+		EventRecord const & r = event_records[i];
+		std::cout << (r.rising ? event_names[r.event].second : event_names[r.event].first)
+		          << " at t = " << r.time << " s" << std::endl;
+	}
+	collisions.end_step(sys);
+	collisions.handle_events(sys);
+	trails.record(sys);
 //	camera_control.update(dt);
 }
 
@@ -89,19 +154,26 @@ void Game::handle_event(SDL_Event event) {
 		case SDL_KEYDOWN:
 			key = event.key.keysym.sym;
 			if(key == SDLK_SPACE) {
-				sum = sys.bodies[0].velocity - sys.bodies[4].velocity;
+				sum = sys.bodies[0].velocity - sys.bodies[reference_body].velocity;
 				std::cout << "Velocity: " << length(sum) << std::endl;
 				if(!engines_on) {
 					std::cout << "Engines at " << engine_thrust << " newtons of thrust along prograde vector." << std::endl;
+					Burn burn = {0, reference_body, Burn::PROGRADE, sys.time,
+					             std::numeric_limits<real_t>::infinity(), engine_thrust, 0};
+					manual_burn = maneuvers.schedule(burn);
 					engines_on = true;
 				}
 			}
+			else if(key == SDLK_l) {
+				trails.set_enabled(!trails.is_enabled());
+				std::cout << "Orbit trails " << (trails.is_enabled() ? "on." : "off.") << std::endl;
+			}
 			break;
 		case SDL_KEYUP:
 			key = event.key.keysym.sym;
 			if(key == SDLK_SPACE) {
 				std::cout << "Engines off." << std::endl;
-				sys.bodies[0].thrust = Vector3::Zero;
+				maneuvers.cancel(manual_burn, sys.time);
 				engines_on = false;
 			}
 			break;
@@ -120,33 +192,57 @@ void Game::render()
 	Camera & cam = camera_control.camera;
 	Vector3 right = Vector3(1.0, 0.0, 0.0);
 
+	int body_focus = camera_control.body_focus;
+	Vector3 & target = sys.bodies[body_focus].position;
+
+	// Floating origin: the camera sits at cam.position in the rotated frame
+	// centred on the target. Everything is drawn relative to the eye, with
+	// the subtraction done here in double, so the modelview only has to
+	// rotate and the GPU only ever sees small, float-safe coordinates.
+	Quaternion view = Quaternion(Vector3::UnitX, cam.theta*PI/180)
+	                * Quaternion(Vector3::UnitY, cam.phi*PI/180)
+	                * Quaternion(Vector3::UnitX, PI/2);
+	Vector3 eye = target + conjugate(view) * cam.position;
+
 	glLoadIdentity();
-	glTranslated(-1*cam.position.x, -1*cam.position.y, -1*cam.position.z);
 	glRotated(cam.theta, 1.0, 0.0, 0.0);
 	glRotated(cam.phi, 0.0, 1.0, 0.0);
 	glRotated(90, 1.0, 0.0, 0.0);
-	int body_focus = camera_control.body_focus;
-	Vector3 & target = sys.bodies[body_focus].position;
-	glTranslated(-target.x, -target.y, -target.z);
 
-	glBegin(GL_POINTS);
-	for(size_t i=0; i < sys.bodies.size(); i++) {
-		Vector3 pos = sys.bodies[i].position;
-		glVertex3d(pos.x, pos.y, pos.z);
+	if(!sys.bodies.empty())
+		particles.stream(&sys.bodies[0].position, sizeof(Body), sys.bodies.size(), eye);
+	particles.render();
+	trail_renderer.render(trails, eye);
+
+	// camera-relative object positions, in one pass before any GL calls
+	size_t num_objects = objects.size();
+	render_offsets.resize(num_objects);
+	render_radii.resize(num_objects);
+	render_visible.resize(num_objects);
+	for(size_t i = 0; i < num_objects; i++) {
+		if(objects[i].is_body())
+			render_offsets[i] = sys.bodies[objects[i].get_body_num()].position - eye;
+		else
+			render_offsets[i] = objects[i].get_position() - eye;
+		render_radii[i] = objects[i].get_radius();
 	}
-	glEnd();
 
-	for(size_t i = 0; i < objects.size(); i++) {
+	// cull objects entirely outside the sides of the view frustum
+	GLdouble proj[16], modelview[16];
+	glGetDoublev(GL_PROJECTION_MATRIX, proj);
+	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+	Vector4 planes[4];
+	frustum_side_planes(Matrix4(proj) * Matrix4(modelview), planes);
+	if(num_objects > 0)
+		batch_spheres_in_frustum(planes, 4, aos_span(&render_offsets[0], sizeof(Vector3), num_objects),
+		                         &render_radii[0], &render_visible[0]);
+
+	for(size_t i = 0; i < num_objects; i++) {
+		if(!render_visible[i])
+			continue;
 		glPushMatrix();
-			if(objects[i].is_body()) {
-				size_t body_num = objects[i].get_body_num();
-				Vector3 const & p = sys.bodies[body_num].position;
-				glTranslated(p.x, p.y, p.z);
-			}
-			else {
-				Vector3 const & p = objects[i].get_position();
-				glTranslated(p.x, p.y, p.z);
-			}
+			Vector3 const & p = render_offsets[i];
+			glTranslatef((GLfloat) p.x, (GLfloat) p.y, (GLfloat) p.z);
 			objects[i].render();
 		glPopMatrix();
 	}
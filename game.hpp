@@ -1,14 +1,28 @@
 #ifndef _GAME_HPP_
 #define _GAME_HPP_
 
+#include <iostream>
 #include <limits>
+#include <memory>
+#include <utility>
 
 #include "camera_control.hpp"
+#include "chebyshev_ephemeris.hpp"
+#include "collision.hpp"
+#include "event.hpp"
+#include "kepler.hpp"
+#include "maneuver.hpp"
 #include "system.hpp"
 #include "integrator.hpp"
 #include "vector.hpp"
+#include "batch.hpp"
 #include "mesh.hpp"
+#include "icosphere.hpp"
+#include "particle_renderer.hpp"
+#include "trail.hpp"
+#include "trail_renderer.hpp"
 #include "matrix.hpp"
+#include "quaternion.hpp"
 
 namespace NEWTON {
 
@@ -17,8 +31,8 @@ typedef std::numeric_limits< double > dbl;
 class GameObject {
 public:
 
-	GameObject(bool is_body, size_t body_num, real_t r) : _is_body(is_body), body_num(body_num), radius(r) {
-		mesh.construct_sphere(r);
+	GameObject(bool is_body, size_t body_num, real_t r, IcosphereLevel const & sphere) : _is_body(is_body), body_num(body_num), radius(r) {
+		mesh.construct_sphere(r, sphere);
 	}
 
 	void subdivide_mesh() {
@@ -33,6 +47,7 @@ public:
 	bool is_body() { return _is_body; }
 	Vector3 const & get_position() { return position; }
 	size_t get_body_num() { return body_num; }
+	real_t get_radius() { return radius; }
 private:
 	Mesh mesh;
 	Vector3 position;
@@ -43,18 +58,43 @@ private:
 
 class Game {
 public:
-	void initialize();
+	Game() : encounter_log(std::cout) { }
+	bool initialize();
 	void update(real_t dt);
 	void render();
 	void handle_event(SDL_Event event);
 private:
+	// takes ownership of f; names are printed for falling and rising crossings
+	void add_event(EventFunction* f, const char* falling, const char* rising);
+
 	System sys;
 	RungeKuttaIntegrator runge_kutta_integrator;
 	CameraControl camera_control;
 	std::vector<GameObject> objects;
+	IcosphereCache sphere_cache;
+	ParticleRenderer particles;
+	OrbitTrails trails;
+	TrailRenderer trail_renderer;
+	CollisionDetector collisions;
+	EncounterLog encounter_log;
+	EncounterBounce encounter_bounce;
+	EventLocator events;
+	std::vector< std::unique_ptr<EventFunction> > event_functions;
+	std::vector< std::pair<const char*, const char*> > event_names;
+	std::vector<EventRecord> event_records;
+	ManeuverEngine maneuvers;
+	KeplerRails rails;
+	ChebyshevEphemeris ephemeris;
+	EphemerisRails ephemeris_rails;
+	std::vector<real_t> step_pieces;
+	std::vector<Vector3> render_offsets;
+	std::vector<real_t> render_radii;
+	std::vector<unsigned char> render_visible;
 
 	bool engines_on;
 	real_t engine_thrust;
+	size_t manual_burn;    // burn held on while SPACE is down
+	size_t reference_body; // the ship's burns and speed are relative to it
 };
 
 }
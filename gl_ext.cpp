@@ -0,0 +1,86 @@
+#include <cstdio>
+
+#include "gl_ext.hpp"
+
+namespace NEWTON {
+
+GLExtensions gl_ext;
+
+template<typename T>
+static void load( T& fn, const char* name )
+{
+    fn = (T) SDL_GL_GetProcAddress( name );
+}
+
+// Whether the context is at least version major.minor or advertises
+// extension. A non-null entry point alone proves nothing: GLX hands one
+// out for any name.
+static bool supported( int major, int minor, const char* extension )
+{
+    static int have_major = -1, have_minor = 0;
+    if ( have_major < 0 ) {
+        const char* version = (const char*) glGetString( GL_VERSION );
+        if ( !version || std::sscanf( version, "%d.%d", &have_major, &have_minor ) != 2 )
+            have_major = have_minor = 0;
+    }
+    if ( have_major > major || ( have_major == major && have_minor >= minor ) )
+        return true;
+    return SDL_GL_ExtensionSupported( extension ) == SDL_TRUE;
+}
+
+void load_gl_extensions()
+{
+    if ( gl_ext.loaded )
+        return;
+
+    load( gl_ext.GenBuffers, "glGenBuffers" );
+    load( gl_ext.DeleteBuffers, "glDeleteBuffers" );
+    load( gl_ext.BindBuffer, "glBindBuffer" );
+    load( gl_ext.BufferData, "glBufferData" );
+    load( gl_ext.BufferSubData, "glBufferSubData" );
+
+    load( gl_ext.BufferStorage, "glBufferStorage" );
+    load( gl_ext.MapBufferRange, "glMapBufferRange" );
+    load( gl_ext.UnmapBuffer, "glUnmapBuffer" );
+    load( gl_ext.FenceSync, "glFenceSync" );
+    load( gl_ext.ClientWaitSync, "glClientWaitSync" );
+    load( gl_ext.DeleteSync, "glDeleteSync" );
+
+    load( gl_ext.PointParameterf, "glPointParameterf" );
+    load( gl_ext.PointParameterfv, "glPointParameterfv" );
+
+    load( gl_ext.GenFramebuffers, "glGenFramebuffers" );
+    load( gl_ext.DeleteFramebuffers, "glDeleteFramebuffers" );
+    load( gl_ext.BindFramebuffer, "glBindFramebuffer" );
+    load( gl_ext.GenRenderbuffers, "glGenRenderbuffers" );
+    load( gl_ext.DeleteRenderbuffers, "glDeleteRenderbuffers" );
+    load( gl_ext.BindRenderbuffer, "glBindRenderbuffer" );
+    load( gl_ext.RenderbufferStorage, "glRenderbufferStorage" );
+    load( gl_ext.FramebufferRenderbuffer, "glFramebufferRenderbuffer" );
+    load( gl_ext.CheckFramebufferStatus, "glCheckFramebufferStatus" );
+    load( gl_ext.BlitFramebuffer, "glBlitFramebuffer" );
+
+    load( gl_ext.ClipControl, "glClipControl" );
+
+    gl_ext.has_buffers = gl_ext.GenBuffers && gl_ext.DeleteBuffers &&
+                         gl_ext.BindBuffer && gl_ext.BufferData && gl_ext.BufferSubData;
+    gl_ext.has_persistent = gl_ext.has_buffers &&
+                            supported( 4, 4, "GL_ARB_buffer_storage" ) &&
+                            supported( 3, 2, "GL_ARB_sync" ) &&
+                            supported( 3, 0, "GL_ARB_map_buffer_range" ) &&
+                            gl_ext.BufferStorage &&
+                            gl_ext.MapBufferRange && gl_ext.UnmapBuffer &&
+                            gl_ext.FenceSync && gl_ext.ClientWaitSync && gl_ext.DeleteSync;
+    gl_ext.has_point_params = gl_ext.PointParameterf && gl_ext.PointParameterfv;
+    gl_ext.has_framebuffers = supported( 3, 0, "GL_ARB_framebuffer_object" ) &&
+                              gl_ext.GenFramebuffers && gl_ext.DeleteFramebuffers &&
+                              gl_ext.BindFramebuffer && gl_ext.GenRenderbuffers &&
+                              gl_ext.DeleteRenderbuffers && gl_ext.BindRenderbuffer &&
+                              gl_ext.RenderbufferStorage && gl_ext.FramebufferRenderbuffer &&
+                              gl_ext.CheckFramebufferStatus && gl_ext.BlitFramebuffer;
+    gl_ext.has_clip_control = supported( 4, 5, "GL_ARB_clip_control" ) && gl_ext.ClipControl;
+    gl_ext.has_depth_float = supported( 3, 0, "GL_ARB_depth_buffer_float" );
+    gl_ext.loaded = true;
+}
+
+} /* NEWTON */
@@ -0,0 +1,68 @@
+#ifndef _GL_EXT_HPP_
+#define _GL_EXT_HPP_
+
+#include "SDL.h"
+#include "SDL_opengl.h"
+
+namespace NEWTON {
+
+/*
+Entry points newer than OpenGL 1.1, which is all some platforms export
+directly. They are looked up through SDL once a context exists. A
+has_* flag is set only when the context's version or extension string
+offers the feature and all of its entry points resolved, so callers
+can fall back to older paths otherwise.
+*/
+struct GLExtensions {
+    // buffer objects (1.5)
+    PFNGLGENBUFFERSPROC GenBuffers;
+    PFNGLDELETEBUFFERSPROC DeleteBuffers;
+    PFNGLBINDBUFFERPROC BindBuffer;
+    PFNGLBUFFERDATAPROC BufferData;
+    PFNGLBUFFERSUBDATAPROC BufferSubData;
+
+    // persistent mapping (3.0 + 3.2 + 4.4)
+    PFNGLBUFFERSTORAGEPROC BufferStorage;
+    PFNGLMAPBUFFERRANGEPROC MapBufferRange;
+    PFNGLUNMAPBUFFERPROC UnmapBuffer;
+    PFNGLFENCESYNCPROC FenceSync;
+    PFNGLCLIENTWAITSYNCPROC ClientWaitSync;
+    PFNGLDELETESYNCPROC DeleteSync;
+
+    // point parameters (1.4)
+    PFNGLPOINTPARAMETERFPROC PointParameterf;
+    PFNGLPOINTPARAMETERFVPROC PointParameterfv;
+
+    // framebuffer objects (3.0)
+    PFNGLGENFRAMEBUFFERSPROC GenFramebuffers;
+    PFNGLDELETEFRAMEBUFFERSPROC DeleteFramebuffers;
+    PFNGLBINDFRAMEBUFFERPROC BindFramebuffer;
+    PFNGLGENRENDERBUFFERSPROC GenRenderbuffers;
+    PFNGLDELETERENDERBUFFERSPROC DeleteRenderbuffers;
+    PFNGLBINDRENDERBUFFERPROC BindRenderbuffer;
+    PFNGLRENDERBUFFERSTORAGEPROC RenderbufferStorage;
+    PFNGLFRAMEBUFFERRENDERBUFFERPROC FramebufferRenderbuffer;
+    PFNGLCHECKFRAMEBUFFERSTATUSPROC CheckFramebufferStatus;
+    PFNGLBLITFRAMEBUFFERPROC BlitFramebuffer;
+
+    // depth range remapping (4.5)
+    PFNGLCLIPCONTROLPROC ClipControl;
+
+    bool loaded;
+    bool has_buffers;
+    bool has_persistent;
+    bool has_point_params;
+    bool has_framebuffers;
+    bool has_clip_control;
+    bool has_depth_float; // GL_DEPTH_COMPONENT32F renderbuffers (3.0)
+};
+
+extern GLExtensions gl_ext;
+
+// Fills in gl_ext. Must be called with a current context; later calls are
+// no-ops.
+void load_gl_extensions();
+
+} /* NEWTON */
+
+#endif /* _GL_EXT_HPP_ */
@@ -0,0 +1,364 @@
+#include "icosphere.hpp"
+#include "parallel.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace NEWTON {
+
+static const size_t ICO_NUM_VERTICES = 12;
+static const size_t ICO_NUM_EDGES = 30;
+static const size_t ICO_NUM_FACES = 20;
+
+// Golden-ratio icosahedron, faces wound counter-clockwise seen from outside.
+static const real_t ico_t = 1.6180339887498948482;
+static const real_t ico_vertices[ICO_NUM_VERTICES][3] = {
+    { -1,  ico_t, 0 }, { 1,  ico_t, 0 }, { -1, -ico_t, 0 }, { 1, -ico_t, 0 },
+    { 0, -1,  ico_t }, { 0, 1,  ico_t }, { 0, -1, -ico_t }, { 0, 1, -ico_t },
+    {  ico_t, 0, -1 }, {  ico_t, 0, 1 }, { -ico_t, 0, -1 }, { -ico_t, 0, 1 }
+};
+static const unsigned int ico_faces[ICO_NUM_FACES][3] = {
+    { 0, 11,  5 }, { 0,  5,  1 }, { 0,  1,  7 }, { 0,  7, 10 }, { 0, 10, 11 },
+    { 1,  5,  9 }, { 5, 11,  4 }, { 11, 10, 2 }, { 10, 7,  6 }, { 7,  1,  8 },
+    { 3,  9,  4 }, { 3,  4,  2 }, { 3,  2,  6 }, { 3,  6,  8 }, { 3,  8,  9 },
+    { 4,  9,  5 }, { 2,  4, 11 }, { 6,  2, 10 }, { 8,  6,  7 }, { 9,  8,  1 }
+};
+
+/*
+Before renumbering, vertices are laid out as the 12 corners, then n-1
+points for each of the 30 edges, then (n-1)(n-2)/2 interior points for
+each face. Every block is written by exactly one task, so edges and
+faces can be filled in parallel without locking.
+*/
+struct IcoLayout {
+    size_t n;
+    size_t edge_base;
+    size_t face_base;
+    size_t per_face;
+    int edge_id[ICO_NUM_VERTICES][ICO_NUM_VERTICES];
+    unsigned int edge_ends[ICO_NUM_EDGES][2];
+
+    explicit IcoLayout( size_t n ) : n( n ) {
+        edge_base = ICO_NUM_VERTICES;
+        face_base = edge_base + ICO_NUM_EDGES * ( n - 1 );
+        per_face = n > 1 ? ( n - 1 ) * ( n - 2 ) / 2 : 0;
+
+        for ( size_t a = 0; a < ICO_NUM_VERTICES; ++a )
+            for ( size_t b = 0; b < ICO_NUM_VERTICES; ++b )
+                edge_id[a][b] = -1;
+        int num_edges = 0;
+        for ( size_t f = 0; f < ICO_NUM_FACES; ++f ) {
+            for ( size_t k = 0; k < 3; ++k ) {
+                unsigned int a = ico_faces[f][k];
+                unsigned int b = ico_faces[f][( k + 1 ) % 3];
+                if ( a > b )
+                    std::swap( a, b );
+                if ( edge_id[a][b] < 0 ) {
+                    edge_ends[num_edges][0] = a;
+                    edge_ends[num_edges][1] = b;
+                    edge_id[a][b] = edge_id[b][a] = num_edges++;
+                }
+            }
+        }
+        assert( num_edges == ICO_NUM_EDGES );
+    }
+
+    size_t num_vertices() const {
+        return face_base + ICO_NUM_FACES * per_face;
+    }
+
+    // The k-th of n steps along the edge from corner u to corner v.
+    size_t edge_vertex( unsigned int u, unsigned int v, size_t k ) const {
+        if ( k == 0 )
+            return u;
+        if ( k == n )
+            return v;
+        size_t e = edge_id[u][v];
+        size_t step = u < v ? k : n - k;
+        return edge_base + e * ( n - 1 ) + ( step - 1 );
+    }
+
+    // Grid point (i,j) of face f, i steps toward the second corner and j
+    // steps toward the third.
+    size_t face_vertex( size_t f, size_t i, size_t j ) const {
+        unsigned int a = ico_faces[f][0];
+        unsigned int b = ico_faces[f][1];
+        unsigned int c = ico_faces[f][2];
+        if ( j == 0 )
+            return edge_vertex( a, b, i );
+        if ( i == 0 )
+            return edge_vertex( a, c, j );
+        if ( i + j == n )
+            return edge_vertex( b, c, j );
+        size_t local = ( i - 1 ) * ( n - 1 ) - ( i - 1 ) * i / 2 + ( j - 1 );
+        return face_base + f * per_face + local;
+    }
+};
+
+static Vector3 ico_corner( size_t v ) {
+    return Vector3( ico_vertices[v][0], ico_vertices[v][1], ico_vertices[v][2] );
+}
+
+void generate_icosphere( size_t level, std::vector<Vector3>& vertices, std::vector<Triangle>& triangles )
+{
+    const size_t n = size_t( 1 ) << level;
+    const IcoLayout layout( n );
+    const size_t tris_per_face = n * n;
+
+    std::vector<Vector3> raw( layout.num_vertices() );
+    std::vector<Triangle> tris( ICO_NUM_FACES * tris_per_face );
+
+    for ( size_t v = 0; v < ICO_NUM_VERTICES; ++v )
+        raw[v] = normalize( ico_corner( v ) );
+
+    parallel_for( 0, ICO_NUM_EDGES, [&]( size_t e ) {
+        Vector3 a = ico_corner( layout.edge_ends[e][0] );
+        Vector3 b = ico_corner( layout.edge_ends[e][1] );
+        for ( size_t k = 1; k < n; ++k )
+            raw[layout.edge_base + e * ( n - 1 ) + ( k - 1 )] = normalize( a + ( b - a ) * ( real_t( k ) / n ) );
+    } );
+
+    parallel_for( 0, ICO_NUM_FACES, [&]( size_t f ) {
+        Vector3 a = ico_corner( ico_faces[f][0] );
+        Vector3 ab = ico_corner( ico_faces[f][1] ) - a;
+        Vector3 ac = ico_corner( ico_faces[f][2] ) - a;
+        for ( size_t i = 1; i + 1 < n; ++i )
+            for ( size_t j = 1; i + j < n; ++j )
+                raw[layout.face_vertex( f, i, j )] = normalize( a + ab * ( real_t( i ) / n ) + ac * ( real_t( j ) / n ) );
+
+        // rows of up/down triangle pairs, i.e. one strip per row
+        Triangle * out = &tris[f * tris_per_face];
+        for ( size_t i = 0; i < n; ++i ) {
+            for ( size_t j = 0; i + j < n; ++j ) {
+                Triangle up = {{ (unsigned int) layout.face_vertex( f, i, j ),
+                                 (unsigned int) layout.face_vertex( f, i + 1, j ),
+                                 (unsigned int) layout.face_vertex( f, i, j + 1 ) }};
+                *out++ = up;
+                if ( i + j + 1 < n ) {
+                    Triangle down = {{ (unsigned int) layout.face_vertex( f, i + 1, j ),
+                                       (unsigned int) layout.face_vertex( f, i + 1, j + 1 ),
+                                       (unsigned int) layout.face_vertex( f, i, j + 1 ) }};
+                    *out++ = down;
+                }
+            }
+        }
+    } );
+
+    // renumber vertices in order of first use by the triangle stream
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap( raw.size(), unused );
+    unsigned int next = 0;
+    vertices.resize( raw.size() );
+    for ( size_t t = 0; t < tris.size(); ++t ) {
+        for ( size_t k = 0; k < 3; ++k ) {
+            unsigned int& r = remap[tris[t].vertices[k]];
+            if ( r == unused ) {
+                vertices[next] = raw[tris[t].vertices[k]];
+                r = next++;
+            }
+            tris[t].vertices[k] = r;
+        }
+    }
+    assert( next == raw.size() );
+    triangles.swap( tris );
+}
+
+// on-disk layout
+
+static const char CACHE_MAGIC[4] = { 'N', 'B', 'I', 'C' };
+static const uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t real_size;  // sizeof(real_t) the vertices were written with
+    uint32_t num_levels;
+};
+
+struct CacheEntry {
+    uint32_t level;
+    uint32_t num_vertices;
+    uint32_t num_triangles;
+    uint32_t reserved;
+    uint64_t vertex_offset;
+    uint64_t triangle_offset;
+};
+
+static size_t align8( size_t x ) {
+    return ( x + 7 ) & ~size_t( 7 );
+}
+
+static void build_image( size_t max_level, std::vector<char>& image )
+{
+    size_t num_levels = max_level + 1;
+    std::vector< std::vector<Vector3> > verts( num_levels );
+    std::vector< std::vector<Triangle> > tris( num_levels );
+    for ( size_t l = 0; l < num_levels; ++l )
+        generate_icosphere( l, verts[l], tris[l] );
+
+    std::vector<CacheEntry> entries( num_levels );
+    size_t offset = align8( sizeof( CacheHeader ) + num_levels * sizeof( CacheEntry ) );
+    for ( size_t l = 0; l < num_levels; ++l ) {
+        CacheEntry& e = entries[l];
+        e.level = uint32_t( l );
+        e.num_vertices = uint32_t( verts[l].size() );
+        e.num_triangles = uint32_t( tris[l].size() );
+        e.reserved = 0;
+        e.vertex_offset = offset;
+        offset = align8( offset + verts[l].size() * sizeof( Vector3 ) );
+        e.triangle_offset = offset;
+        offset = align8( offset + tris[l].size() * sizeof( Triangle ) );
+    }
+
+    image.assign( offset, 0 );
+    CacheHeader header;
+    memcpy( header.magic, CACHE_MAGIC, sizeof header.magic );
+    header.version = CACHE_VERSION;
+    header.real_size = sizeof( real_t );
+    header.num_levels = uint32_t( num_levels );
+    memcpy( &image[0], &header, sizeof header );
+    memcpy( &image[sizeof header], &entries[0], num_levels * sizeof( CacheEntry ) );
+    for ( size_t l = 0; l < num_levels; ++l ) {
+        memcpy( &image[entries[l].vertex_offset], &verts[l][0], verts[l].size() * sizeof( Vector3 ) );
+        memcpy( &image[entries[l].triangle_offset], &tris[l][0], tris[l].size() * sizeof( Triangle ) );
+    }
+}
+
+IcosphereCache::IcosphereCache()
+    : mapping( 0 ), mapping_size( 0 ) { }
+
+IcosphereCache::~IcosphereCache()
+{
+    close();
+}
+
+void IcosphereCache::close()
+{
+    levels.clear();
+    buffer.clear();
+#ifndef _WIN32
+    if ( mapping )
+        munmap( mapping, mapping_size );
+#endif
+    mapping = 0;
+    mapping_size = 0;
+}
+
+bool IcosphereCache::parse( const char* data, size_t size, size_t max_level )
+{
+    levels.clear();
+    if ( size < sizeof( CacheHeader ) )
+        return false;
+    CacheHeader header;
+    memcpy( &header, data, sizeof header );
+    if ( memcmp( header.magic, CACHE_MAGIC, sizeof header.magic ) != 0 ||
+         header.version != CACHE_VERSION ||
+         header.real_size != sizeof( real_t ) ||
+         header.num_levels <= max_level ||
+         size < sizeof header + header.num_levels * sizeof( CacheEntry ) )
+        return false;
+
+    const CacheEntry* entries = (const CacheEntry*)( data + sizeof header );
+    for ( size_t l = 0; l < header.num_levels; ++l ) {
+        const CacheEntry& e = entries[l];
+        if ( e.level != l ||
+             e.vertex_offset % 8 != 0 || e.triangle_offset % 8 != 0 ||
+             e.vertex_offset + uint64_t( e.num_vertices ) * sizeof( Vector3 ) > size ||
+             e.triangle_offset + uint64_t( e.num_triangles ) * sizeof( Triangle ) > size ) {
+            levels.clear();
+            return false;
+        }
+        IcosphereLevel lvl;
+        lvl.level = l;
+        lvl.num_vertices = e.num_vertices;
+        lvl.num_triangles = e.num_triangles;
+        lvl.vertices = (const Vector3*)( data + e.vertex_offset );
+        lvl.triangles = (const Triangle*)( data + e.triangle_offset );
+        levels.push_back( lvl );
+    }
+    return true;
+}
+
+bool IcosphereCache::map_file( const std::string& path, size_t max_level )
+{
+#ifndef _WIN32
+    int fd = ::open( path.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        return false;
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size <= 0 ) {
+        ::close( fd );
+        return false;
+    }
+    void* p = mmap( 0, size_t( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( p == MAP_FAILED )
+        return false;
+    mapping = p;
+    mapping_size = size_t( st.st_size );
+    if ( !parse( (const char*) mapping, mapping_size, max_level ) ) {
+        close();
+        return false;
+    }
+    return true;
+#else
+    // no mmap here; a single bulk read is the next best thing
+    FILE* fp = fopen( path.c_str(), "rb" );
+    if ( !fp )
+        return false;
+    fseek( fp, 0, SEEK_END );
+    long size = ftell( fp );
+    fseek( fp, 0, SEEK_SET );
+    bool ok = size > 0;
+    if ( ok ) {
+        buffer.resize( size_t( size ) );
+        ok = fread( &buffer[0], 1, buffer.size(), fp ) == buffer.size();
+    }
+    fclose( fp );
+    if ( !ok || !parse( &buffer[0], buffer.size(), max_level ) ) {
+        close();
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool IcosphereCache::open( const std::string& path, size_t max_level )
+{
+    close();
+    if ( map_file( path, max_level ) )
+        return true;
+
+    std::vector<char> image;
+    build_image( max_level, image );
+
+    FILE* fp = fopen( path.c_str(), "wb" );
+    if ( fp ) {
+        bool written = fwrite( &image[0], 1, image.size(), fp ) == image.size();
+        written = fclose( fp ) == 0 && written;
+        if ( written && map_file( path, max_level ) )
+            return true;
+    }
+
+    std::cout << "WARNING: could not write icosphere cache " << path << std::endl;
+    buffer.swap( image );
+    return parse( &buffer[0], buffer.size(), max_level );
+}
+
+const IcosphereLevel* IcosphereCache::get( size_t level ) const
+{
+    return level < levels.size() ? &levels[level] : 0;
+}
+
+} // NEWTON
@@ -0,0 +1,74 @@
+#ifndef _ICOSPHERE_HPP_
+#define _ICOSPHERE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "mesh.hpp"
+#include "vector.hpp"
+
+namespace NEWTON {
+
+/*
+Unit icospheres built by splitting each edge of an icosahedron into
+2^level segments. Level L has 10*4^L + 2 vertices and 20*4^L triangles,
+the same topology that L rounds of Mesh::subdivide would give, but every
+vertex is placed in one pass so any level can be produced directly.
+
+Triangles are emitted face by face in row (strip) order and vertices are
+numbered by first use, so consecutive triangles share vertices that were
+transformed recently. That keeps the GPU post-transform cache warm and
+makes vertex fetches mostly sequential.
+*/
+
+// A read-only view of one level's geometry. The vertices are unit length
+// and double as the vertex normals.
+struct IcosphereLevel {
+    size_t level;
+    size_t num_vertices;
+    size_t num_triangles;
+    const Vector3 * vertices;
+    const Triangle * triangles;
+};
+
+// Builds the unit icosphere of the given level, spreading the work across
+// cores.
+void generate_icosphere( size_t level, std::vector<Vector3>& vertices, std::vector<Triangle>& triangles );
+
+/*
+A binary file holding levels 0..max_level, memory-mapped so that startup
+cost doesn't depend on mesh detail. If the file is missing, stale, or
+doesn't reach the requested level it is regenerated and rewritten.
+*/
+class IcosphereCache {
+public:
+    IcosphereCache();
+    ~IcosphereCache();
+
+    // Maps the cache at path, building it first if necessary. Returns false
+    // only if the geometry could be neither loaded nor generated; a cache
+    // that can't be written is kept in memory instead.
+    bool open( const std::string& path, size_t max_level );
+    void close();
+
+    // Returns the requested level, or 0 if it isn't in the cache.
+    const IcosphereLevel* get( size_t level ) const;
+
+private:
+    IcosphereCache( const IcosphereCache& );
+    IcosphereCache& operator=( const IcosphereCache& );
+
+    bool map_file( const std::string& path, size_t max_level );
+    bool parse( const char* data, size_t size, size_t max_level );
+
+    std::vector<IcosphereLevel> levels;
+
+    // exactly one of these backs the level views
+    void * mapping;
+    size_t mapping_size;
+    std::vector<char> buffer;
+};
+
+} // NEWTON
+
+#endif
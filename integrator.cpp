@@ -2,44 +2,116 @@
 
 namespace NEWTON {
 
-void RungeKuttaIntegrator::integrate(IntegrableSystem& sys, real_t dt) const {
-	real_t time;
+template<typename T>
+void BasicRungeKuttaIntegrator<T>::integrate(BasicIntegrableSystem<T>& sys, T dt) const {
+	T time;
 	size_t size = sys.size();
 
 	if(size == 0)
 		return;
 	state.resize(size);
 	state2.resize(size);
+	k1.resize(size);
+	k2.resize(size);
+	k3.resize(size);
+	k4.resize(size);
+
+	const T half_dt = dt/2;
+	const T sixth_dt = dt/6;
 
     // get the current state (pos, t)
 	sys.get_state(&state[0], &time);
+	start = state;
 
-	real_t * k1 = new real_t[size];
-	real_t * k2 = new real_t[size];
-	real_t * k3 = new real_t[size];
-	real_t * k4 = new real_t[size];
-
-	sys.eval_deriv(k1);
+	sys.eval_deriv(&k1[0]);
 
 	for(size_t i=0; i<size; i++)
-		state2[i] = state[i] + 0.5*dt*k1[i];
-	sys.set_state(&state2[0], time + 0.5*dt);
-	sys.eval_deriv(k2);
+		state2[i] = state[i] + half_dt*k1[i];
+	sys.set_state(&state2[0], time + half_dt);
+	sys.eval_deriv(&k2[0]);
 
 	for(size_t i=0; i<size; i++)
-		state2[i] = state[i] + 0.5*dt*k2[i];
-	sys.set_state(&state2[0], time + 0.5*dt);
-	sys.eval_deriv(k3);
+		state2[i] = state[i] + half_dt*k2[i];
+	sys.set_state(&state2[0], time + half_dt);
+	sys.eval_deriv(&k3[0]);
 
 	for(size_t i=0; i<size; i++)
 		state2[i] = state[i] + dt*k3[i];
 	sys.set_state(&state2[0], time + dt);
-	sys.eval_deriv(k4);
+	sys.eval_deriv(&k4[0]);
 
-	for(size_t i=0; i<size; i++)
-		state[i] += (1.0/6)*dt*(k1[i] + 2*k2[i] + 2*k3[i] + k4[i]);
+	if(!compensated) {
+		for(size_t i=0; i<size; i++)
+			state[i] += sixth_dt*(k1[i] + 2*k2[i] + 2*k3[i] + k4[i]);
+	} else {
+		if(carry.size() != size) {
+			carry.assign(size, T(0));
+			last = state;
+		}
+		for(size_t i=0; i<size; i++) {
+			if(state[i] != last[i])
+				carry[i] = T(0);
+			compensated_add(state[i], carry[i], sixth_dt*(k1[i] + 2*k2[i] + 2*k3[i] + k4[i]));
+		}
+		last = state;
+	}
 
 	sys.set_state(&state[0], time + dt);
+	dense.set(size, time, dt, &start[0], &k1[0], &k2[0], &k3[0], &k4[0]);
+}
+
+template<typename T>
+void BasicLeapfrogIntegrator<T>::integrate(BasicIntegrableSystem<T>& sys, T dt) const {
+	T time;
+	size_t size = sys.size();
+
+	if(size == 0)
+		return;
+	y0.resize(size);
+	f0.resize(size);
+	sys.get_state(&y0[0], &time);
+
+	// the last step's end is this one's start unless the state or the
+	// forces were changed
+	if(have_end && y1.size() == size && y0 == y1 && sys.force_generation() == end_generation)
+		f0.swap(f1);
+	else
+		sys.eval_deriv(&f0[0]);
+	y1.resize(size);
+	f1.resize(size);
+
+	const T half_dt = dt/2;
+	const size_t block = 2*dof;
+
+	// kick to the half step, then drift the positions a full step
+	for(size_t b = 0; b + block <= size; b += block) {
+		for(size_t i = 0; i < dof; i++) {
+			T v_half = y0[b+dof+i] + half_dt*f0[b+dof+i];
+			y1[b+i] = y0[b+i] + dt*v_half;
+			y1[b+dof+i] = v_half;
+		}
+	}
+	sys.set_state(&y1[0], time + dt);
+	sys.eval_deriv(&f1[0]);
+
+	// kick the rest of the way with the new accelerations
+	for(size_t b = 0; b + block <= size; b += block) {
+		for(size_t i = 0; i < dof; i++) {
+			y1[b+dof+i] += half_dt*f1[b+dof+i];
+			f1[b+i] = y1[b+dof+i];
+		}
+	}
+	sys.set_state(&y1[0], time + dt);
+	have_end = true;
+	end_generation = sys.force_generation();
+	dense.set(size, time, &y0[0], &f0[0], time + dt, &y1[0], &f1[0]);
 }
 
-} // NEWTON
\ No newline at end of file
+template class BasicRungeKuttaIntegrator< float >;
+template class BasicRungeKuttaIntegrator< double >;
+template class BasicRungeKuttaIntegrator< dd_real >;
+template class BasicLeapfrogIntegrator< float >;
+template class BasicLeapfrogIntegrator< double >;
+template class BasicLeapfrogIntegrator< dd_real >;
+
+} // NEWTON
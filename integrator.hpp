@@ -3,34 +3,117 @@
 
 #include <vector>
 #include "math.hpp"
+#include "double_double.hpp"
+#include "compensated.hpp"
+#include "dense_output.hpp"
 
 namespace NEWTON {
 
-class IntegrableSystem {
+// The physics core is templated on its scalar type T: float for quick
+// large-N previews, double (real_t) by default, or dd_real for long,
+// high-accuracy runs. float, double and dd_real are compiled in
+// integrator.cpp / system.cpp.
+
+template<typename T>
+class BasicIntegrableSystem {
 public:
-    virtual ~IntegrableSystem() { }
+    typedef T scalar_type;
+    virtual ~BasicIntegrableSystem() { }
     virtual size_t size() const = 0;
-    virtual void get_state( real_t* arr, real_t* time ) const = 0;
-    virtual void set_state( const real_t* arr, const real_t time ) = 0;
-    virtual void eval_deriv( real_t* deriv_result ) = 0;
+    virtual void get_state( T* arr, T* time ) const = 0;
+    virtual void set_state( const T* arr, const T time ) = 0;
+    virtual void eval_deriv( T* deriv_result ) = 0;
+
+    // Changes whenever the derivative may have changed with the state
+    // left as it was (a burn starting or ending). Integrators that reuse
+    // a derivative from the end of the last step check it along with
+    // the state.
+    virtual unsigned long force_generation() const { return 0; }
 };
 
-class Integrator {
+template<typename T>
+class BasicIntegrator {
 public:
-    virtual ~Integrator() { }
-    virtual void integrate( IntegrableSystem& sys, real_t dt ) const = 0;
-    typedef std::vector< real_t > StateList;
+    virtual ~BasicIntegrator() { }
+    virtual void integrate( BasicIntegrableSystem<T>& sys, T dt ) const = 0;
+    typedef std::vector< T > StateList;
+
+    // The state at any time inside the last step taken, or null if the
+    // integrator keeps none. Valid until the next call to integrate().
+    virtual const BasicDenseOutput<T>* dense_output() const { return 0; }
 };
 
-class RungeKuttaIntegrator : public Integrator {
+template<typename T>
+class BasicRungeKuttaIntegrator : public BasicIntegrator<T> {
 public:
-    virtual ~RungeKuttaIntegrator() { }
-    virtual void integrate( IntegrableSystem& sys, real_t dt ) const;
+    typedef typename BasicIntegrator<T>::StateList StateList;
+    explicit BasicRungeKuttaIntegrator( bool compensated = false ) : compensated( compensated ) { }
+    virtual ~BasicRungeKuttaIntegrator() { }
+    virtual void integrate( BasicIntegrableSystem<T>& sys, T dt ) const;
+    virtual const BasicDenseOutput<T>* dense_output() const { return start.empty() ? 0 : &dense; }
+
+    // With compensation on, each step's increment is added to the state
+    // with compensated_add and the rounding error is carried into the
+    // next step, so positions far from the origin keep accumulating
+    // small increments. The carry for a state element is dropped if the
+    // system's value changes between steps (e.g. set_body).
+    void set_compensated( bool on ) { compensated = on; carry.clear(); }
+    bool is_compensated() const { return compensated; }
 private:
+    bool compensated;
 	mutable StateList state;
     mutable StateList state2;
+    mutable StateList k1, k2, k3, k4;
+    mutable StateList carry;
+    mutable StateList last; // state as written at the end of the previous step
+    mutable StateList start; // state at the start of the last step
+    mutable BasicRungeKuttaDenseOutput<T> dense;
+};
+
+/*
+Kick-drift-kick leapfrog: second order, symplectic and time reversible,
+so energy errors stay bounded over long runs instead of drifting, at
+one force evaluation per step against RK4's four.
+
+The system's state must be a sequence of blocks of dof positions
+followed by their dof velocities, as System's is (dof = 3), and the
+position part of its derivative must be the velocities. The force at
+the end of a step is reused at the start of the next unless the state
+or the system's force_generation() changed in between; call reset()
+after changing anything else the forces depend on.
+
+Dense output is cubic Hermite from the positions, velocities and
+accelerations at both ends of the step, which the step computes anyway.
+*/
+template<typename T>
+class BasicLeapfrogIntegrator : public BasicIntegrator<T> {
+public:
+    typedef typename BasicIntegrator<T>::StateList StateList;
+    explicit BasicLeapfrogIntegrator( size_t dof = 3 ) : dof( dof ), have_end( false ), end_generation( 0 ) { }
+    virtual ~BasicLeapfrogIntegrator() { }
+    virtual void integrate( BasicIntegrableSystem<T>& sys, T dt ) const;
+    virtual const BasicDenseOutput<T>* dense_output() const { return have_end ? &dense : 0; }
+    void reset() { have_end = false; }
+private:
+    size_t dof;
+    mutable StateList y0, f0, y1, f1;
+    mutable bool have_end; // y1, f1 hold the end of the last step
+    mutable unsigned long end_generation; // sys.force_generation() for f1
+    mutable BasicHermiteDenseOutput<T> dense;
 };
 
+typedef BasicIntegrableSystem< real_t > IntegrableSystem;
+typedef BasicIntegrator< real_t > Integrator;
+typedef BasicRungeKuttaIntegrator< real_t > RungeKuttaIntegrator;
+typedef BasicLeapfrogIntegrator< real_t > LeapfrogIntegrator;
+
+extern template class BasicRungeKuttaIntegrator< float >;
+extern template class BasicRungeKuttaIntegrator< double >;
+extern template class BasicRungeKuttaIntegrator< dd_real >;
+extern template class BasicLeapfrogIntegrator< float >;
+extern template class BasicLeapfrogIntegrator< double >;
+extern template class BasicLeapfrogIntegrator< dd_real >;
+
 } // NEWTON
 
-#endif
\ No newline at end of file
+#endif
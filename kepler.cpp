@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "kepler.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+namespace NEWTON {
+
+static const real_t TWO_PI = 2 * PI;
+static const real_t DEGENERATE = 1e-11;        // relative size below which the node or periapsis is undefined
+static const real_t ANOMALY_TOLERANCE = 1e-14; // rad
+static const int MAX_ITERATIONS = 50;
+static const size_t MIN_ELEMENTS_PER_THREAD = 1024;
+static const size_t PROPAGATE_CHUNK = 256;       // orbits solved together, on the stack
+
+// M reduced to [-pi, pi]
+static inline real_t wrap_angle( real_t m )
+{
+    return m - TWO_PI * std::floor( m / TWO_PI + real_t( 0.5 ) );
+}
+
+static inline real_t sign( real_t x )
+{
+    return x < 0 ? real_t( -1 ) : real_t( 1 );
+}
+
+OrbitalElements elements_from_state( const Vector3& r, const Vector3& v, real_t mu, real_t epoch )
+{
+    OrbitalElements el;
+    el.epoch = epoch;
+    el.mu = mu;
+
+    real_t rn = length( r ), v2 = dot( v, v ), rv = dot( r, v );
+    Vector3 h = cross( r, v );
+    real_t hn = length( h );
+    Vector3 e = ( r * ( v2 - mu / rn ) - v * rv ) / mu;
+    el.eccentricity = length( e );
+    el.semi_major_axis = -mu / ( v2 - 2 * mu / rn );
+    el.inclination = std::acos( std::max( real_t( -1 ), std::min( real_t( 1 ), h.z / hn ) ) );
+
+    Vector3 hh = h / hn;
+    Vector3 node( -h.y, h.x, 0 );
+    real_t nn = length( node );
+    node = nn > DEGENERATE * hn ? node / nn : Vector3::UnitX;
+    el.ascending_node = std::atan2( node.y, node.x );
+
+    // periapsis direction, or the node for a circular orbit
+    Vector3 p = el.eccentricity > DEGENERATE ? e / el.eccentricity : node;
+    el.periapsis = std::atan2( dot( cross( node, p ), hh ), dot( node, p ) );
+
+    real_t nu = std::atan2( dot( cross( p, r ), hh ), dot( p, r ) );
+    real_t ecc = el.eccentricity;
+    if ( ecc < 1 ) {
+        real_t ea = std::atan2( std::sqrt( 1 - ecc * ecc ) * std::sin( nu ), ecc + std::cos( nu ) );
+        el.mean_anomaly = ea - ecc * std::sin( ea );
+    } else {
+        real_t ha = std::asinh( std::sqrt( ecc * ecc - 1 ) * std::sin( nu ) / ( 1 + ecc * std::cos( nu ) ) );
+        el.mean_anomaly = ecc * std::sinh( ha ) - ha;
+    }
+    return el;
+}
+
+// The perifocal unit vectors of the elements' orientation.
+static void perifocal( const OrbitalElements& el, Vector3& p, Vector3& q )
+{
+    real_t co = std::cos( el.ascending_node ), so = std::sin( el.ascending_node );
+    real_t cw = std::cos( el.periapsis ), sw = std::sin( el.periapsis );
+    real_t ci = std::cos( el.inclination ), si = std::sin( el.inclination );
+    p = Vector3( co * cw - so * sw * ci, so * cw + co * sw * ci, sw * si );
+    q = Vector3( -co * sw - so * cw * ci, -so * sw + co * cw * ci, cw * si );
+}
+
+static inline real_t mean_motion( const OrbitalElements& el )
+{
+    real_t a = std::fabs( el.semi_major_axis );
+    return std::sqrt( el.mu / ( a * a * a ) );
+}
+
+// Position and velocity in the perifocal frame from the anomaly solved
+// by solve_kepler.
+static inline void perifocal_state( real_t e, real_t b, real_t a, real_t n, real_t anomaly,
+                                    real_t& x, real_t& y, real_t& vx, real_t& vy )
+{
+    if ( e < 1 ) {
+        real_t s = std::sin( anomaly ), c = std::cos( anomaly );
+        real_t k = n * a / ( 1 - e * c );
+        x = a * ( c - e ); y = b * s;
+        vx = -k * s; vy = k * b / a * c;
+    } else {
+        real_t s = std::sinh( anomaly ), c = std::cosh( anomaly );
+        real_t k = n * a / ( e * c - 1 );
+        x = a * ( e - c ); y = b * s;
+        vx = -k * s; vy = k * b / a * c;
+    }
+}
+
+void state_from_elements( const OrbitalElements& el, real_t time, Vector3& r, Vector3& v )
+{
+    KeplerOrbits one;
+    one.add( el );
+    one.state( 0, time, r, v );
+}
+
+OrbitalElements osculating_elements( const System& sys, size_t body, size_t primary )
+{
+    const Body& b = sys.bodies[body];
+    const Body& p = sys.bodies[primary];
+    return elements_from_state( b.position - p.position, b.velocity - p.velocity, G * ( b.mass + p.mass ), sys.time );
+}
+
+void batch_elements( ConstVector3Span r, ConstVector3Span v, const real_t* mu, real_t epoch, OrbitalElements* out )
+{
+    assert( r.size == v.size );
+    parallel_for( 0, r.size, [&]( size_t i ) {
+        size_t ro = r.offset( i ), vo = v.offset( i );
+        out[i] = elements_from_state( Vector3( r.x[ro], r.y[ro], r.z[ro] ), Vector3( v.x[vo], v.y[vo], v.z[vo] ), mu[i], epoch );
+    }, MIN_ELEMENTS_PER_THREAD );
+}
+
+// Kepler's equation, one orbit.
+static real_t scalar_kepler( real_t m, real_t e )
+{
+    if ( e < 1 ) {
+        m = wrap_angle( m );
+        real_t ea = m + real_t( 0.85 ) * e * sign( m ); // Danby
+        for ( int it = 0; it < MAX_ITERATIONS; ++it ) {
+            real_t d = ( ea - e * std::sin( ea ) - m ) / ( 1 - e * std::cos( ea ) );
+            ea -= d;
+            if ( std::fabs( d ) <= ANOMALY_TOLERANCE )
+                break;
+        }
+        return ea;
+    }
+    real_t ha = sign( m ) * std::log( 2 * std::fabs( m ) / e + real_t( 1.8 ) );
+    for ( int it = 0; it < MAX_ITERATIONS; ++it ) {
+        real_t d = ( e * std::sinh( ha ) - ha - m ) / ( e * std::cosh( ha ) - 1 );
+        ha -= d;
+        if ( std::fabs( d ) <= ANOMALY_TOLERANCE * std::max( real_t( 1 ), std::fabs( ha ) ) )
+            break;
+    }
+    return ha;
+}
+
+#if SIMD_HAVE_AVX2
+// sin and cos of x, |x| < 2^20, to within an ulp or two: x is reduced by
+// the nearest multiple of pi/2 (pi/2 split in two, fdlibm's constants)
+// to [-pi/4, pi/4], where Cephes' polynomials apply, and the quadrant
+// picks which is which and the signs.
+SIMD_AVX2 static inline void avx2_sincos( __m256d x, __m256d& s, __m256d& c )
+{
+    const __m256d pio2_1 = _mm256_set1_pd( 1.57079632673412561417e+00 );
+    const __m256d pio2_1t = _mm256_set1_pd( 6.07710050650619224932e-11 );
+    __m256d j = _mm256_round_pd( _mm256_mul_pd( x, _mm256_set1_pd( 2 / PI ) ), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+    __m256d r = _mm256_fnmadd_pd( j, pio2_1t, _mm256_fnmadd_pd( j, pio2_1, x ) );
+    __m256d z = _mm256_mul_pd( r, r );
+
+    __m256d ps = _mm256_set1_pd( 1.58962301576546568060e-10 );
+    ps = _mm256_fmadd_pd( ps, z, _mm256_set1_pd( -2.50507477628578072866e-8 ) );
+    ps = _mm256_fmadd_pd( ps, z, _mm256_set1_pd( 2.75573136213857245213e-6 ) );
+    ps = _mm256_fmadd_pd( ps, z, _mm256_set1_pd( -1.98412698295895385996e-4 ) );
+    ps = _mm256_fmadd_pd( ps, z, _mm256_set1_pd( 8.33333333332211858878e-3 ) );
+    ps = _mm256_fmadd_pd( ps, z, _mm256_set1_pd( -1.66666666666666307295e-1 ) );
+    __m256d sr = _mm256_fmadd_pd( _mm256_mul_pd( ps, z ), r, r );
+
+    __m256d pc = _mm256_set1_pd( -1.13585365213876817300e-11 );
+    pc = _mm256_fmadd_pd( pc, z, _mm256_set1_pd( 2.08757008419747316778e-9 ) );
+    pc = _mm256_fmadd_pd( pc, z, _mm256_set1_pd( -2.75573141792967388112e-7 ) );
+    pc = _mm256_fmadd_pd( pc, z, _mm256_set1_pd( 2.48015872888517045348e-5 ) );
+    pc = _mm256_fmadd_pd( pc, z, _mm256_set1_pd( -1.38888888888730564116e-3 ) );
+    pc = _mm256_fmadd_pd( pc, z, _mm256_set1_pd( 4.16666666666665929218e-2 ) );
+    __m256d cr = _mm256_fmadd_pd( _mm256_mul_pd( pc, z ), z, _mm256_fnmadd_pd( _mm256_set1_pd( 0.5 ), z, _mm256_set1_pd( 1 ) ) );
+
+    // quadrant j mod 4 in 0..3
+    __m256d quad = _mm256_sub_pd( j, _mm256_mul_pd( _mm256_set1_pd( 4 ), _mm256_floor_pd( _mm256_mul_pd( j, _mm256_set1_pd( 0.25 ) ) ) ) );
+    __m256d odd = _mm256_cmp_pd( _mm256_sub_pd( quad, _mm256_mul_pd( _mm256_set1_pd( 2 ), _mm256_floor_pd( _mm256_mul_pd( quad, _mm256_set1_pd( 0.5 ) ) ) ) ),
+                                 _mm256_setzero_pd(), _CMP_NEQ_OQ );
+    __m256d sin_neg = _mm256_cmp_pd( quad, _mm256_set1_pd( 1.5 ), _CMP_GT_OQ );
+    __m256d cos_neg = _mm256_and_pd( _mm256_cmp_pd( quad, _mm256_set1_pd( 0.5 ), _CMP_GT_OQ ),
+                                     _mm256_cmp_pd( quad, _mm256_set1_pd( 2.5 ), _CMP_LT_OQ ) );
+    const __m256d sign_bit = _mm256_set1_pd( -0.0 );
+    s = _mm256_xor_pd( _mm256_blendv_pd( sr, cr, odd ), _mm256_and_pd( sin_neg, sign_bit ) );
+    c = _mm256_xor_pd( _mm256_blendv_pd( cr, sr, odd ), _mm256_and_pd( cos_neg, sign_bit ) );
+}
+
+// Four elliptic orbits: Newton from Danby's guess until every lane has
+// converged.
+SIMD_AVX2 static inline __m256d avx2_kepler4( __m256d m, __m256d e )
+{
+    const __m256d two_pi = _mm256_set1_pd( TWO_PI );
+    const __m256d one = _mm256_set1_pd( 1 );
+    const __m256d abs_mask = _mm256_castsi256_pd( _mm256_set1_epi64x( 0x7fffffffffffffffLL ) );
+    const __m256d sign_bit = _mm256_set1_pd( -0.0 );
+    m = _mm256_sub_pd( m, _mm256_mul_pd( two_pi, _mm256_floor_pd( _mm256_add_pd( _mm256_div_pd( m, two_pi ), _mm256_set1_pd( 0.5 ) ) ) ) );
+    __m256d guess = _mm256_mul_pd( _mm256_set1_pd( 0.85 ), e );
+    __m256d ea = _mm256_add_pd( m, _mm256_or_pd( guess, _mm256_and_pd( m, sign_bit ) ) );
+    for ( int it = 0; it < MAX_ITERATIONS; ++it ) {
+        __m256d s, c;
+        avx2_sincos( ea, s, c );
+        __m256d f = _mm256_sub_pd( _mm256_fnmadd_pd( e, s, ea ), m );
+        __m256d d = _mm256_div_pd( f, _mm256_fnmadd_pd( e, c, one ) );
+        ea = _mm256_sub_pd( ea, d );
+        __m256d big = _mm256_cmp_pd( _mm256_and_pd( d, abs_mask ), _mm256_set1_pd( ANOMALY_TOLERANCE ), _CMP_GT_OQ );
+        if ( _mm256_movemask_pd( big ) == 0 )
+            break;
+    }
+    return ea;
+}
+
+SIMD_AVX2 static void avx2_solve_kepler( const real_t* m, const real_t* e, real_t* out, size_t n )
+{
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+        if ( e[i] >= 1 || e[i + 1] >= 1 || e[i + 2] >= 1 || e[i + 3] >= 1 ) {
+            for ( size_t k = i; k < i + 4; ++k )
+                out[k] = scalar_kepler( m[k], e[k] );
+            continue;
+        }
+        _mm256_storeu_pd( out + i, avx2_kepler4( _mm256_loadu_pd( m + i ), _mm256_loadu_pd( e + i ) ) );
+    }
+    for ( ; i < n; ++i )
+        out[i] = scalar_kepler( m[i], e[i] );
+}
+#endif
+
+void solve_kepler( const real_t* mean_anomaly, const real_t* eccentricity, real_t* out, size_t n )
+{
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() )
+        return avx2_solve_kepler( mean_anomaly, eccentricity, out, n );
+#endif
+    for ( size_t i = 0; i < n; ++i )
+        out[i] = scalar_kepler( mean_anomaly[i], eccentricity[i] );
+}
+
+size_t KeplerOrbits::add( const OrbitalElements& el )
+{
+    size_t i = elements.size();
+    elements.resize( i + 1 );
+    p.resize( i + 1 ); q.resize( i + 1 );
+    ecc.resize( i + 1 ); b.resize( i + 1 ); rate.resize( i + 1 );
+    set( i, el );
+    return i;
+}
+
+void KeplerOrbits::set( size_t i, const OrbitalElements& el )
+{
+    assert( el.eccentricity != 1 );
+    elements[i] = el;
+    Vector3 pi, qi;
+    perifocal( el, pi, qi );
+    p.set( i, pi );
+    q.set( i, qi );
+    ecc[i] = el.eccentricity;
+    b[i] = std::fabs( el.semi_major_axis ) * std::sqrt( std::fabs( 1 - el.eccentricity * el.eccentricity ) );
+    rate[i] = mean_motion( el );
+}
+
+void KeplerOrbits::remove( size_t i )
+{
+    size_t last = size() - 1;
+    for ( size_t k = i; k < last; ++k ) {
+        elements[k] = elements[k + 1];
+        p.set( k, p.get( k + 1 ) );
+        q.set( k, q.get( k + 1 ) );
+        ecc[k] = ecc[k + 1]; b[k] = b[k + 1]; rate[k] = rate[k + 1];
+    }
+    elements.pop_back();
+    p.resize( last ); q.resize( last );
+    ecc.pop_back(); b.pop_back(); rate.pop_back();
+}
+
+void KeplerOrbits::clear()
+{
+    elements.clear();
+    p.resize( 0 ); q.resize( 0 );
+    ecc.clear(); b.clear(); rate.clear();
+}
+
+void KeplerOrbits::state( size_t i, real_t time, Vector3& r, Vector3& v ) const
+{
+    const OrbitalElements& el = elements[i];
+    real_t anomaly = scalar_kepler( el.mean_anomaly + rate[i] * ( time - el.epoch ), ecc[i] );
+    real_t x, y, vx, vy;
+    perifocal_state( ecc[i], b[i], std::fabs( el.semi_major_axis ), rate[i], anomaly, x, y, vx, vy );
+    r = p.get( i ) * x + q.get( i ) * y;
+    v = p.get( i ) * vx + q.get( i ) * vy;
+}
+
+void KeplerOrbits::propagate( real_t time, Vector3Span r, Vector3Span v ) const
+{
+    propagate( time, 0, size(), r, v );
+}
+
+void KeplerOrbits::propagate( real_t time, size_t begin, size_t end, Vector3Span r, Vector3Span v ) const
+{
+    assert( r.size == size() && v.size == size() && end <= size() );
+    real_t m[PROPAGATE_CHUNK], anomaly[PROPAGATE_CHUNK];
+    for ( size_t c = begin; c < end; c += PROPAGATE_CHUNK ) {
+        size_t n = std::min( PROPAGATE_CHUNK, end - c );
+        for ( size_t k = 0; k < n; ++k )
+            m[k] = elements[c + k].mean_anomaly + rate[c + k] * ( time - elements[c + k].epoch );
+        solve_kepler( m, &ecc[c], anomaly, n );
+
+        for ( size_t k = 0; k < n; ++k ) {
+            size_t i = c + k;
+            real_t x, y, vx, vy;
+            perifocal_state( ecc[i], b[i], std::fabs( elements[i].semi_major_axis ), rate[i], anomaly[k], x, y, vx, vy );
+            size_t ro = r.offset( i ), vo = v.offset( i );
+            r.x[ro] = p.x[i] * x + q.x[i] * y;
+            r.y[ro] = p.y[i] * x + q.y[i] * y;
+            r.z[ro] = p.z[i] * x + q.z[i] * y;
+            v.x[vo] = p.x[i] * vx + q.x[i] * vy;
+            v.y[vo] = p.y[i] * vx + q.y[i] * vy;
+            v.z[vo] = p.z[i] * vx + q.z[i] * vy;
+        }
+    }
+}
+
+const size_t KeplerRails::NO_PRIMARY;
+
+void KeplerRails::add( const System& sys, size_t body, size_t primary )
+{
+    assert( body < sys.bodies.size() && primary < sys.bodies.size() );
+    insert( body, primary, osculating_elements( sys, body, primary ) );
+}
+
+void KeplerRails::add_fixed( const System& sys, size_t body, real_t mu )
+{
+    assert( body < sys.bodies.size() && mu > 0 );
+    const Body& b = sys.bodies[body];
+    insert( body, NO_PRIMARY, elements_from_state( b.position, b.velocity, mu, sys.time ) );
+}
+
+void KeplerRails::insert( size_t body, size_t primary, const OrbitalElements& el )
+{
+    assert( !on_rails( body ) );
+    if ( slots.size() <= body )
+        slots.resize( body + 1, NO_PRIMARY );
+    slots[body] = orbits.add( el );
+    railed.push_back( body );
+    primaries.push_back( primary );
+}
+
+void KeplerRails::remove( size_t body )
+{
+    if ( !on_rails( body ) )
+        return;
+    size_t k = slots[body];
+    orbits.remove( k );
+    railed.erase( railed.begin() + k );
+    primaries.erase( primaries.begin() + k );
+    slots[body] = NO_PRIMARY;
+    for ( size_t i = k; i < railed.size(); ++i )
+        slots[railed[i]] = i;
+}
+
+void KeplerRails::clear()
+{
+    railed.clear();
+    primaries.clear();
+    slots.clear();
+    orbits.clear();
+}
+
+void KeplerRails::apply( std::vector< Body >& bodies, real_t time )
+{
+    size_t n = orbits.size();
+    if ( n == 0 )
+        return;
+    rel_pos.resize( n );
+    rel_vel.resize( n );
+    orbits.propagate( time, rel_pos.span(), rel_vel.span() );
+    // in order added, so primaries on rails are placed before their bodies
+    for ( size_t k = 0; k < n; ++k ) {
+        Body& b = bodies[railed[k]];
+        b.position = rel_pos.get( k );
+        b.velocity = rel_vel.get( k );
+        if ( primaries[k] != NO_PRIMARY ) {
+            b.position += bodies[primaries[k]].position;
+            b.velocity += bodies[primaries[k]].velocity;
+        }
+    }
+}
+
+} // NEWTON
@@ -0,0 +1,135 @@
+#ifndef _KEPLER_HPP_
+#define _KEPLER_HPP_
+
+#include <vector>
+
+#include "batch.hpp"
+#include "system.hpp"
+
+namespace NEWTON {
+
+// Classical elements of a two-body orbit.
+struct OrbitalElements
+{
+    real_t semi_major_axis;  // m; negative for hyperbolic orbits
+    real_t eccentricity;
+    real_t inclination;      // rad, from the xy plane
+    real_t ascending_node;   // rad, longitude of the ascending node from +x; 0 if equatorial
+    real_t periapsis;        // rad, argument of periapsis from the node; 0 if circular
+    real_t mean_anomaly;     // rad, at epoch
+    real_t epoch;            // s, system time
+    real_t mu;               // G (m + m_primary)
+};
+
+// The osculating elements of position r and velocity v relative to a
+// primary. For an equatorial orbit the node is taken as +x, for a
+// circular one the periapsis as the node, so the angles are always
+// defined; parabolic orbits (e = 1 exactly) aren't representable.
+OrbitalElements elements_from_state( const Vector3& r, const Vector3& v, real_t mu, real_t epoch );
+
+// The state on the orbit at the given time.
+void state_from_elements( const OrbitalElements& el, real_t time, Vector3& r, Vector3& v );
+
+// The elements of body about primary, for diagnostics; nothing is
+// integrated.
+OrbitalElements osculating_elements( const System& sys, size_t body, size_t primary );
+
+// out[i] = elements_from_state( r[i], v[i], mu[i], epoch ), split across
+// threads for large batches.
+void batch_elements( ConstVector3Span r, ConstVector3Span v, const real_t* mu, real_t epoch, OrbitalElements* out );
+
+/*
+Kepler's equation for n orbits at once: the eccentric anomaly E with
+M = E - e sin E for e < 1, or the hyperbolic anomaly H with
+M = e sinh H - H for e > 1. Elliptic orbits are solved four at a time
+with AVX2 where available, Newton's method from Danby's starting guess
+with a polynomial sincos, so every lane stays in registers until the
+slowest has converged; hyperbolic ones go through a scalar loop.
+*/
+void solve_kepler( const real_t* mean_anomaly, const real_t* eccentricity, real_t* out, size_t n );
+
+/*
+A set of orbits propagated in closed form. Each orbit is kept with its
+perifocal frame (P towards periapsis, Q 90 degrees ahead in the plane)
+in SoA arrays, so placing all of them at a time costs one batched Kepler
+solve and a few multiply-adds each, with no trigonometry of the angles.
+*/
+class KeplerOrbits {
+public:
+    size_t add( const OrbitalElements& el );
+    void set( size_t i, const OrbitalElements& el );
+    void remove( size_t i );
+    void clear();
+
+    size_t size() const { return elements.size(); }
+    const OrbitalElements& get( size_t i ) const { return elements[i]; }
+
+    // One orbit's state relative to its primary.
+    void state( size_t i, real_t time, Vector3& r, Vector3& v ) const;
+
+    // Every orbit's state relative to its primary; r and v hold size().
+    void propagate( real_t time, Vector3Span r, Vector3Span v ) const;
+    // Orbits [begin, end) only, into the same places of r and v; calls
+    // on disjoint ranges may run concurrently.
+    void propagate( real_t time, size_t begin, size_t end, Vector3Span r, Vector3Span v ) const;
+
+private:
+    std::vector< OrbitalElements > elements;
+    Vector3Array p, q;
+    std::vector< real_t > ecc, b, rate; // e, |a| sqrt(|1 - e^2|), mean motion
+};
+
+/*
+Bodies "on rails": instead of being integrated, each follows the conic
+it was on when added, about its primary, in closed form. Set
+System::rails to it; the system then moves these bodies to their
+places for the time of every integrator stage and at the end of every
+step, so other bodies feel them where they really are. on_rails
+tells the system which they are, so gravity on them is not computed
+(by direct_gravity and TiledGravity; other solvers compute and discard
+it). Any query is O(1) per body whatever the time, and no error
+accumulates.
+
+A railed body is placed relative to its primary's current position, so
+a primary that is itself on rails must be added first. add_fixed puts
+a body on an orbit about a fixed point at the origin instead, with the
+central mu given by the caller.
+*/
+class KeplerRails : public Rails {
+public:
+    static const size_t NO_PRIMARY = size_t( -1 );
+
+    KeplerRails() { }
+    virtual ~KeplerRails() { }
+
+    // Puts body on rails about primary, on the orbit of its current
+    // state relative to primary with mu = G (m_body + m_primary).
+    void add( const System& sys, size_t body, size_t primary );
+    // Puts body on rails about the origin, on the orbit of its current
+    // state with central mu.
+    void add_fixed( const System& sys, size_t body, real_t mu );
+    void remove( size_t body );
+    void clear();
+
+    bool on_rails( size_t body ) const { return body < slots.size() && slots[body] != NO_PRIMARY; }
+    virtual bool on_rails( size_t body, real_t ) const { return on_rails( body ); }
+    size_t get_primary( size_t body ) const { return primaries[slots[body]]; }
+    const OrbitalElements& get_elements( size_t body ) const { return orbits.get( slots[body] ); }
+
+    // The body's state relative to its primary.
+    void state( size_t body, real_t time, Vector3& r, Vector3& v ) const { orbits.state( slots[body], time, r, v ); }
+
+    virtual void apply( std::vector< Body >& bodies, real_t time );
+
+private:
+    void insert( size_t body, size_t primary, const OrbitalElements& el );
+
+    std::vector< size_t > railed, primaries; // per orbit
+    std::vector< size_t > slots;             // per body: its orbit, or NO_PRIMARY
+    KeplerOrbits orbits;
+    Vector3Array rel_pos, rel_vel;
+};
+
+} // NEWTON
+
+#endif
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ostream>
+
+#include "lambert.hpp"
+#include "parallel.hpp"
+
+namespace NEWTON {
+
+static const real_t TIME_TOLERANCE = 1e-11;  // relative to the time of flight
+static const real_t MIN_SIN_ANGLE = 1e-9;     // collinear below this
+static const int MAX_ITERATIONS = 64;
+static const size_t DEFAULT_TILE = 32;
+
+// Stumpff functions C(z) and S(z), by series near the parabola where the
+// closed forms cancel.
+static void stumpff( real_t z, real_t& c, real_t& s )
+{
+    if ( z > 1e-3 ) {
+        real_t q = std::sqrt( z );
+        c = ( 1 - std::cos( q ) ) / z;
+        s = ( q - std::sin( q ) ) / ( z * q );
+    } else if ( z < -1e-3 ) {
+        real_t q = std::sqrt( -z );
+        c = ( std::cosh( q ) - 1 ) / -z;
+        s = ( std::sinh( q ) - q ) / ( -z * q );
+    } else {
+        c = real_t( 1 ) / 2 - z * ( real_t( 1 ) / 24 - z * ( real_t( 1 ) / 720 - z / 40320 ) );
+        s = real_t( 1 ) / 6 - z * ( real_t( 1 ) / 120 - z * ( real_t( 1 ) / 5040 - z / 362880 ) );
+    }
+}
+
+namespace {
+
+// The universal-variable time equation F(z) = sqrt(mu) (t(z) - tof) for
+// a geometry fixed by r1 + r2 and A.
+struct TimeEquation
+{
+    real_t r_sum, a, sqrt_mu_tof;
+
+    real_t y( real_t z, real_t c, real_t s ) const { return r_sum + a * ( z * s - 1 ) / std::sqrt( c ); }
+
+    // Where y < 0 there is no orbit; those z are all on the short side
+    // of the root, so F is taken as -infinity there.
+    real_t value( real_t z ) const
+    {
+        real_t c, s;
+        stumpff( z, c, s );
+        real_t yz = y( z, c, s );
+        if ( yz < 0 )
+            return -std::numeric_limits< real_t >::infinity();
+        return std::pow( yz / c, real_t( 1.5 ) ) * s + a * std::sqrt( yz ) - sqrt_mu_tof;
+    }
+
+    real_t derivative( real_t z ) const
+    {
+        real_t c, s;
+        stumpff( z, c, s );
+        real_t yz = y( z, c, s );
+        if ( std::fabs( z ) < 1e-3 ) {
+            real_t y0 = y( 0, real_t( 0.5 ), real_t( 1 ) / 6 );
+            return std::sqrt( real_t( 2 ) ) / 40 * std::pow( y0, real_t( 1.5 ) )
+                 + a / 8 * ( std::sqrt( y0 ) + a * std::sqrt( 1 / ( 2 * y0 ) ) );
+        }
+        return std::pow( yz / c, real_t( 1.5 ) ) * ( ( c - 3 * s / ( 2 * c ) ) / ( 2 * z ) + 3 * s * s / ( 4 * c ) )
+             + a / 8 * ( 3 * s / c * std::sqrt( yz ) + a * std::sqrt( c / yz ) );
+    }
+};
+
+}
+
+bool solve_lambert( const Vector3& r1, const Vector3& r2, real_t tof, real_t mu, const Vector3& normal,
+                    Vector3& v1, Vector3& v2 )
+{
+    real_t n1 = length( r1 ), n2 = length( r2 );
+    if ( !( tof > 0 ) || n1 == 0 || n2 == 0 )
+        return false;
+    real_t cos_angle = std::max( real_t( -1 ), std::min( real_t( 1 ), dot( r1, r2 ) / ( n1 * n2 ) ) );
+    Vector3 h = cross( r1, r2 );
+    real_t sin_angle = length( h ) / ( n1 * n2 );
+    if ( sin_angle < MIN_SIN_ANGLE )
+        return false;
+    if ( dot( h, normal ) < 0 )
+        sin_angle = -sin_angle; // the long way round
+
+    TimeEquation eq;
+    eq.r_sum = n1 + n2;
+    eq.a = sin_angle * std::sqrt( n1 * n2 / ( 1 - cos_angle ) );
+    eq.sqrt_mu_tof = std::sqrt( mu ) * tof;
+
+    // bracket the root: F rises from -infinity (or y = 0) to +infinity at
+    // z = 4 pi^2, where the transfer becomes a full ellipse
+    real_t lo, hi, z = 0, f = eq.value( 0 );
+    if ( f < 0 ) {
+        lo = 0;
+        hi = 4 * PI * PI;
+    } else {
+        hi = 0;
+        lo = -4 * PI * PI;
+        while ( eq.value( lo ) > 0 ) {
+            lo *= 4;
+            if ( lo < -1e8 )
+                return false;
+        }
+    }
+
+    real_t tolerance = TIME_TOLERANCE * eq.sqrt_mu_tof;
+    int it = 0;
+    for ( ; it < MAX_ITERATIONS && std::fabs( f ) > tolerance; ++it ) {
+        if ( f < 0 )
+            lo = z;
+        else
+            hi = z;
+        real_t next = std::isfinite( f ) ? z - f / eq.derivative( z ) : lo - 1; // fails the test below
+        if ( !( next > lo && next < hi ) )
+            next = ( lo + hi ) / 2;
+        if ( next == z )
+            break;
+        z = next;
+        f = eq.value( z );
+    }
+    if ( !std::isfinite( f ) || ( it == MAX_ITERATIONS && std::fabs( f ) > tolerance ) )
+        return false;
+
+    real_t c, s;
+    stumpff( z, c, s );
+    real_t y = eq.y( z, c, s );
+    real_t lf = 1 - y / n1, lg = eq.a * std::sqrt( y / mu ), lgdot = 1 - y / n2;
+    v1 = ( r2 - r1 * lf ) / lg;
+    v2 = ( r2 * lgdot - r1 ) / lg;
+    return true;
+}
+
+Porkchop::Porkchop( size_t origin, size_t destination, size_t central, real_t mu )
+    : origin( origin ), destination( destination ), central( central ), mu( mu ),
+      departure_start( 0 ), departure_step( 0 ), arrival_start( 0 ), arrival_step( 0 ),
+      departures( 0 ), arrivals( 0 ), tile( DEFAULT_TILE )
+{
+}
+
+void Porkchop::set_departures( real_t start, real_t step, size_t count )
+{
+    departure_start = start;
+    departure_step = step;
+    departures = count;
+}
+
+void Porkchop::set_arrivals( real_t start, real_t step, size_t count )
+{
+    arrival_start = start;
+    arrival_step = step;
+    arrivals = count;
+}
+
+void Porkchop::sweep( const Ephemeris& ephemeris )
+{
+    Vector3 p, v, cp, cv;
+    origin_pos.resize( departures ); origin_vel.resize( departures );
+    for ( size_t d = 0; d < departures; ++d ) {
+        ephemeris.state( origin, departure_time( d ), p, v );
+        ephemeris.state( central, departure_time( d ), cp, cv );
+        origin_pos[d] = p - cp;
+        origin_vel[d] = v - cv;
+    }
+    destination_pos.resize( arrivals ); destination_vel.resize( arrivals );
+    for ( size_t a = 0; a < arrivals; ++a ) {
+        ephemeris.state( destination, arrival_time( a ), p, v );
+        ephemeris.state( central, arrival_time( a ), cp, cv );
+        destination_pos[a] = p - cp;
+        destination_vel[a] = v - cv;
+    }
+
+    departure_dv.assign( departures * arrivals, std::numeric_limits< real_t >::quiet_NaN() );
+    arrival_dv.assign( departures * arrivals, std::numeric_limits< real_t >::quiet_NaN() );
+
+    size_t tile_rows = ( departures + tile - 1 ) / tile, tile_cols = ( arrivals + tile - 1 ) / tile;
+    size_t tiles = tile_rows * tile_cols;
+    size_t workers = std::min( num_workers(), tiles );
+    parallel_for( 0, workers, [&]( size_t w ) {
+        for ( size_t t = w; t < tiles; t += workers ) {
+            size_t d0 = t / tile_cols * tile, a0 = t % tile_cols * tile;
+            sweep_tile( d0, std::min( d0 + tile, departures ), a0, std::min( a0 + tile, arrivals ) );
+        }
+    } );
+}
+
+void Porkchop::sweep_tile( size_t d0, size_t d1, size_t a0, size_t a1 )
+{
+    Vector3 v1, v2;
+    for ( size_t d = d0; d < d1; ++d ) {
+        Vector3 normal = cross( origin_pos[d], origin_vel[d] );
+        for ( size_t a = a0; a < a1; ++a ) {
+            real_t tof = arrival_time( a ) - departure_time( d );
+            if ( tof <= 0 || !solve_lambert( origin_pos[d], destination_pos[a], tof, mu, normal, v1, v2 ) )
+                continue;
+            departure_dv[d * arrivals + a] = length( v1 - origin_vel[d] );
+            arrival_dv[d * arrivals + a] = length( v2 - destination_vel[a] );
+        }
+    }
+}
+
+bool Porkchop::best( size_t& d, size_t& a ) const
+{
+    bool found = false;
+    real_t least = 0;
+    for ( size_t i = 0; i < departures; ++i )
+        for ( size_t j = 0; j < arrivals; ++j ) {
+            real_t t = total( i, j );
+            if ( t == t && ( !found || t < least ) ) {
+                found = true;
+                least = t;
+                d = i;
+                a = j;
+            }
+        }
+    return found;
+}
+
+void Porkchop::write( std::ostream& out ) const
+{
+    for ( size_t d = 0; d < departures; ++d ) {
+        for ( size_t a = 0; a < arrivals; ++a )
+            out << departure_time( d ) << ' ' << arrival_time( a ) << ' '
+                << departure_excess( d, a ) << ' ' << arrival_excess( d, a ) << '\n';
+        out << '\n';
+    }
+}
+
+} // NEWTON
@@ -0,0 +1,90 @@
+#ifndef _LAMBERT_HPP_
+#define _LAMBERT_HPP_
+
+#include <iosfwd>
+#include <vector>
+
+#include "ephemeris.hpp"
+
+namespace NEWTON {
+
+/*
+Lambert's problem: the two-body orbit about a centre of gravitational
+parameter mu that goes from r1 to r2 in time tof, returned as the
+velocities at both ends. Zero revolutions only.
+
+Universal variables (Bate, Mueller & White 5.3; Curtis 5.3): the time of
+flight is a monotonic function of z = dE^2 (negative for hyperbolae),
+solved by Newton's method with a bisection bracket behind it, so every
+solvable case converges, typically in five to eight iterations from the
+parabolic guess. Of the two transfers the one that turns the same way as
+normal (short way if dot(r1 x r2, normal) > 0, else long way) is
+taken, so passing a planet's orbital angular momentum gives the
+prograde transfer.
+
+Returns false when r1 and r2 are collinear (the plane is undefined at
+180 degrees and there is no transfer at 0) or the iteration fails.
+*/
+bool solve_lambert( const Vector3& r1, const Vector3& r2, real_t tof, real_t mu, const Vector3& normal,
+                    Vector3& v1, Vector3& v2 );
+
+/*
+A porkchop plot: the cost of a transfer from origin to destination for
+every pair of departure and arrival times in a grid, with states from an
+ephemeris and the transfer orbit about central, whose gravitational
+parameter G m is mu.
+
+Each cell holds the hyperbolic excess speeds at both ends, |v1 - v_origin|
+and |v2 - v_destination|; add the escape and capture burns for a given
+parking orbit to get the delta-v of a real mission. Cells with arrival
+before departure, or with no solution, hold NaN.
+
+Planet states are looked up once per departure and arrival time, not per
+cell. The grid is cut into square tiles dealt round-robin to the
+workers, so the cheap empty corner where arrival precedes departure
+doesn't leave some threads idle while others finish.
+*/
+class Porkchop {
+public:
+    Porkchop( size_t origin, size_t destination, size_t central, real_t mu );
+
+    void set_departures( real_t start, real_t step, size_t count );
+    void set_arrivals( real_t start, real_t step, size_t count );
+    void set_tile_size( size_t size ) { tile = size > 0 ? size : 1; }
+
+    void sweep( const Ephemeris& ephemeris );
+
+    size_t num_departures() const { return departures; }
+    size_t num_arrivals() const { return arrivals; }
+    real_t departure_time( size_t d ) const { return departure_start + departure_step * real_t( d ); }
+    real_t arrival_time( size_t a ) const { return arrival_start + arrival_step * real_t( a ); }
+
+    real_t departure_excess( size_t d, size_t a ) const { return departure_dv[d * arrivals + a]; }
+    real_t arrival_excess( size_t d, size_t a ) const { return arrival_dv[d * arrivals + a]; }
+    real_t total( size_t d, size_t a ) const { return departure_excess( d, a ) + arrival_excess( d, a ); }
+
+    // The cell of least total; false if no cell has a transfer.
+    bool best( size_t& d, size_t& a ) const;
+
+    // One line per cell: departure time, arrival time, departure and
+    // arrival excess speeds, with a blank line between departures (the
+    // layout gnuplot's splot expects).
+    void write( std::ostream& out ) const;
+
+private:
+    void sweep_tile( size_t d0, size_t d1, size_t a0, size_t a1 );
+
+    size_t origin, destination, central;
+    real_t mu;
+    real_t departure_start, departure_step, arrival_start, arrival_step;
+    size_t departures, arrivals, tile;
+
+    // relative to central: per departure, the origin's state; per
+    // arrival, the destination's
+    std::vector< Vector3 > origin_pos, origin_vel, destination_pos, destination_vel;
+    std::vector< real_t > departure_dv, arrival_dv; // [d * arrivals + a]
+};
+
+} // NEWTON
+
+#endif
@@ -9,6 +9,8 @@
 #include "SDL_opengl.h"
 
 #include "game.hpp"
+#include "gl_ext.hpp"
+#include "depth_target.hpp"
 #include "vector.hpp"
 #include "math.hpp"
 
@@ -41,6 +43,8 @@ void perspectiveGL( GLdouble fovY, GLdouble aspect, GLdouble zNear, GLdouble zFa
     glFrustum( -fW, fW, -fH, fH, zNear, zFar );
 }
 
+ReversedZTarget depth_target;
+
 /* function to reset our viewport after a window resize */
 int Display_SetViewport( int width, int height )
 {
@@ -51,7 +55,10 @@ int Display_SetViewport( int width, int height )
     glViewport( 0, 0, ( GLsizei )width, ( GLsizei )height );
     glMatrixMode( GL_PROJECTION );
     glLoadIdentity( );
-    perspectiveGL( 45.0, ratio, 0.1, 50*8.16520800e11); // zfar = 50x jupiter orbital radius
+    if ( depth_target.is_active() )
+        reversed_z_perspective( 45.0, ratio, 0.1 ); // no far plane needed
+    else
+        perspectiveGL( 45.0, ratio, 0.1, 50*8.16520800e11); // zfar = 50x jupiter orbital radius
 
     // done setting up projection matrix. switch over to model view.
     glMatrixMode( GL_MODELVIEW );
@@ -137,7 +144,9 @@ void loop_update_func(Game & game, real_t dt) {
     SDL_PumpEvents();
     process_events(game);
     game.update(dt);
+    depth_target.begin_frame();
     game.render();
+    depth_target.end_frame();
     glFlush();
     SDL_GL_SwapWindow(displayWindow);
 }
@@ -169,6 +178,9 @@ void loop(Game & game) {
     displayWindow = SDL_CreateWindow("", 100, 100, width, height, flags);
     SDL_GL_CreateContext(displayWindow);   
     Display_InitGL();
+    load_gl_extensions();
+    if ( !depth_target.create(width, height) )
+        std::cout << "WARNING: reversed-Z depth unavailable, using standard depth buffer" << std::endl;
     Display_SetViewport(width, height);
 
     Uint32 startTime = SDL_GetTicks();
@@ -223,7 +235,8 @@ void loop(Game & game) {
 int main(int argc, char *argv[])
 {
     NEWTON::Game game;
-    game.initialize();
+    if(!game.initialize())
+        return 1;
     NEWTON::loop(game);
 
     getchar();
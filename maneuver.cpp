@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "maneuver.hpp"
+
+namespace NEWTON {
+
+const real_t STANDARD_GRAVITY = 9.80665;
+
+// Times this close are the same boundary: pieces of a split step don't
+// add up to the exact boundary times.
+static real_t slack( real_t t )
+{
+    return 64 * std::numeric_limits< real_t >::epsilon() * std::max( real_t( 1 ), std::fabs( t ) );
+}
+
+ManeuverEngine::ManeuverEngine() : next_id( 0 ), last_update( 0 )
+{
+}
+
+size_t ManeuverEngine::schedule( const Burn& burn )
+{
+    ScheduledBurn b;
+    b.burn = burn;
+    b.id = next_id++;
+    b.state = PENDING;
+    b.mass_flow = burn.isp > 0 ? burn.thrust / ( burn.isp * STANDARD_GRAVITY ) : 0;
+    burns.push_back( b );
+    return b.id;
+}
+
+void ManeuverEngine::cancel( size_t id, real_t time )
+{
+    for ( size_t i = 0; i < burns.size(); ++i ) {
+        ScheduledBurn& b = burns[i];
+        if ( b.id != id )
+            continue;
+        if ( b.state == PENDING && b.burn.start >= time )
+            b.state = DONE;
+        else
+            b.burn.duration = std::min( b.burn.duration, time - b.burn.start );
+    }
+}
+
+void ManeuverEngine::update( System& sys )
+{
+    std::vector< Body >& bodies = sys.bodies;
+    real_t t = sys.time, eps = slack( t );
+
+    // propellant burnt since the last update; the set of active burns
+    // hasn't changed in between
+    if ( flow.size() < bodies.size() )
+        flow.resize( bodies.size(), 0 );
+    for ( size_t k = 0; k < active.size(); ++k ) {
+        size_t v = burns[active[k]].burn.vessel;
+        if ( flow[v] > 0 ) {
+            bodies[v].mass = std::max( real_t( 0 ), bodies[v].mass - flow[v] * ( t - last_update ) );
+            flow[v] = 0;
+        }
+    }
+
+    // start and finish burns
+    bool changed = false;
+    active.clear();
+    size_t kept = 0;
+    for ( size_t i = 0; i < burns.size(); ++i ) {
+        ScheduledBurn& b = burns[i];
+        real_t end = b.burn.start + b.burn.duration;
+        if ( b.state == PENDING && b.burn.start <= t + eps ) {
+            b.state = ACTIVE;
+            changed = true;
+        }
+        if ( b.state == ACTIVE && end <= t + eps ) {
+            b.state = DONE;
+            changed = true;
+        }
+        if ( b.state == DONE )
+            continue;
+        burns[kept] = b;
+        if ( b.state == ACTIVE ) {
+            active.push_back( kept );
+            flow[b.burn.vessel] += b.mass_flow;
+        }
+        ++kept;
+    }
+    burns.resize( kept );
+    last_update = t;
+
+    // the thrust changed, though the state didn't
+    if ( changed )
+        sys.forces_changed();
+}
+
+void ManeuverEngine::accelerations( std::vector< Body >& bodies, real_t time )
+{
+    size_t n = active.size();
+    if ( n == 0 )
+        return;
+
+    // orbital frames of all active burns at once
+    rel_pos.resize( n ); rel_vel.resize( n );
+    prograde.resize( n ); normal.resize( n ); radial.resize( n );
+    for ( size_t k = 0; k < n; ++k ) {
+        const Burn& b = burns[active[k]].burn;
+        rel_pos.set( k, bodies[b.vessel].position - bodies[b.reference].position );
+        rel_vel.set( k, bodies[b.vessel].velocity - bodies[b.reference].velocity );
+    }
+    batch_normalize( rel_vel.span(), prograde.span() );
+    batch_cross( rel_pos.span(), rel_vel.span(), normal.span() );
+    batch_normalize( normal.span(), normal.span() );
+    batch_cross( prograde.span(), normal.span(), radial.span() );
+
+    for ( size_t k = 0; k < n; ++k ) {
+        const Burn& b = burns[active[k]].burn;
+        Body& vessel = bodies[b.vessel];
+        real_t m = vessel.mass - flow[b.vessel] * ( time - last_update );
+        if ( !( m > 0 ) )
+            continue;
+        Vector3 dir;
+        switch ( b.direction ) {
+        case Burn::PROGRADE:   dir = prograde.get( k ); break;
+        case Burn::RETROGRADE: dir = -prograde.get( k ); break;
+        case Burn::NORMAL:     dir = normal.get( k ); break;
+        case Burn::ANTINORMAL: dir = -normal.get( k ); break;
+        case Burn::RADIAL_OUT: dir = radial.get( k ); break;
+        default:               dir = -radial.get( k ); break;
+        }
+        // no frame without relative motion
+        if ( !( squared_length( dir ) > 0 ) )
+            continue;
+        vessel.acc_accumulator = madd( vessel.acc_accumulator, dir, b.thrust / m );
+    }
+}
+
+void ManeuverEngine::split( real_t t, real_t dt, std::vector< real_t >& pieces ) const
+{
+    real_t end = t + dt, eps = slack( end );
+    boundaries.clear();
+    for ( size_t i = 0; i < burns.size(); ++i ) {
+        const Burn& b = burns[i].burn;
+        real_t times[2] = { b.start, b.start + b.duration };
+        for ( int k = 0; k < 2; ++k )
+            if ( times[k] > t + eps && times[k] < end - eps )
+                boundaries.push_back( times[k] );
+    }
+    std::sort( boundaries.begin(), boundaries.end() );
+    boundaries.erase( std::unique( boundaries.begin(), boundaries.end() ), boundaries.end() );
+
+    pieces.clear();
+    real_t from = t;
+    for ( size_t i = 0; i < boundaries.size(); ++i ) {
+        pieces.push_back( boundaries[i] - from );
+        from = boundaries[i];
+    }
+    pieces.push_back( end - from );
+}
+
+void ManeuverEngine::advance( const Integrator& integrator, System& sys, real_t dt )
+{
+    std::vector< real_t > pieces;
+    update( sys );
+    split( sys.time, dt, pieces );
+    for ( size_t i = 0; i < pieces.size(); ++i ) {
+        integrator.integrate( sys, pieces[i] );
+        update( sys );
+    }
+}
+
+} // NEWTON
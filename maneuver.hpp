@@ -0,0 +1,116 @@
+#ifndef _MANEUVER_HPP_
+#define _MANEUVER_HPP_
+
+#include <vector>
+
+#include "batch.hpp"
+#include "integrator.hpp"
+#include "system.hpp"
+
+namespace NEWTON {
+
+// standard gravity, for converting specific impulse to exhaust velocity
+extern const real_t STANDARD_GRAVITY;
+
+// A burn of constant thrust along a direction of the vessel's orbit about
+// a reference body, fixed in that frame as the orbit turns.
+struct Burn
+{
+    enum Direction {
+        PROGRADE,    // along the velocity relative to the reference
+        RETROGRADE,
+        NORMAL,      // along r x v, out of the orbital plane
+        ANTINORMAL,
+        RADIAL_OUT,  // in the plane, perpendicular to the velocity, away from the reference
+        RADIAL_IN
+    };
+
+    size_t vessel;
+    size_t reference;
+    Direction direction;
+    real_t start;      // system time, s
+    real_t duration;   // s; infinity burns until cancelled
+    real_t thrust;     // N
+    real_t isp;        // specific impulse, s; 0 for no mass loss
+};
+
+/*
+Runs scheduled burns on any number of vessels.
+
+The engine is a ThrustModel: set System::thrust_model to it and every
+force evaluation adds, for each burn under way, thrust / m(t) along the
+burn's direction. Each burn burns propellant at thrust / (isp * g0), so
+m(t) falls linearly while the set of burns on a vessel is unchanged; the
+mass seen by each integrator stage is the mass at that stage's time, and
+update() writes it back to the body between steps. A vessel that runs
+out of mass stops thrusting.
+
+Directions are found for all active burns together: relative positions
+and velocities are gathered into SoA arrays and the frames built with
+the batch kernels (batch.hpp, AVX2 where available), then scaled and
+scattered back to the vessels.
+
+A burn switches on or off only between steps. split() cuts a step at
+every burn start and end inside it, so a burn acts over exactly its
+scheduled interval whatever the step size; advance() does the whole
+sequence for a plain integrator. update() marks the system's forces
+changed when a burn starts or ends (System::forces_changed), so
+integrators that carry the last step's derivative over don't start a
+piece with the old thrust.
+*/
+class ManeuverEngine : public ThrustModel {
+public:
+    ManeuverEngine();
+    virtual ~ManeuverEngine() { }
+
+    // Returns an id for cancel().
+    size_t schedule( const Burn& burn );
+    // Ends a burn at the given time, or drops it if it hasn't started.
+    void cancel( size_t id, real_t time );
+    void clear() { burns.clear(); }
+
+    size_t num_scheduled() const { return burns.size(); }
+    size_t num_active() const { return active.size(); }
+
+    virtual void accelerations( std::vector< Body >& bodies, real_t time );
+
+    // Lengths of the pieces of a step of dt from time t, cut at burn
+    // boundaries inside it; they add up to dt.
+    void split( real_t t, real_t dt, std::vector< real_t >& pieces ) const;
+
+    // Starts and finishes burns due by sys.time and updates the masses
+    // of vessels under thrust. Call before the first step and after each
+    // piece of a split step.
+    void update( System& sys );
+
+    // One step of dt, split at burn boundaries.
+    void advance( const Integrator& integrator, System& sys, real_t dt );
+
+private:
+    enum State { PENDING, ACTIVE, DONE };
+
+    struct ScheduledBurn
+    {
+        Burn burn;
+        size_t id;
+        State state;
+        real_t mass_flow; // kg/s
+    };
+
+    std::vector< ScheduledBurn > burns;
+    std::vector< size_t > active; // indices into burns
+    size_t next_id;
+
+    // time of the last update() and the total mass flow of each vessel
+    // since then, indexed by body
+    real_t last_update;
+    std::vector< real_t > flow;
+
+    // per active burn, gathered for the batch kernels
+    Vector3Array rel_pos, rel_vel, prograde, normal, radial;
+    mutable std::vector< real_t > boundaries;
+};
+
+} // NEWTON
+
+#endif
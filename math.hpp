@@ -6,7 +6,7 @@
 
 namespace NEWTON {
 
-typedef double real_t; // floating point precision set by this typedef
+typedef double real_t; // default precision; the physics core is also built for float and dd_real
 
 //class Color3;
 
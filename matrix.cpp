@@ -16,7 +16,7 @@ const Matrix3 Matrix3::Zero = Matrix3( 0, 0, 0,
 
 Matrix3::Matrix3( real_t r[SIZE] )
 {
-    memcpy( m, r, sizeof r );
+    memcpy( m, r, sizeof m );
 }
 
 Matrix3::Matrix3( real_t m00, real_t m10, real_t m20,
@@ -170,7 +170,7 @@ const Matrix4 Matrix4::Zero = Matrix4( 0, 0, 0, 0,
 
 Matrix4::Matrix4( real_t r[SIZE] )
 {
-    memcpy( m , r, sizeof r );
+    memcpy( m , r, sizeof m );
 }
 
 Matrix4::Matrix4( real_t m00, real_t m10, real_t m20, real_t m30,
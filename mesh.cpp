@@ -1,17 +1,38 @@
 #include "mesh.hpp"
+#include "icosphere.hpp"
 
 namespace NEWTON {
 
+// Returns the index of the vertex at the midpoint of edge (a,b), creating
+// it (and its normal) the first time the edge is seen. a must be less than b.
+size_t Mesh::midpoint(size_t a, size_t b, std::map<edge, size_t> & new_vertices) {
+	edge ab(a,b);
+	std::map<edge, size_t>::iterator it = new_vertices.find(ab);
+	if ( it != new_vertices.end() )
+		return it->second;
+
+	size_t d = vertices.size();
+	vertices.push_back((vertices[a] + vertices[b])/2);
+	normals.push_back(normalize(normals[a] + normals[b]));
+	new_vertices[ab] = d;
+	return d;
+}
+
 // NOTE: this subroutine creates new points on the midpoints
 // of edges, not according to the "loop subdivision" algorithm
 void Mesh::subdivide() {
 
 	std::map<edge, size_t > new_vertices; // TODO: can this be reused between subdivisions?
 
-	size_t n = triangles_vec.size();
-	size_t new_index = vertices_vec.size();
+	size_t n = triangles.size();
+
+	// a closed mesh has 3/2 edges per triangle, each of which gains a vertex
+	vertices.reserve(vertices.size() + 3*n/2);
+	normals.reserve(vertices.capacity());
+	triangles.reserve(4*n);
+
 	for(size_t i=0; i < n; i++) {
-		Triangle & t = triangles_vec[i];
+		Triangle & t = triangles[i];
 		size_t v0 = t.vertices[0];
 		size_t v1 = t.vertices[1];
 		size_t v2 = t.vertices[2];
@@ -21,139 +42,59 @@ void Mesh::subdivide() {
 		size_t c = (v0 > v1 && v0 > v2) ? v0 : (v1 > v0 && v1 > v2) ? v1 : v2;
 		size_t b = sum - a - c;
 
-		edge ab(a,b);
-		edge bc(b,c);
-		edge ac(a,c);
-
-		size_t d, e, f;
-
-		if ( new_vertices.find(ab) == new_vertices.end() ) {
-			Vector3 a_v = vertices_vec[a];
-			Vector3 b_v = vertices_vec[b];
-			vertices_vec.push_back((a_v + b_v)/2);
-			d = new_index++;
-			new_vertices[ab] = d;
-		}
-		else {
-			d = new_vertices[ab];
-		}
-
-		if ( new_vertices.find(bc) == new_vertices.end() ) {
-			Vector3 b_v = vertices_vec[b];
-			Vector3 c_v = vertices_vec[c];
-			vertices_vec.push_back((b_v + c_v)/2);
-			e = new_index++;
-			new_vertices[bc] = e;
-		}
-		else {
-			e = new_vertices[bc];
-		}
-
-		if ( new_vertices.find(ac) == new_vertices.end() ) {
-			Vector3 a_v = vertices_vec[a];
-			Vector3 c_v = vertices_vec[c];
-			vertices_vec.push_back((a_v + c_v)/2);
-			f = new_index++;
-			new_vertices[ac] = f;
-		}
-		else {
-			f = new_vertices[ac];
-		}
+		size_t d = midpoint(a, b, new_vertices);
+		size_t e = midpoint(b, c, new_vertices);
+		size_t f = midpoint(a, c, new_vertices);
 
 		// add new triangles
 		t.vertices[0] = d;
 		t.vertices[1] = e;
 		t.vertices[2] = f;
-		Triangle t0 = {a,d,f};
-		Triangle t1 = {b,d,e};
-		Triangle t2 = {e,f,c};
-		triangles_vec.push_back(t0);
-		triangles_vec.push_back(t1);
-		triangles_vec.push_back(t2);
+		Triangle t0 = {{(unsigned int) a, (unsigned int) d, (unsigned int) f}};
+		Triangle t1 = {{(unsigned int) b, (unsigned int) d, (unsigned int) e}};
+		Triangle t2 = {{(unsigned int) e, (unsigned int) f, (unsigned int) c}};
+		triangles.push_back(t0);
+		triangles.push_back(t1);
+		triangles.push_back(t2);
 	}
-	update_arrays();
 }
 
-void Mesh::update_arrays() {
-	num_vertices = vertices_vec.size();
-	num_triangles = triangles_vec.size();
-
-	if(vertices != 0) delete[] vertices;
-	if(triangles != 0) delete[] triangles;
-	if(normals != 0) delete[] normals;
+void Mesh::construct_sphere(real_t r, const IcosphereLevel & unit) {
 
-	vertices = new Vector3[num_vertices];
-	triangles = new Triangle[num_triangles];
-	normals = new Vector3[num_vertices];
+	// on a unit sphere the positions are the normals
+	normals.assign(unit.vertices, unit.vertices + unit.num_vertices);
+	triangles.assign(unit.triangles, unit.triangles + unit.num_triangles);
 
-	std::vector<Vector3>::iterator v;
-	size_t i = 0;
-	for(v = vertices_vec.begin(); v < vertices_vec.end(); v++) {
-		vertices[i] = *v;
-		i++;
-	}
-	std::vector<Triangle>::iterator t;
-	i=0;
-	for(t = triangles_vec.begin(); t < triangles_vec.end(); t++) {
-		triangles[i] = *t;
-		i++;
-	}
-}
-
-void Mesh::construct_sphere(real_t r) {
-
-	// equilateral triangle
-	vertices_vec.push_back(r * Vector3(1,1,0));
-	vertices_vec.push_back(r * Vector3(-1,1,0));
-	vertices_vec.push_back(r * Vector3(-1,-1,0));
-	vertices_vec.push_back(r * Vector3(1,-1,0));
-	vertices_vec.push_back(r * Vector3(0,0,1.414));
-	vertices_vec.push_back(r * Vector3(0,0,-1.414));
-	
-	// top pyramid
-	Triangle tri0 = {0,3,4};
-	Triangle tri1 = {0,1,4};
-	Triangle tri2 = {1,2,4};
-	Triangle tri3 = {2,3,4};
-
-	// bottom pyramid
-	Triangle tri4 = {0,3,5};
-	Triangle tri5 = {0,1,5};
-	Triangle tri6 = {1,2,5};
-	Triangle tri7 = {2,3,5};
-
-	triangles_vec.push_back(tri0);
-	triangles_vec.push_back(tri1);
-	triangles_vec.push_back(tri2);
-	triangles_vec.push_back(tri3);
-	triangles_vec.push_back(tri4);
-	triangles_vec.push_back(tri5);
-	triangles_vec.push_back(tri6);
-	triangles_vec.push_back(tri7);
-
-	update_arrays();
+	vertices.resize(unit.num_vertices);
+	for(size_t i=0; i < unit.num_vertices; i++)
+		vertices[i] = r * unit.vertices[i];
 }
 
 void Mesh::render() {
-	
-	for(size_t i = 0; i < num_triangles; i++) {
-		glBegin(GL_LINE_LOOP);
-		for(size_t v = 0; v < 3; v++) {
-			Vector3 vx = vertices[triangles[i].vertices[v]];
-			glVertex3d(vx.x, vx.y, vx.z);
-		}
-		glEnd();
-	}
+	if(triangles.empty())
+		return;
+
+	// draw straight out of the mesh storage; Vector3 and Triangle are
+	// tightly packed so no staging copy is needed
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_DOUBLE, sizeof(Vector3), &vertices[0]);
+	glNormalPointer(GL_DOUBLE, sizeof(Vector3), &normals[0]);
+
+	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	glDrawElements(GL_TRIANGLES, (GLsizei) (3*triangles.size()), GL_UNSIGNED_INT, &triangles[0]);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
 }
 
 void Mesh::make_spherical(real_t r) {
 
-	std::vector<Vector3>::iterator v;
-	for(v = vertices_vec.begin(); v != vertices_vec.end(); v++) {
-		*v = r * normalize(*v);
+	for(size_t i=0; i < vertices.size(); i++) {
+		normals[i] = normalize(vertices[i]);
+		vertices[i] = r * normals[i];
 	}
-
-	update_arrays();
 }
 
-} // NEWTON
\ No newline at end of file
+} // NEWTON
@@ -12,37 +12,42 @@
 
 namespace NEWTON {
 
-struct Triangle {
-    unsigned int vertices[3];
+struct Triangle {
+    unsigned int vertices[3];
 };
 
 typedef std::pair<size_t, size_t> edge;
 
+struct IcosphereLevel;
+
+/*
+The mesh owns a single copy of its vertices, per-vertex normals and
+triangles. The vectors are contiguous, so render() hands them straight
+to OpenGL as vertex arrays instead of copying them into separate
+buffers. Normals are kept in step with the vertices by each edit
+rather than recomputed from scratch.
+*/
 class Mesh {
 public:
-	Mesh() : vertices(0), triangles(0), normals(0)  {}
-
-	void construct_sphere(real_t r);
+	// Copies a unit icosphere, scaled to radius r.
+	void construct_sphere(real_t r, const IcosphereLevel & unit);
 
 	void subdivide();
 	void make_spherical(real_t r);
 	void render();
 
-private:
+	size_t num_vertices() const { return vertices.size(); }
+	size_t num_triangles() const { return triangles.size(); }
 
-	void update_arrays();
-
-	std::vector<Vector3> vertices_vec;
-	std::vector<Triangle> triangles_vec;
+private:
 
-	Vector3 * vertices;
-	size_t num_vertices;
-	Triangle * triangles;
-	size_t num_triangles;
-	Vector3 * normals;
+	size_t midpoint(size_t a, size_t b, std::map<edge, size_t> & new_vertices);
 
+	std::vector<Vector3> vertices;
+	std::vector<Vector3> normals; // parallel to vertices
+	std::vector<Triangle> triangles;
 };
 
 } // NEWTON
 
-#endif
\ No newline at end of file
+#endif
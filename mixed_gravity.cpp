@@ -0,0 +1,123 @@
+#include <cassert>
+
+#include "mixed_gravity.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+namespace NEWTON {
+
+const double MixedPrecisionGravity::pair_error_bound = 20.0 / ( 1 << 24 );
+
+// targets per thread; below this a call runs on one thread
+static const size_t MIN_TARGETS_PER_THREAD = 64;
+
+// Offsets are measured in units of 2^32 m (about 0.03 AU) while in float,
+// which puts 1/r^3 and the pair terms of solar system bodies in the
+// middle of the float range instead of down among the subnormals. The
+// result then carries a factor of 2^64. Both scalings are exact.
+static const double LENGTH_SCALE = 1.0 / 4294967296.0;
+static const double RESULT_SCALE = LENGTH_SCALE * LENGTH_SCALE;
+
+static Vector<3, double> scalar_acceleration( const double* x, const double* y, const double* z,
+                                              const float* gm, size_t n, const Vector<3, double>& p )
+{
+    Vector<3, double> acc = Vector<3, double>::Zero;
+    for ( size_t j = 0; j < n; ++j ) {
+        float dx = float( ( x[j] - p.x ) * LENGTH_SCALE );
+        float dy = float( ( y[j] - p.y ) * LENGTH_SCALE );
+        float dz = float( ( z[j] - p.z ) * LENGTH_SCALE );
+        float r2 = dx * dx + dy * dy + dz * dz;
+        if ( r2 <= 0.0f )
+            continue;
+        float inv = 1.0f / std::sqrt( r2 );
+        float f = gm[j] * inv * inv * inv;
+        acc.x += double( dx * f );
+        acc.y += double( dy * f );
+        acc.z += double( dz * f );
+    }
+    return acc * RESULT_SCALE;
+}
+
+#if SIMD_HAVE_AVX2
+
+// eight scaled double offsets (two registers) rounded to one register
+// of floats
+SIMD_AVX2 static inline __m256 offset8( const double* src, __m256d p, __m256d scale )
+{
+    __m128 lo = _mm256_cvtpd_ps( _mm256_mul_pd( _mm256_sub_pd( _mm256_loadu_pd( src ), p ), scale ) );
+    __m128 hi = _mm256_cvtpd_ps( _mm256_mul_pd( _mm256_sub_pd( _mm256_loadu_pd( src + 4 ), p ), scale ) );
+    return _mm256_insertf128_ps( _mm256_castps128_ps256( lo ), hi, 1 );
+}
+
+// adds the eight float terms of v to the four double lanes of acc
+SIMD_AVX2 static inline __m256d widen_add( __m256d acc, __m256 v )
+{
+    acc = _mm256_add_pd( acc, _mm256_cvtps_pd( _mm256_castps256_ps128( v ) ) );
+    return _mm256_add_pd( acc, _mm256_cvtps_pd( _mm256_extractf128_ps( v, 1 ) ) );
+}
+
+// n must be a multiple of eight
+SIMD_AVX2 static Vector<3, double> avx2_acceleration( const double* x, const double* y, const double* z,
+                                                      const float* gm, size_t n, const Vector<3, double>& p )
+{
+    const __m256d px = _mm256_set1_pd( p.x ), py = _mm256_set1_pd( p.y ), pz = _mm256_set1_pd( p.z );
+    const __m256d scale = _mm256_set1_pd( LENGTH_SCALE );
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps( 1.0f );
+    __m256d ax = _mm256_setzero_pd(), ay = _mm256_setzero_pd(), az = _mm256_setzero_pd();
+
+    for ( size_t j = 0; j < n; j += 8 ) {
+        __m256 dx = offset8( x + j, px, scale );
+        __m256 dy = offset8( y + j, py, scale );
+        __m256 dz = offset8( z + j, pz, scale );
+        __m256 r2 = _mm256_fmadd_ps( dx, dx, _mm256_fmadd_ps( dy, dy, _mm256_mul_ps( dz, dz ) ) );
+        __m256 inv = _mm256_div_ps( one, _mm256_sqrt_ps( r2 ) );
+        __m256 f = _mm256_mul_ps( _mm256_mul_ps( _mm256_mul_ps( _mm256_loadu_ps( gm + j ), inv ), inv ), inv );
+        // r = 0 gives inf or nan above; drop those lanes
+        f = _mm256_and_ps( f, _mm256_cmp_ps( r2, zero, _CMP_GT_OQ ) );
+        ax = widen_add( ax, _mm256_mul_ps( dx, f ) );
+        ay = widen_add( ay, _mm256_mul_ps( dy, f ) );
+        az = widen_add( az, _mm256_mul_ps( dz, f ) );
+    }
+    return Vector<3, double>( hsum( ax ), hsum( ay ), hsum( az ) ) * RESULT_SCALE;
+}
+
+#endif /* SIMD_HAVE_AVX2 */
+
+void MixedPrecisionGravity::accelerations( std::vector< BasicBody< double > >& bodies, SofteningKernel kernel )
+{
+    assert( kernel == SOFTENING_NONE );
+    (void) kernel;
+    size_t n = bodies.size();
+    size_t padded = ( n + 7 ) / 8 * 8;
+    x.assign( padded, 0.0 );
+    y.assign( padded, 0.0 );
+    z.assign( padded, 0.0 );
+    gm.assign( padded, 0.0f );
+    for ( size_t j = 0; j < n; ++j ) {
+        const BasicBody< double >& b = bodies[j];
+        x[j] = b.position.x;
+        y[j] = b.position.y;
+        z[j] = b.position.z;
+        gm[j] = b.exerts_grav ? float( G * b.mass ) : 0.0f;
+    }
+
+    const double* px = x.data();
+    const double* py = y.data();
+    const double* pz = z.data();
+    const float* pgm = gm.data();
+#if SIMD_HAVE_AVX2
+    bool avx2 = use_avx2();
+#endif
+    parallel_for( 0, n, [&]( size_t i ) {
+        const Vector<3, double>& p = bodies[i].position;
+#if SIMD_HAVE_AVX2
+        if ( avx2 ) {
+            bodies[i].acc_accumulator = avx2_acceleration( px, py, pz, pgm, padded, p );
+            return;
+        }
+#endif
+        bodies[i].acc_accumulator = scalar_acceleration( px, py, pz, pgm, padded, p );
+    }, MIN_TARGETS_PER_THREAD );
+}
+
+} // NEWTON
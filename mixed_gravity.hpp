@@ -0,0 +1,62 @@
+#ifndef _MIXED_GRAVITY_HPP_
+#define _MIXED_GRAVITY_HPP_
+
+#include <vector>
+
+#include "system.hpp"
+
+namespace NEWTON {
+
+/*
+Direct summation with the pair interaction done in single precision.
+
+For each target i, every source offset d = x_j - x_i is formed in
+double, so it is exact to double precision however far both bodies are
+from the origin. The offset is then rounded to float, and the
+distance, 1/r^3 and the pair term d * G m_j / r^3 are computed in float,
+eight pairs per AVX2 instruction. Each pair term is widened back to
+double before it is added to the target's acceleration.
+
+Error bound. With u = 2^-24 (float unit roundoff), the float pair term
+differs from the exact one by at most
+
+    |a~_ij - a_ij| <= 20 u |a_ij|
+
+to first order in u. Rounding the offset costs u per component,
+which enters r^2 squared (2 u), and forming r^2 adds three more
+roundings; the square root halves that and it and the reciprocal add
+one each, so 1/r is within 4.5 u and 1/r^3 within 13.5 u. G m_j and
+the three products add 4 u, and the offset and the final product 2 u.
+The sum is in double, adding at most (N - 1) 2^-53 relative to
+sum_j |a_ij|, so for the whole acceleration
+
+    |a~_i - a_i| <= ( 20 u + (N - 1) 2^-53 ) sum_j |a_ij|
+                 ~= 1.2e-6 sum_j |a_ij|
+
+relative to the double path in System::direct_gravity, which itself has
+error ~ N 2^-53. When one source dominates (the usual case: a planet
+and its sun) this is a relative error of about 1e-6 in the
+acceleration. bench/gravity_bench.cpp checks the bound.
+
+Limits. While in float, lengths are in units of 2^32 m, so offsets
+must stay below ~1e28 m, and pair terms below ~1e-57 m/s^2 lose bits
+to underflow (neither happens in practice). Coincident bodies (r = 0)
+contribute nothing. Bodies are points: no softening kernel.
+*/
+class MixedPrecisionGravity : public BasicGravitySolver< double > {
+public:
+    virtual ~MixedPrecisionGravity() { }
+    virtual void accelerations( std::vector< BasicBody< double > >& bodies, SofteningKernel kernel );
+
+    // The 20 u above.
+    static const double pair_error_bound;
+
+private:
+    // sources, padded to a multiple of eight with massless entries
+    std::vector< double > x, y, z;
+    std::vector< float > gm;
+};
+
+} // NEWTON
+
+#endif
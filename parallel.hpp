@@ -0,0 +1,64 @@
+#ifndef _PARALLEL_HPP_
+#define _PARALLEL_HPP_
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace NEWTON {
+
+// Number of worker threads used by parallel_for. Falls back to 1 when the
+// platform can't report its core count. Queried once: glibc reads sysfs
+// for it, which costs microseconds a call.
+inline size_t num_workers() {
+    static const size_t n = std::max< size_t >( 1, std::thread::hardware_concurrency() );
+    return n;
+}
+
+// Calls fn(i) for every i in [begin, end), splitting the range into one
+// contiguous chunk per worker. fn must be safe to call concurrently for
+// distinct i. Ranges shorter than two chunks run on the calling thread.
+//
+// There is no pool: each call starts and joins its own threads, about
+// 20 us per thread on Linux, so only hand it loops well above that, and
+// keep the small cases on the plain loop.
+template<typename F>
+void parallel_for( size_t begin, size_t end, F fn, size_t min_chunk = 1 )
+{
+    if ( end <= begin )
+        return;
+    size_t count = end - begin;
+    if ( count < 2 * min_chunk ) {
+        for ( size_t i = begin; i < end; ++i )
+            fn( i );
+        return;
+    }
+    size_t workers = std::min( num_workers(), ( count + min_chunk - 1 ) / min_chunk );
+    if ( workers <= 1 ) {
+        for ( size_t i = begin; i < end; ++i )
+            fn( i );
+        return;
+    }
+
+    size_t chunk = ( count + workers - 1 ) / workers;
+    std::vector< std::thread > threads;
+    threads.reserve( workers - 1 );
+    for ( size_t w = 1; w < workers; ++w ) {
+        size_t lo = begin + w * chunk;
+        size_t hi = std::min( end, lo + chunk );
+        if ( lo >= hi )
+            break;
+        threads.push_back( std::thread( [lo, hi, &fn]() {
+            for ( size_t i = lo; i < hi; ++i )
+                fn( i );
+        } ) );
+    }
+    for ( size_t i = begin; i < std::min( end, begin + chunk ); ++i )
+        fn( i );
+    for ( size_t t = 0; t < threads.size(); ++t )
+        threads[t].join();
+}
+
+} /* NEWTON */
+
+#endif /* _PARALLEL_HPP_ */
@@ -0,0 +1,152 @@
+#include "particle_renderer.hpp"
+#include "batch.hpp"
+#include "parallel.hpp"
+
+namespace NEWTON {
+
+// how many particles a worker converts at a time
+static const size_t STREAM_CHUNK = 1 << 16;
+
+ParticleRenderer::ParticleRenderer()
+    : point_size( 3.0f ),
+      attenuation_distance( 1e12f ),
+      min_point_size( 1.0f ),
+      max_point_size( 16.0f ),
+      fade_threshold( 2.0f ),
+      buffer( 0 ),
+      mapped( 0 ),
+      capacity( 0 ),
+      region( 0 ),
+      count( 0 )
+{
+    for ( size_t i = 0; i < NUM_REGIONS; ++i )
+        fences[i] = 0;
+}
+
+ParticleRenderer::~ParticleRenderer()
+{
+    // GL objects need a current context and are released by destroy()
+}
+
+void ParticleRenderer::destroy()
+{
+    if ( !gl_ext.loaded )
+        return;
+    for ( size_t i = 0; i < NUM_REGIONS; ++i ) {
+        if ( fences[i] )
+            gl_ext.DeleteSync( fences[i] );
+        fences[i] = 0;
+    }
+    if ( buffer ) {
+        if ( mapped ) {
+            gl_ext.BindBuffer( GL_ARRAY_BUFFER, buffer );
+            gl_ext.UnmapBuffer( GL_ARRAY_BUFFER );
+            gl_ext.BindBuffer( GL_ARRAY_BUFFER, 0 );
+        }
+        gl_ext.DeleteBuffers( 1, &buffer );
+    }
+    buffer = 0;
+    mapped = 0;
+    capacity = 0;
+    staging.clear();
+}
+
+void ParticleRenderer::reserve( size_t n )
+{
+    if ( n <= capacity )
+        return;
+
+    // grow geometrically so a slowly growing scene doesn't remap every frame
+    size_t new_capacity = std::max( n, capacity + capacity / 2 );
+    destroy();
+    capacity = new_capacity;
+
+    if ( gl_ext.has_persistent ) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLsizeiptr bytes = GLsizeiptr( NUM_REGIONS * capacity * 3 * sizeof( float ) );
+        gl_ext.GenBuffers( 1, &buffer );
+        gl_ext.BindBuffer( GL_ARRAY_BUFFER, buffer );
+        gl_ext.BufferStorage( GL_ARRAY_BUFFER, bytes, 0, flags );
+        mapped = (float*) gl_ext.MapBufferRange( GL_ARRAY_BUFFER, 0, bytes, flags );
+        gl_ext.BindBuffer( GL_ARRAY_BUFFER, 0 );
+        if ( mapped )
+            return;
+        gl_ext.DeleteBuffers( 1, &buffer );
+        buffer = 0;
+    }
+    staging.resize( capacity * 3 );
+}
+
+// Returns the next region to write, waiting for the GPU to finish with it.
+float* ParticleRenderer::begin_region()
+{
+    if ( !mapped )
+        return &staging[0];
+
+    region = ( region + 1 ) % NUM_REGIONS;
+    if ( fences[region] ) {
+        while ( gl_ext.ClientWaitSync( fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 ) == GL_TIMEOUT_EXPIRED )
+            ;
+        gl_ext.DeleteSync( fences[region] );
+        fences[region] = 0;
+    }
+    return mapped + region * capacity * 3;
+}
+
+void ParticleRenderer::stream( const Vector3* first, size_t stride, size_t n, const Vector3& origin )
+{
+    load_gl_extensions();
+    count = n;
+    if ( n == 0 )
+        return;
+    reserve( n );
+
+    float* out = begin_region();
+    ConstVector3Span positions = aos_span( first, stride, n );
+    size_t num_chunks = ( n + STREAM_CHUNK - 1 ) / STREAM_CHUNK;
+    parallel_for( 0, num_chunks, [&]( size_t c ) {
+        size_t begin = c * STREAM_CHUNK;
+        size_t end = std::min( n, begin + STREAM_CHUNK );
+        batch_relative_to_float( subspan( positions, begin, end - begin ), origin, out + 3 * begin );
+    } );
+}
+
+void ParticleRenderer::render()
+{
+    if ( count == 0 )
+        return;
+
+    glPushAttrib( GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_POINT_BIT );
+    glEnable( GL_BLEND );
+    glBlendFunc( GL_SRC_ALPHA, GL_ONE );
+    glDepthMask( GL_FALSE );
+    glEnable( GL_POINT_SMOOTH );
+    glPointSize( point_size );
+    if ( gl_ext.has_point_params ) {
+        // size = point_size / sqrt( c * d^2 ), i.e. point_size at attenuation_distance
+        float d = attenuation_distance;
+        GLfloat coefficients[3] = { 0.0f, 0.0f, 1.0f / ( d * d ) };
+        gl_ext.PointParameterfv( GL_POINT_DISTANCE_ATTENUATION, coefficients );
+        gl_ext.PointParameterf( GL_POINT_SIZE_MIN, min_point_size );
+        gl_ext.PointParameterf( GL_POINT_SIZE_MAX, max_point_size );
+        gl_ext.PointParameterf( GL_POINT_FADE_THRESHOLD_SIZE, fade_threshold );
+    }
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+    if ( mapped ) {
+        gl_ext.BindBuffer( GL_ARRAY_BUFFER, buffer );
+        glVertexPointer( 3, GL_FLOAT, 0, (const GLvoid*)( region * capacity * 3 * sizeof( float ) ) );
+    } else {
+        glVertexPointer( 3, GL_FLOAT, 0, &staging[0] );
+    }
+    glDrawArrays( GL_POINTS, 0, GLsizei( count ) );
+    glDisableClientState( GL_VERTEX_ARRAY );
+
+    if ( mapped ) {
+        gl_ext.BindBuffer( GL_ARRAY_BUFFER, 0 );
+        fences[region] = gl_ext.FenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+    }
+    glPopAttrib();
+}
+
+} /* NEWTON */
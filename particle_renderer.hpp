@@ -0,0 +1,68 @@
+#ifndef _PARTICLE_RENDERER_HPP_
+#define _PARTICLE_RENDERER_HPP_
+
+#include <vector>
+
+#include "gl_ext.hpp"
+#include "vector.hpp"
+
+namespace NEWTON {
+
+/*
+Draws every body as a single point sprite from one vertex buffer.
+
+Each frame stream() converts the double-precision positions to float
+relative to a chosen origin (normally whatever the camera is looking
+at) and writes them into a persistently mapped buffer, which render()
+draws with one glDrawArrays call. The buffer is split into several
+regions guarded by fences so the CPU never writes a region the GPU is
+still reading. Without GL 4.4 the same floats are drawn from client
+memory instead.
+
+Points shrink with distance through the fixed-function point distance
+attenuation, and once they fall below the fade threshold their alpha
+(and so, with additive blending, their brightness) fades as well.
+*/
+class ParticleRenderer {
+public:
+    ParticleRenderer();
+    ~ParticleRenderer();
+
+    // Converts count positions, each stride bytes after the previous one,
+    // to floats relative to origin. Must be called with a current context.
+    void stream( const Vector3* first, size_t stride, size_t count, const Vector3& origin );
+
+    // Draws the positions from the last stream() call in a frame whose
+    // origin is the origin passed to stream().
+    void render();
+
+    // Releases GL resources. Must be called with a current context.
+    void destroy();
+
+    float point_size;           // size in pixels at attenuation_distance
+    float attenuation_distance; // distance at which points are point_size wide
+    float min_point_size;
+    float max_point_size;
+    float fade_threshold;       // points smaller than this fade instead of shrinking
+
+private:
+    ParticleRenderer( const ParticleRenderer& );
+    ParticleRenderer& operator=( const ParticleRenderer& );
+
+    void reserve( size_t count );
+    float* begin_region();
+
+    static const size_t NUM_REGIONS = 3;
+
+    GLuint buffer;
+    float* mapped;              // persistent mapping of all regions, if any
+    GLsync fences[NUM_REGIONS];
+    size_t capacity;            // particles per region
+    size_t region;
+    size_t count;
+    std::vector<float> staging; // used when persistent mapping is unavailable
+};
+
+} /* NEWTON */
+
+#endif /* _PARTICLE_RENDERER_HPP_ */
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "parallel.hpp"
+#include "patched_conic.hpp"
+#include "root_finding.hpp"
+
+namespace NEWTON {
+
+static const real_t DEFAULT_TIME_TOLERANCE = 1; // s
+static const size_t VESSEL_CHUNK = 1024;        // vessels per parallel work item
+static const int MAX_TRANSITIONS_PER_STEP = 8;
+
+const size_t PatchedConics::NO_BODY;
+
+PatchedConics::PatchedConics()
+    : root( NO_BODY ), t0( 0 ), t1( 0 ), tolerance( DEFAULT_TIME_TOLERANCE )
+{
+}
+
+void PatchedConics::set_bodies( const System& sys )
+{
+    size_t n = sys.bodies.size();
+    parent.assign( n, NO_BODY );
+    children.assign( n, std::vector< size_t >() );
+    soi.assign( n, 0 );
+    mass.resize( n );
+    pos0.resize( n ); vel0.resize( n ); pos1.resize( n ); vel1.resize( n );
+    std::vector< size_t > massive;
+    for ( size_t i = 0; i < n; ++i ) {
+        mass[i] = sys.bodies[i].mass;
+        pos0[i] = pos1[i] = sys.bodies[i].position;
+        vel0[i] = vel1[i] = sys.bodies[i].velocity;
+        if ( sys.bodies[i].exerts_grav && sys.bodies[i].mass > 0 )
+            massive.push_back( i );
+    }
+    t0 = t1 = sys.time;
+    root = NO_BODY;
+    if ( massive.empty() )
+        return;
+
+    // heaviest first, so every body's parent is placed before it
+    std::stable_sort( massive.begin(), massive.end(), [&]( size_t a, size_t b ) { return mass[a] > mass[b]; } );
+    root = massive[0];
+    soi[root] = std::numeric_limits< real_t >::infinity();
+    for ( size_t k = 1; k < massive.size(); ++k ) {
+        size_t b = massive[k];
+        size_t p = find_dominant( sys, sys.bodies[b].position );
+        parent[b] = p;
+        children[p].push_back( b );
+        OrbitalElements el = osculating_elements( sys, b, p );
+        real_t a = el.semi_major_axis > 0 ? el.semi_major_axis : length( sys.bodies[b].position - sys.bodies[p].position );
+        soi[b] = a * std::pow( mass[b] / mass[p], real_t( 0.4 ) );
+    }
+
+    for ( size_t i = 0; i < dominant.size(); ++i ) {
+        size_t d = find_dominant( sys, position.get( i ) );
+        dominant[i] = d;
+        orbits.set( i, elements_from_state( position.get( i ) - pos1[d], velocity.get( i ) - vel1[d], G * mass[d], t1 ) );
+    }
+}
+
+size_t PatchedConics::find_dominant( const System& sys, const Vector3& pos ) const
+{
+    size_t d = root;
+    for ( bool deeper = true; deeper; ) {
+        deeper = false;
+        for ( size_t k = 0; k < children[d].size(); ++k ) {
+            size_t c = children[d][k];
+            if ( length( pos - sys.bodies[c].position ) < soi[c] ) {
+                d = c;
+                deeper = true;
+                break;
+            }
+        }
+    }
+    return d;
+}
+
+size_t PatchedConics::add_vessel( const System& sys, const Vector3& pos, const Vector3& vel )
+{
+    assert( root != NO_BODY );
+    size_t d = find_dominant( sys, pos );
+    const Body& b = sys.bodies[d];
+    size_t i = dominant.size();
+    dominant.push_back( d );
+    orbits.add( elements_from_state( pos - b.position, vel - b.velocity, G * mass[d], sys.time ) );
+    rel_pos.resize( i + 1 ); rel_vel.resize( i + 1 );
+    position.resize( i + 1 ); velocity.resize( i + 1 );
+    rel_pos.set( i, pos - b.position );
+    rel_vel.set( i, vel - b.velocity );
+    position.set( i, pos );
+    velocity.set( i, vel );
+    flagged.push_back( 0 );
+    return i;
+}
+
+void PatchedConics::clear_vessels()
+{
+    dominant.clear();
+    orbits.clear();
+    rel_pos.resize( 0 ); rel_vel.resize( 0 );
+    position.resize( 0 ); velocity.resize( 0 );
+    flagged.clear();
+}
+
+void PatchedConics::body_state( size_t body, real_t t, Vector3& pos, Vector3& vel ) const
+{
+    real_t h = t1 - t0;
+    if ( t >= t1 || h <= 0 ) {
+        pos = pos1[body];
+        vel = vel1[body];
+        return;
+    }
+    real_t s = ( t - t0 ) / h;
+    real_t s2 = s * s, s3 = s2 * s;
+    pos = pos0[body] * ( 2 * s3 - 3 * s2 + 1 ) + vel0[body] * ( ( s3 - 2 * s2 + s ) * h )
+        + pos1[body] * ( 3 * s2 - 2 * s3 ) + vel1[body] * ( ( s3 - s2 ) * h );
+    real_t d00 = ( 6 * s2 - 6 * s ) / h;
+    vel = pos0[body] * d00 + vel0[body] * ( 3 * s2 - 4 * s + 1 ) - pos1[body] * d00 + vel1[body] * ( 3 * s2 - 2 * s );
+}
+
+size_t PatchedConics::check( size_t vessel, real_t t, const Vector3& rel ) const
+{
+    size_t d = dominant[vessel];
+    if ( parent[d] != NO_BODY && dot( rel, rel ) > soi[d] * soi[d] )
+        return parent[d];
+    Vector3 p, v;
+    body_state( d, t, p, v );
+    Vector3 pos = rel + p;
+    for ( size_t k = 0; k < children[d].size(); ++k ) {
+        size_t c = children[d][k];
+        body_state( c, t, p, v );
+        Vector3 r = pos - p;
+        if ( dot( r, r ) < soi[c] * soi[c] )
+            return c;
+    }
+    return d;
+}
+
+// Distance of the vessel, on its current conic, from body at time t,
+// less the body's SOI radius.
+real_t PatchedConics::soi_distance( size_t vessel, size_t body, real_t t ) const
+{
+    Vector3 r, v, dp, dv, bp, bv;
+    orbits.state( vessel, t, r, v );
+    body_state( dominant[vessel], t, dp, dv );
+    body_state( body, t, bp, bv );
+    return length( r + dp - bp ) - soi[body];
+}
+
+// Illinois (root_finding.hpp). inside is the side the vessel ends up
+// on at b; the end of the final bracket on that side is returned, so
+// the vessel is just across the boundary when it is transferred.
+real_t PatchedConics::crossing( size_t vessel, size_t body, bool inside, real_t a, real_t b ) const
+{
+    real_t ga = soi_distance( vessel, body, a ), gb = soi_distance( vessel, body, b );
+    if ( ( ga < 0 ) == ( gb < 0 ) )
+        return b; // crossed and back within the step, or was never across
+    illinois( [&]( real_t t ) { return soi_distance( vessel, body, t ); }, a, ga, b, gb, tolerance );
+    return ( gb < 0 ) == inside ? b : a;
+}
+
+void PatchedConics::transfer( size_t vessel, size_t to, real_t t )
+{
+    Vector3 r, v, dp, dv, bp, bv;
+    orbits.state( vessel, t, r, v );
+    body_state( dominant[vessel], t, dp, dv );
+    body_state( to, t, bp, bv );
+    orbits.set( vessel, elements_from_state( r + dp - bp, v + dv - bv, G * mass[to], t ) );
+    dominant[vessel] = to;
+}
+
+void PatchedConics::begin_step( const System& sys )
+{
+    for ( size_t i = 0; i < pos0.size(); ++i ) {
+        pos0[i] = sys.bodies[i].position;
+        vel0[i] = sys.bodies[i].velocity;
+    }
+    t0 = sys.time;
+}
+
+void PatchedConics::end_step( const System& sys, std::vector< SoiTransition >* out )
+{
+    for ( size_t i = 0; i < pos1.size(); ++i ) {
+        pos1[i] = sys.bodies[i].position;
+        vel1[i] = sys.bodies[i].velocity;
+    }
+    t1 = sys.time;
+
+    size_t n = num_vessels();
+    if ( n == 0 )
+        return;
+    Vector3Span rp = rel_pos.span(), rv = rel_vel.span();
+    parallel_for( 0, ( n + VESSEL_CHUNK - 1 ) / VESSEL_CHUNK, [&]( size_t c ) {
+        size_t begin = c * VESSEL_CHUNK, end = std::min( n, begin + VESSEL_CHUNK );
+        orbits.propagate( t1, begin, end, rp, rv );
+        for ( size_t i = begin; i < end; ++i ) {
+            Vector3 r = rel_pos.get( i );
+            flagged[i] = check( i, t1, r ) != dominant[i];
+            size_t d = dominant[i];
+            position.set( i, r + pos1[d] );
+            velocity.set( i, rel_vel.get( i ) + vel1[d] );
+        }
+    } );
+
+    // the few that changed SOI, one at a time
+    for ( size_t i = 0; i < n; ++i ) {
+        if ( !flagged[i] )
+            continue;
+        real_t start = t0;
+        for ( int k = 0; k < MAX_TRANSITIONS_PER_STEP; ++k ) {
+            size_t d = dominant[i];
+            size_t to = check( i, t1, rel_pos.get( i ) );
+            if ( to == d )
+                break;
+            real_t t = to == parent[d] ? crossing( i, d, false, start, t1 ) : crossing( i, to, true, start, t1 );
+            transfer( i, to, t );
+            if ( out ) {
+                SoiTransition tr = { i, d, to, t };
+                out->push_back( tr );
+            }
+            Vector3 r, v;
+            orbits.state( i, t1, r, v );
+            rel_pos.set( i, r );
+            rel_vel.set( i, v );
+            start = t;
+        }
+        size_t d = dominant[i];
+        position.set( i, rel_pos.get( i ) + pos1[d] );
+        velocity.set( i, rel_vel.get( i ) + vel1[d] );
+    }
+}
+
+} // NEWTON
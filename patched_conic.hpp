@@ -0,0 +1,116 @@
+#ifndef _PATCHED_CONIC_HPP_
+#define _PATCHED_CONIC_HPP_
+
+#include <vector>
+
+#include "batch.hpp"
+#include "kepler.hpp"
+#include "system.hpp"
+
+namespace NEWTON {
+
+struct SoiTransition
+{
+    size_t vessel;
+    size_t from, to; // dominant bodies before and after
+    real_t time;
+};
+
+/*
+Patched conics: vessels that follow two-body orbits about whichever
+body dominates them, next to the full N-body System that moves the
+bodies themselves.
+
+The massive bodies (exerts_grav, mass > 0) of the System form a tree by
+sphere of influence: the heaviest is the root, with an unbounded SOI,
+and every other body belongs to the smallest SOI it lies in, with
+
+    r_soi = a ( m / M )^(2/5)
+
+for its semi-major axis a about its parent of mass M. Only those bodies
+are integrated, by the caller, in the System as usual. A vessel never
+is: it keeps the elements of its orbit about its dominant body and is
+placed in closed form, so a step costs the same for any step size, and
+vessels neither pull on anything nor on each other.
+
+Steps follow CollisionDetector's pattern: begin_step() before stepping
+the System, end_step() after. end_step() propagates every vessel to the
+new time in parallel, in batches through KeplerOrbits (AVX2 Kepler
+solves), and checks each against the SOI of its dominant body and those
+of that body's children. A vessel found outside its SOI or inside a
+child's has the crossing time located by regula falsi (Illinois) on the
+distance along its conic, with the bodies between the step's ends taken
+from a cubic Hermite fit of their states at both; its orbit is then
+re-expressed about the new body at that time, and it carries on to the
+end of the step. Like EventLocator, a vessel that enters and leaves a
+SOI within one step is missed, so steps should be short next to the
+fastest SOI passage.
+*/
+class PatchedConics {
+public:
+    static const size_t NO_BODY = size_t( -1 );
+
+    PatchedConics();
+
+    // Builds the SOI tree from the massive bodies of sys and their
+    // current orbits. Vessels added before are re-fitted.
+    void set_bodies( const System& sys );
+
+    // A vessel at the given absolute state, at sys.time, about the
+    // deepest SOI holding it. Returns its index.
+    size_t add_vessel( const System& sys, const Vector3& position, const Vector3& velocity );
+    void clear_vessels();
+
+    size_t num_vessels() const { return dominant.size(); }
+    size_t get_dominant( size_t vessel ) const { return dominant[vessel]; }
+    const OrbitalElements& get_elements( size_t vessel ) const { return orbits.get( vessel ); }
+    // Absolute state at the end of the last step.
+    Vector3 get_position( size_t vessel ) const { return position.get( vessel ); }
+    Vector3 get_velocity( size_t vessel ) const { return velocity.get( vessel ); }
+    // All vessels' absolute positions, e.g. for rendering.
+    ConstVector3Span positions() const { return position.span(); }
+
+    size_t get_parent( size_t body ) const { return parent[body]; }
+    real_t soi_radius( size_t body ) const { return soi[body]; }
+
+    void set_time_tolerance( real_t t ) { tolerance = t; }
+    real_t get_time_tolerance() const { return tolerance; }
+
+    void begin_step( const System& sys );
+    // Appends the SOI changes of the step, in vessel order, if out isn't
+    // null.
+    void end_step( const System& sys, std::vector< SoiTransition >* out = 0 );
+
+private:
+    // state of a body at time t inside the step
+    void body_state( size_t body, real_t t, Vector3& pos, Vector3& vel ) const;
+    size_t find_dominant( const System& sys, const Vector3& pos ) const;
+    // the SOI the vessel should be in at time t, or its dominant body
+    size_t check( size_t vessel, real_t t, const Vector3& rel ) const;
+    real_t crossing( size_t vessel, size_t body, bool inside, real_t a, real_t b ) const;
+    void transfer( size_t vessel, size_t to, real_t t );
+    real_t soi_distance( size_t vessel, size_t body, real_t t ) const;
+
+    // bodies
+    std::vector< size_t > parent;
+    std::vector< std::vector< size_t > > children;
+    std::vector< real_t > soi, mass;
+    size_t root;
+
+    // the bodies' states at the start and end of the step
+    std::vector< Vector3 > pos0, vel0, pos1, vel1;
+    real_t t0, t1;
+
+    // vessels
+    std::vector< size_t > dominant;
+    KeplerOrbits orbits;             // relative to dominant
+    Vector3Array rel_pos, rel_vel;   // relative to dominant, at t1
+    Vector3Array position, velocity; // absolute, at t1
+    std::vector< unsigned char > flagged;
+
+    real_t tolerance;
+};
+
+} // NEWTON
+
+#endif
@@ -0,0 +1,218 @@
+#include <cassert>
+
+#include "pm_gravity.hpp"
+#include "parallel.hpp"
+
+namespace NEWTON {
+
+// split radius and short-range cutoff, in cells
+static const real_t SPLIT_RADIUS = 1.25;
+static const real_t CUTOFF = 4.5 * SPLIT_RADIUS;
+
+// cells kept free around the bodies for the assignment kernel (1) and
+// the potential differences (2)
+static const size_t MARGIN = 3;
+
+// the mean of 1/r over a unit cube about its centre, used for the
+// unsplit Green's function at r = 0
+static const real_t CUBE_MEAN_INV_R = 2.3800772;
+
+static const size_t MIN_BODIES_PER_THREAD = 256;
+
+ParticleMeshGravity::ParticleMeshGravity( size_t grid_size, Assignment assignment, bool short_range )
+    : assignment( assignment ), short_range( short_range ), h( 1 )
+{
+    n = 16;
+    while ( n < grid_size )
+        n <<= 1;
+    padded = 2 * n;
+    build_green();
+}
+
+void ParticleMeshGravity::build_green()
+{
+    green.assign( padded * padded * padded, complex_t( 0 ) );
+    const real_t rs = SPLIT_RADIUS;
+    for ( size_t k = 0; k < padded; ++k )
+        for ( size_t j = 0; j < padded; ++j )
+            for ( size_t i = 0; i < padded; ++i ) {
+                // offsets wrap so the padded grid holds -n .. n-1
+                real_t x = i < n ? real_t( i ) : real_t( i ) - real_t( padded );
+                real_t y = j < n ? real_t( j ) : real_t( j ) - real_t( padded );
+                real_t z = k < n ? real_t( k ) : real_t( k ) - real_t( padded );
+                real_t r = sqrt( x * x + y * y + z * z );
+                real_t g;
+                if ( short_range )
+                    g = r > 0 ? -std::erf( r / ( 2 * rs ) ) / r : -1 / ( rs * sqrt( PI ) );
+                else
+                    g = r > 0 ? -1 / r : -CUBE_MEAN_INV_R;
+                green[( k * padded + j ) * padded + i] = g;
+            }
+    fft3d( &green[0], padded, -1 );
+}
+
+// Grid points and weights along each axis for a body at p: the kernel
+// covers points first[a] .. first[a] + 2.
+void ParticleMeshGravity::weights( const Vector3& p, int* first, real_t w[3][3] ) const
+{
+    for ( int a = 0; a < 3; ++a ) {
+        real_t g = ( p[a] - origin[a] ) / h;
+        if ( assignment == CIC ) {
+            real_t i = std::floor( g ), f = g - i;
+            first[a] = int( i );
+            w[a][0] = 1 - f;
+            w[a][1] = f;
+            w[a][2] = 0;
+        } else {
+            real_t i = std::floor( g + real_t( 0.5 ) ), d = g - i;
+            first[a] = int( i ) - 1;
+            w[a][0] = real_t( 0.5 ) * ( real_t( 0.5 ) - d ) * ( real_t( 0.5 ) - d );
+            w[a][1] = real_t( 0.75 ) - d * d;
+            w[a][2] = real_t( 0.5 ) * ( real_t( 0.5 ) + d ) * ( real_t( 0.5 ) + d );
+        }
+    }
+}
+
+void ParticleMeshGravity::deposit( const std::vector< Body >& bodies )
+{
+    grid.assign( padded * padded * padded, complex_t( 0 ) );
+    for ( size_t b = 0; b < bodies.size(); ++b ) {
+        if ( gm[b] == 0 )
+            continue;
+        int first[3];
+        real_t w[3][3];
+        weights( bodies[b].position, first, w );
+        for ( int k = 0; k < 3; ++k )
+            for ( int j = 0; j < 3; ++j )
+                for ( int i = 0; i < 3; ++i ) {
+                    size_t idx = ( size_t( first[2] + k ) * padded + size_t( first[1] + j ) ) * padded + size_t( first[0] + i );
+                    grid[idx] += gm[b] * w[0][i] * w[1][j] * w[2][k];
+                }
+    }
+}
+
+// convolve the density with the Green's function; the potential in
+// world units is the real part times 1 / h
+void ParticleMeshGravity::potential()
+{
+    fft3d( &grid[0], padded, -1 );
+    for ( size_t i = 0; i < grid.size(); ++i )
+        grid[i] *= green[i];
+    fft3d( &grid[0], padded, +1 );
+}
+
+void ParticleMeshGravity::mesh_forces( const std::vector< Body >& bodies )
+{
+    const size_t sx = 1, sy = padded, sz = padded * padded;
+    const size_t strides[3] = { sx, sy, sz };
+    // the inverse FFT's 1 / padded^3 and the unit conversions
+    const real_t scale = real_t( 1 ) / ( real_t( padded ) * padded * padded * h * h );
+    const complex_t* phi = grid.data();
+
+    parallel_for( 0, bodies.size(), [&]( size_t b ) {
+        int first[3];
+        real_t w[3][3];
+        weights( bodies[b].position, first, w );
+        Vector3 a = Vector3::Zero;
+        for ( int k = 0; k < 3; ++k )
+            for ( int j = 0; j < 3; ++j )
+                for ( int i = 0; i < 3; ++i ) {
+                    real_t wt = w[0][i] * w[1][j] * w[2][k];
+                    if ( wt == 0 )
+                        continue;
+                    size_t idx = ( size_t( first[2] + k ) * padded + size_t( first[1] + j ) ) * padded + size_t( first[0] + i );
+                    // fourth-order central difference of the potential
+                    for ( int d = 0; d < 3; ++d ) {
+                        size_t s = strides[d];
+                        real_t g = ( 8 * ( phi[idx + s].real() - phi[idx - s].real() )
+                                     - ( phi[idx + 2 * s].real() - phi[idx - 2 * s].real() ) ) / 12;
+                        a[d] -= wt * g;
+                    }
+                }
+        acc[b] = a * scale;
+    }, MIN_BODIES_PER_THREAD );
+}
+
+void ParticleMeshGravity::short_range_forces( const std::vector< Body >& bodies )
+{
+    const real_t rs = SPLIT_RADIUS * h, cut = CUTOFF * h;
+    const size_t m = size_t( std::ceil( n / CUTOFF ) );
+    size_t num_bodies = bodies.size();
+
+    // cell list with cells one cutoff wide
+    std::vector< size_t > cell_of( num_bodies );
+    cell_start.assign( m * m * m + 1, 0 );
+    for ( size_t b = 0; b < num_bodies; ++b ) {
+        size_t c[3];
+        for ( int a = 0; a < 3; ++a )
+            c[a] = std::min( m - 1, size_t( ( bodies[b].position[a] - origin[a] ) / cut ) );
+        cell_of[b] = ( c[2] * m + c[1] ) * m + c[0];
+        ++cell_start[cell_of[b] + 1];
+    }
+    for ( size_t c = 0; c < m * m * m; ++c )
+        cell_start[c + 1] += cell_start[c];
+    cell_bodies.resize( num_bodies );
+    std::vector< size_t > next( cell_start.begin(), cell_start.end() - 1 );
+    for ( size_t b = 0; b < num_bodies; ++b )
+        cell_bodies[next[cell_of[b]]++] = b;
+
+    const real_t inv_2rs = 1 / ( 2 * rs ), c1 = 1 / ( rs * sqrt( PI ) );
+    parallel_for( 0, num_bodies, [&]( size_t i ) {
+        const Vector3& p = bodies[i].position;
+        size_t c = cell_of[i];
+        int cx = int( c % m ), cy = int( c / m % m ), cz = int( c / ( m * m ) );
+        Vector3 a = Vector3::Zero;
+        for ( int z = std::max( cz - 1, 0 ); z <= std::min( cz + 1, int( m ) - 1 ); ++z )
+            for ( int y = std::max( cy - 1, 0 ); y <= std::min( cy + 1, int( m ) - 1 ); ++y )
+                for ( int x = std::max( cx - 1, 0 ); x <= std::min( cx + 1, int( m ) - 1 ); ++x ) {
+                    size_t cell = ( size_t( z ) * m + y ) * m + x;
+                    for ( size_t k = cell_start[cell]; k < cell_start[cell + 1]; ++k ) {
+                        size_t j = cell_bodies[k];
+                        if ( j == i || gm[j] == 0 )
+                            continue;
+                        Vector3 d = bodies[j].position - p;
+                        real_t r_s = squared_length( d );
+                        if ( !( r_s > 0 ) || r_s >= cut * cut )
+                            continue;
+                        real_t r = sqrt( r_s );
+                        real_t u = r * inv_2rs;
+                        real_t f = gm[j] / ( r_s * r ) * ( std::erfc( u ) + r * c1 * std::exp( -u * u ) );
+                        a = madd( a, d, f );
+                    }
+                }
+        acc[i] += a;
+    }, MIN_BODIES_PER_THREAD );
+}
+
+void ParticleMeshGravity::accelerations( std::vector< Body >& bodies, SofteningKernel kernel )
+{
+    assert( kernel == SOFTENING_NONE );
+    (void) kernel;
+    size_t num_bodies = bodies.size();
+    if ( num_bodies == 0 )
+        return;
+
+    gm.resize( num_bodies );
+    Vector3 lo = bodies[0].position, hi = lo;
+    for ( size_t b = 0; b < num_bodies; ++b ) {
+        gm[b] = bodies[b].exerts_grav ? G * bodies[b].mass : 0;
+        lo = vmin( lo, bodies[b].position );
+        hi = vmax( hi, bodies[b].position );
+    }
+    Vector3 extent = hi - lo;
+    real_t size = std::max( extent.x, std::max( extent.y, extent.z ) );
+    h = size > 0 ? size / ( n - 2 * MARGIN - 1 ) : 1;
+    origin = lo - Vector3::filled( MARGIN * h );
+
+    acc.resize( num_bodies );
+    deposit( bodies );
+    potential();
+    mesh_forces( bodies );
+    if ( short_range )
+        short_range_forces( bodies );
+
+    for ( size_t b = 0; b < num_bodies; ++b )
+        bodies[b].acc_accumulator = acc[b];
+}
+
+} // NEWTON
@@ -0,0 +1,82 @@
+#ifndef _PM_GRAVITY_HPP_
+#define _PM_GRAVITY_HPP_
+
+#include <vector>
+
+#include "fft.hpp"
+#include "system.hpp"
+
+namespace NEWTON {
+
+/*
+Particle-mesh gravity: masses are spread onto a uniform grid, the
+potential is found by FFT convolution with the Green's function, and
+accelerations are differenced on the grid and interpolated back to the
+bodies. Cost is O(N + n^3 log n) for an n^3 grid, independent of how
+the bodies cluster, which suits dense, roughly uniform distributions.
+
+The grid spans the bodies' bounding cube each call and is zero-padded
+to (2n)^3 for the convolution, so the result is for isolated (not
+periodic) boundaries. Mass assignment is cloud-in-cell (CIC, 8 cells)
+or triangular-shaped cloud (TSC, 27 cells, smoother); the same kernel
+interpolates forces back, which keeps self-forces zero.
+
+Plain PM resolves nothing below a couple of cells. With the short-range
+correction on (P3M), the Green's function is split at r_s = 1.25 cells:
+the mesh carries the smooth part -G erf(r / 2 r_s) / r, and pairs closer
+than 4.5 r_s add the remainder directly,
+
+    G m r_hat / r^2 * ( erfc(r / 2 r_s) + r / (r_s sqrt(pi)) exp(-r^2 / 4 r_s^2) ),
+
+found through a cell list, so forces are close to exact at all
+separations for O(N) extra work at uniform density. For 20000 bodies
+scattered in a cube on a 64^3 grid the RMS relative error is about 0.5%
+with the correction and 20% without; a sun among planets is a poor fit
+(bench/gravity_bench.cpp).
+
+Sources without exerts_grav deposit no mass but still receive forces.
+The grid smooths the field already; no softening kernel is applied.
+*/
+class ParticleMeshGravity : public GravitySolver {
+public:
+    enum Assignment { CIC, TSC };
+
+    // grid_size is rounded up to a power of two
+    explicit ParticleMeshGravity( size_t grid_size = 64, Assignment assignment = TSC, bool short_range = true );
+    virtual ~ParticleMeshGravity() { }
+    virtual void accelerations( std::vector< Body >& bodies, SofteningKernel kernel );
+
+    size_t get_grid_size() const { return n; }
+    Assignment get_assignment() const { return assignment; }
+    bool has_short_range() const { return short_range; }
+
+private:
+    void build_green();
+    void weights( const Vector3& p, int* first, real_t w[3][3] ) const;
+    void deposit( const std::vector< Body >& bodies );
+    void potential();
+    void mesh_forces( const std::vector< Body >& bodies );
+    void short_range_forces( const std::vector< Body >& bodies );
+
+    size_t n;        // cells per side covering the bodies
+    size_t padded;   // 2 n
+    Assignment assignment;
+    bool short_range;
+
+    // FFT of the Green's function in grid units (G = 1, h = 1)
+    std::vector< complex_t > green;
+
+    // per call
+    Vector3 origin;
+    real_t h;
+    std::vector< complex_t > grid;   // density, then potential
+    std::vector< real_t > gm;
+    std::vector< Vector3 > acc;
+
+    // cell list for the short-range pass
+    std::vector< size_t > cell_start, cell_bodies;
+};
+
+} // NEWTON
+
+#endif
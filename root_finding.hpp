@@ -0,0 +1,47 @@
+#ifndef _ROOT_FINDING_HPP_
+#define _ROOT_FINDING_HPP_
+
+#include <utility>
+
+#include "math.hpp"
+
+namespace NEWTON {
+
+// Narrows a sign change of g between a and b, with ga = g(a) and
+// gb = g(b) of opposite signs, until b - a <= tolerance or after
+// max_iterations calls to g. The bracket is updated in place, so the
+// caller can pick the end on the side it wants. a and b may come in
+// either order (a step backwards in time); on return a <= b.
+//
+// Illinois: regula falsi, halving the weight of an end point that is
+// kept twice in a row so the bracket always shrinks from both sides.
+template<typename F>
+void illinois( F g, real_t& a, real_t& ga, real_t& b, real_t& gb, real_t tolerance, int max_iterations = 100 )
+{
+    if ( b < a ) {
+        std::swap( a, b );
+        std::swap( ga, gb );
+    }
+    int side = 0;
+    for ( int it = 0; it < max_iterations && b - a > tolerance; ++it ) {
+        real_t c = ( a * gb - b * ga ) / ( gb - ga );
+        if ( !( c > a && c < b ) )
+            c = ( a + b ) / 2;
+        real_t gc = g( c );
+        if ( ( gc < 0 ) == ( ga < 0 ) ) {
+            a = c; ga = gc;
+            if ( side == -1 )
+                gb /= 2;
+            side = -1;
+        } else {
+            b = c; gb = gc;
+            if ( side == 1 )
+                ga /= 2;
+            side = 1;
+        }
+    }
+}
+
+} // NEWTON
+
+#endif
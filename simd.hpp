@@ -0,0 +1,89 @@
+#ifndef _SIMD_HPP_
+#define _SIMD_HPP_
+
+/*
+Shared setup for kernels with an AVX2/FMA path chosen at runtime.
+
+Functions holding AVX2 intrinsics are marked SIMD_AVX2 and only called
+after use_avx2() returns true, so the rest of the program can be built
+for any x86 CPU (and for other architectures, where SIMD_HAVE_AVX2 is 0
+and only the scalar paths exist).
+*/
+
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 ) || defined( _M_IX86 )
+#define SIMD_HAVE_AVX2 1
+#include <immintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#else
+#define SIMD_HAVE_AVX2 0
+#endif
+
+// GCC and Clang only emit AVX instructions in functions marked for them;
+// MSVC accepts the intrinsics anywhere.
+#if SIMD_HAVE_AVX2 && defined( __GNUC__ )
+#define SIMD_AVX2 __attribute__(( target( "avx2,fma" ) ))
+#else
+#define SIMD_AVX2
+#endif
+
+// AVX2 without FMA, for kernels that must round exactly like scalar
+// code: with FMA enabled, GCC fuses separate multiply and add
+// intrinsics. MSVC never fuses them.
+#if SIMD_HAVE_AVX2 && defined( __GNUC__ )
+#define SIMD_AVX2_NO_FMA __attribute__(( target( "avx2" ) ))
+#else
+#define SIMD_AVX2_NO_FMA
+#endif
+
+namespace NEWTON {
+
+#if SIMD_HAVE_AVX2
+
+inline bool cpu_has_avx2()
+{
+#if defined( __GNUC__ )
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+#elif defined( _MSC_VER )
+    int info[4];
+    __cpuid( info, 0 );
+    if ( info[0] < 7 )
+        return false;
+    __cpuid( info, 1 );
+    bool fma = ( info[2] & ( 1 << 12 ) ) != 0;
+    bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+    bool avx = ( info[2] & ( 1 << 28 ) ) != 0;
+    if ( !fma || !osxsave || !avx || ( _xgetbv( 0 ) & 6 ) != 6 )
+        return false;
+    __cpuidex( info, 7, 0 );
+    return ( info[1] & ( 1 << 5 ) ) != 0;
+#else
+    return false;
+#endif
+}
+
+// sum of the four lanes
+SIMD_AVX2 inline double hsum( __m256d v )
+{
+    __m128d s = _mm_add_pd( _mm256_castpd256_pd128( v ), _mm256_extractf128_pd( v, 1 ) );
+    return _mm_cvtsd_f64( _mm_add_sd( s, _mm_unpackhi_pd( s, s ) ) );
+}
+
+#endif /* SIMD_HAVE_AVX2 */
+
+// True if the AVX2/FMA kernels may run on this CPU.
+inline bool use_avx2()
+{
+#if SIMD_HAVE_AVX2
+    static const bool avx2 = cpu_has_avx2();
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+} /* NEWTON */
+
+#endif /* _SIMD_HPP_ */
@@ -0,0 +1,69 @@
+#ifndef _SOFTENING_HPP_
+#define _SOFTENING_HPP_
+
+#include <cmath>
+
+namespace NEWTON {
+
+/*
+Gravitational softening. A body with softening length eps stands for a
+smoothed mass rather than a point, so the pull of a close or coincident
+pair stays finite and the integrator need not shrink its steps to follow
+a near collision. Worthwhile for collisionless runs with many bodies,
+where close encounters are noise; planets should keep eps = 0.
+
+Each kernel gives the factor f with a = G m d f for an offset d of
+length r:
+
+    SOFTENING_NONE      f = 1 / r^3
+    SOFTENING_PLUMMER   f = 1 / (r^2 + eps^2)^(3/2)
+    SOFTENING_SPLINE    the cubic spline of Monaghan & Lattanzio (1985)
+                        with support h = 2.8 eps, exactly 1 / r^3 for
+                        r >= h (as in Gadget-2)
+
+eps is the Plummer-equivalent length for both, so they agree on the
+potential depth at r = 0. Plummer is cheaper; the spline is Newtonian
+beyond h and so biases the large-scale forces less. A pair uses the
+larger of its two lengths, so forces stay equal and opposite. Pairs at
+zero distance with eps = 0 contribute nothing.
+
+The kernel is a template argument so solvers can pick one outside their
+pair loops and leave the loops free of branches on it.
+*/
+enum SofteningKernel {
+    SOFTENING_NONE,
+    SOFTENING_PLUMMER,
+    SOFTENING_SPLINE
+};
+
+// spline support per unit of Plummer-equivalent softening
+static const double SPLINE_SUPPORT = 2.8;
+
+template<SofteningKernel K, typename T>
+inline T softened_inv_r3( T r_s, T eps )
+{
+    using std::sqrt;
+    const T zero = T( 0 );
+    if ( K == SOFTENING_PLUMMER ) {
+        T s = r_s + eps * eps;
+        return s > zero ? T( 1 ) / ( s * sqrt( s ) ) : zero;
+    }
+    if ( K == SOFTENING_SPLINE ) {
+        T r = sqrt( r_s );
+        T h = T( SPLINE_SUPPORT ) * eps;
+        if ( r < h ) {
+            T inv_h = T( 1 ) / h;
+            T u = r * inv_h;
+            T inv_h3 = inv_h * inv_h * inv_h;
+            if ( u < T( 0.5 ) )
+                return inv_h3 * ( T( 32 ) / T( 3 ) + u * u * ( T( 32 ) * u - T( 38.4 ) ) );
+            return inv_h3 * ( T( 64 ) / T( 3 ) - T( 48 ) * u + T( 38.4 ) * u * u
+                              - T( 32 ) / T( 3 ) * u * u * u - T( 1 ) / ( T( 15 ) * u * u * u ) );
+        }
+    }
+    return r_s > zero ? T( 1 ) / ( r_s * sqrt( r_s ) ) : zero;
+}
+
+} /* NEWTON */
+
+#endif /* _SOFTENING_HPP_ */
@@ -0,0 +1,145 @@
+#include "symmetric_gravity.hpp"
+#include "cache_info.hpp"
+#include "parallel.hpp"
+
+namespace NEWTON {
+
+// test particles per thread
+static const size_t MIN_PARTICLES_PER_THREAD = 64;
+
+template<typename T>
+size_t BasicSymmetricGravity<T>::default_tile_size()
+{
+    return std::max< size_t >( 1, cache_sizes().l1d / 2 / ( 2 * 7 * sizeof( T ) ) );
+}
+
+template<typename T>
+void BasicSymmetricGravity<T>::schedule( size_t tiles )
+{
+    num_tiles = tiles;
+    rounds.clear();
+
+    std::vector< TilePair > diagonal;
+    for ( size_t t = 0; t < tiles; ++t )
+        diagonal.push_back( TilePair( t, t ) );
+    rounds.push_back( diagonal );
+    if ( tiles < 2 )
+        return;
+
+    // circle method: tile m stays put while the rest rotate past it; an
+    // odd count gets a dummy tile, whose partner sits out that round
+    size_t even = tiles + ( tiles & 1 );
+    size_t m = even - 1;
+    for ( size_t r = 0; r < m; ++r ) {
+        std::vector< TilePair > round;
+        if ( m < tiles )
+            round.push_back( TilePair( r, m ) );
+        for ( size_t k = 1; k < even / 2; ++k )
+            round.push_back( TilePair( ( r + k ) % m, ( r + m - k ) % m ) );
+        rounds.push_back( round );
+    }
+}
+
+template<typename T>
+template<SofteningKernel K>
+void BasicSymmetricGravity<T>::tile_pair( size_t a, size_t b, size_t n )
+{
+    using std::max;
+    size_t a0 = a * tile_size, a1 = std::min( n, a0 + tile_size );
+    size_t b0 = b * tile_size, b1 = std::min( n, b0 + tile_size );
+
+    for ( size_t i = a0; i < a1; ++i ) {
+        const T xi = x[i], yi = y[i], zi = z[i], gmi = gm[i], epsi = eps[i];
+        T axi = T( 0 ), ayi = T( 0 ), azi = T( 0 );
+        // within a tile, only pairs with j > i
+        for ( size_t j = a == b ? i + 1 : b0; j < b1; ++j ) {
+            T dx = x[j] - xi, dy = y[j] - yi, dz = z[j] - zi;
+            T r_s = dx * dx + dy * dy + dz * dz;
+            T s = softened_inv_r3<K>( r_s, max( epsi, eps[j] ) );
+            T fi = gm[j] * s, fj = gmi * s;
+            axi += dx * fi; ayi += dy * fi; azi += dz * fi;
+            ax[j] -= dx * fj; ay[j] -= dy * fj; az[j] -= dz * fj;
+        }
+        ax[i] += axi;
+        ay[i] += ayi;
+        az[i] += azi;
+    }
+}
+
+template<typename T>
+template<SofteningKernel K>
+void BasicSymmetricGravity<T>::all_rounds( size_t n )
+{
+    for ( size_t r = 0; r < rounds.size(); ++r ) {
+        const std::vector< TilePair >& round = rounds[r];
+        parallel_for( 0, round.size(), [&]( size_t p ) {
+            tile_pair<K>( round[p].first, round[p].second, n );
+        } );
+    }
+}
+
+// each test particle against every massive body, one way
+template<typename T>
+template<SofteningKernel K>
+void BasicSymmetricGravity<T>::particles( size_t massive, size_t n )
+{
+    parallel_for( massive, n, [&]( size_t i ) {
+        using std::max;
+        const T xi = x[i], yi = y[i], zi = z[i], epsi = eps[i];
+        T axi = T( 0 ), ayi = T( 0 ), azi = T( 0 );
+        for ( size_t j = 0; j < massive; ++j ) {
+            T dx = x[j] - xi, dy = y[j] - yi, dz = z[j] - zi;
+            T r_s = dx * dx + dy * dy + dz * dz;
+            T f = gm[j] * softened_inv_r3<K>( r_s, max( epsi, eps[j] ) );
+            axi += dx * f; ayi += dy * f; azi += dz * f;
+        }
+        ax[i] = axi;
+        ay[i] = ayi;
+        az[i] = azi;
+    }, MIN_PARTICLES_PER_THREAD );
+}
+
+template<typename T>
+void BasicSymmetricGravity<T>::accelerations( std::vector< BasicBody<T> >& bodies, SofteningKernel kernel )
+{
+    size_t n = bodies.size();
+    const T g = T( G );
+    order.clear();
+    for ( size_t i = 0; i < n; ++i )
+        if ( bodies[i].exerts_grav )
+            order.push_back( i );
+    size_t massive = order.size();
+    for ( size_t i = 0; i < n; ++i )
+        if ( !bodies[i].exerts_grav )
+            order.push_back( i );
+
+    x.resize( n ); y.resize( n ); z.resize( n ); gm.resize( n ); eps.resize( n );
+    ax.assign( n, T( 0 ) ); ay.assign( n, T( 0 ) ); az.assign( n, T( 0 ) );
+    for ( size_t k = 0; k < n; ++k ) {
+        const BasicBody<T>& b = bodies[order[k]];
+        x[k] = b.position.x;
+        y[k] = b.position.y;
+        z[k] = b.position.z;
+        gm[k] = k < massive ? g * b.mass : T( 0 );
+        eps[k] = b.softening;
+    }
+
+    size_t tiles = ( massive + tile_size - 1 ) / tile_size;
+    if ( tiles != num_tiles )
+        schedule( tiles );
+
+    switch ( kernel ) {
+    case SOFTENING_PLUMMER: all_rounds<SOFTENING_PLUMMER>( massive ); particles<SOFTENING_PLUMMER>( massive, n ); break;
+    case SOFTENING_SPLINE: all_rounds<SOFTENING_SPLINE>( massive ); particles<SOFTENING_SPLINE>( massive, n ); break;
+    default: all_rounds<SOFTENING_NONE>( massive ); particles<SOFTENING_NONE>( massive, n ); break;
+    }
+
+    for ( size_t k = 0; k < n; ++k )
+        bodies[order[k]].acc_accumulator = Vector<3, T>( ax[k], ay[k], az[k] );
+}
+
+template class BasicSymmetricGravity< float >;
+template class BasicSymmetricGravity< double >;
+template class BasicSymmetricGravity< dd_real >;
+
+} // NEWTON
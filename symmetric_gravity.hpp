@@ -0,0 +1,73 @@
+#ifndef _SYMMETRIC_GRAVITY_HPP_
+#define _SYMMETRIC_GRAVITY_HPP_
+
+#include <utility>
+#include <vector>
+
+#include "system.hpp"
+
+namespace NEWTON {
+
+/*
+Direct summation visiting each unordered pair of massive bodies (those
+with exerts_grav) once. The offset, distance and 1/r^3 of a pair are
+computed once and applied to both bodies with opposite signs, each
+scaled by the other body's G m, so half the work of
+System::direct_gravity. Test particles (exerts_grav false) push nothing
+back, so they are kept apart and each makes one pass over the massive
+bodies afterwards: M x M / 2 plus T x M, never T x T.
+
+Massive bodies are split into tiles of tile_size consecutive bodies, by default
+small enough that two tiles of positions and accelerations stay in L1. Work is
+done one tile pair at a time, in rounds scheduled round-robin so no tile
+appears twice in a round; the pairs of a round run in parallel with no
+two threads ever writing the same body, so there are no locks or atomics
+and the result doesn't depend on the number of threads.
+
+Honours the softening kernel (softening.hpp).
+*/
+template<typename T>
+class BasicSymmetricGravity : public BasicGravitySolver<T> {
+public:
+    BasicSymmetricGravity() : tile_size( default_tile_size() ), num_tiles( 0 ) { }
+    explicit BasicSymmetricGravity( size_t tile_size ) : tile_size( tile_size ), num_tiles( 0 ) { }
+    virtual ~BasicSymmetricGravity() { }
+    virtual void accelerations( std::vector< BasicBody<T> >& bodies, SofteningKernel kernel );
+
+    void set_tile_size( size_t n ) { tile_size = n > 0 ? n : 1; num_tiles = 0; }
+    size_t get_tile_size() const { return tile_size; }
+
+    // two tiles of positions, G m and accelerations in half of L1
+    static size_t default_tile_size();
+
+private:
+    typedef std::pair< size_t, size_t > TilePair;
+
+    void schedule( size_t tiles );
+    template<SofteningKernel K> void all_rounds( size_t n );
+    template<SofteningKernel K> void tile_pair( size_t a, size_t b, size_t n );
+    template<SofteningKernel K> void particles( size_t massive, size_t n );
+
+    size_t tile_size;
+
+    // rounds[r] lists tile pairs that share no tile; the first round is
+    // every tile with itself
+    size_t num_tiles;
+    std::vector< std::vector< TilePair > > rounds;
+
+    // SoA copies of the bodies, massive ones first; order[k] is the
+    // body at position k
+    std::vector< size_t > order;
+    std::vector< T > x, y, z, gm, eps;
+    std::vector< T > ax, ay, az;
+};
+
+typedef BasicSymmetricGravity< real_t > SymmetricGravity;
+
+extern template class BasicSymmetricGravity< float >;
+extern template class BasicSymmetricGravity< double >;
+extern template class BasicSymmetricGravity< dd_real >;
+
+} // NEWTON
+
+#endif
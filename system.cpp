@@ -1,27 +1,35 @@
 #include "system.hpp"
+#include "parallel.hpp"
 
 namespace NEWTON {
 
-const GLdouble G = 6.67384e-11;
+const real_t G = 6.67384e-11;
 
-bool System::initialize()
+// targets per thread in direct_gravity
+static const size_t MIN_TARGETS_PER_THREAD = 64;
+
+template<typename T>
+bool BasicSystem<T>::initialize()
 {
 	return true;
 }
 
-void System::translate(Vector3 const & t) {
+template<typename T>
+void BasicSystem<T>::translate(Vec const & t) {
 	size_t num_part = bodies.size();
 	for ( size_t i = 0; i < num_part; ++i )
 		bodies[i].position += t;
 }
 
-size_t System::add_body(real_t mass, Vector3 const & pos, Vector3 const & vel, bool exerts_grav /* = true */) {
-	Body new_body = {pos, vel, Vector3::Zero, mass, exerts_grav, Vector3(0.0, 0.0, 0.0)};
+template<typename T>
+size_t BasicSystem<T>::add_body(T mass, Vec const & pos, Vec const & vel, bool exerts_grav /* = true */) {
+	Body new_body = {pos, vel, Vec::Zero, mass, exerts_grav, Vec::Zero, T(0), false};
 	bodies.push_back(new_body);
 	return bodies.size()-1;
 }
 
-void System::set_body( size_t index, const Vector3& position, const Vector3& velocity, real_t mass )
+template<typename T>
+void BasicSystem<T>::set_body( size_t index, const Vec& position, const Vec& velocity, T mass )
 {
     assert( index < bodies.size() );
     Body& b = bodies[index];
@@ -30,79 +38,142 @@ void System::set_body( size_t index, const Vector3& position, const Vector3& vel
     b.mass = mass;
 }
 
-size_t System::size() const
+template<typename T>
+size_t BasicSystem<T>::size() const
 {
     return PARTICLE_SIZE * bodies.size();
 }
 
-void System::get_state( real_t* arr, real_t* time ) const
+template<typename T>
+void BasicSystem<T>::get_state( T* arr, T* time ) const
 {
     assert( arr && time );
     size_t num_part = bodies.size();
 
     for ( size_t i = 0; i < num_part; ++i ) {
         size_t idx = PARTICLE_SIZE * i;
-        *(Vector3*)(arr+idx+0) = bodies[i].position;
-        *(Vector3*)(arr+idx+3) = bodies[i].velocity;
+        *(Vec*)(arr+idx+0) = bodies[i].position;
+        *(Vec*)(arr+idx+3) = bodies[i].velocity;
     }
 
     *time = this->time;
 }
 
-void System::set_state( const real_t* arr, const real_t time )
+template<typename T>
+void BasicSystem<T>::set_state( const T* arr, const T time )
 {
     assert( arr );
     size_t num_part = bodies.size();
 
     for ( size_t i = 0; i < num_part; ++i ) {
         size_t idx = PARTICLE_SIZE * i;
-        bodies[i].position = *(Vector3*)(arr+idx+0);
-        bodies[i].velocity = *(Vector3*)(arr+idx+3);
+        bodies[i].position = *(Vec*)(arr+idx+0);
+        bodies[i].velocity = *(Vec*)(arr+idx+3);
     }
 
     this->time = time;
+    if ( rails )
+        rails->apply( bodies, time );
 }
 
-void System::eval_deriv( real_t* deriv_result )
+template<typename T>
+void BasicSystem<T>::direct_gravity()
 {
-    assert( deriv_result );
+    // only bodies that exert gravity are sources, so test particles cost
+    // one pass over the sources each and none over each other
     size_t num_bodies = bodies.size();
-
-    // zero out acceleration
-    for( size_t i = 0; i < num_bodies; i++ ) {
-        bodies[i].acc_accumulator = Vector3::Zero;
+    sources.clear();
+    for(size_t j = 0; j < num_bodies; j++)
+        if(bodies[j].exerts_grav)
+            sources.push_back(j);
+
+    switch(softening_kernel) {
+    case SOFTENING_PLUMMER: direct_gravity_softened<SOFTENING_PLUMMER>(); break;
+    case SOFTENING_SPLINE:  direct_gravity_softened<SOFTENING_SPLINE>(); break;
+    default:                direct_gravity_softened<SOFTENING_NONE>(); break;
     }
+}
 
-	// calculate acceleration due to gravity
-	for(size_t i = 0; i < num_bodies; i++) {
-        double m_i = bodies[i].mass;
-        for(size_t j=0; j < num_bodies; j++) {
+template<typename T>
+template<SofteningKernel K>
+void BasicSystem<T>::direct_gravity_softened()
+{
+    using std::max;
+    size_t num_bodies = bodies.size();
+    size_t num_sources = sources.size();
+    const T g = T(G);
+
+    auto target = [&](size_t i) {
+        Vec acc = Vec::Zero, c = Vec::Zero;
+        if(bodies[i].railed) {
+            bodies[i].acc_accumulator = acc;
+            return;
+        }
+        const T eps_i = bodies[i].softening;
+        for(size_t s = 0; s < num_sources; s++) {
+            size_t j = sources[s];
             if(i == j)
                 continue;
-			if(!bodies[j].exerts_grav)
-				continue;
-			Vector3 r_vec = bodies[j].position - bodies[i].position;
-            double m_j = bodies[j].mass;
-            double r_s = squared_length(r_vec);
-			Vector3 r_hat = normalize(r_vec);
-            bodies[i].acc_accumulator += r_hat * G*m_j/r_s;
+			Vec r_vec = bodies[j].position - bodies[i].position;
+            T m_j = bodies[j].mass;
+            T r_s = squared_length(r_vec);
+            // r_hat * G*m_j/r_s, with the scalars folded into one factor
+            T f = g*m_j*softened_inv_r3<K>(r_s, max(eps_i, bodies[j].softening));
+            if(compensated)
+                compensated_add(acc, c, r_vec*f);
+            else
+                acc = madd(acc, r_vec, f);
         }
-	}
+        bodies[i].acc_accumulator = acc + c;
+    };
+    // the game's handful of bodies: not worth even asking for threads
+    if(num_bodies < 2*MIN_TARGETS_PER_THREAD) {
+        for(size_t i = 0; i < num_bodies; i++)
+            target(i);
+    } else {
+        parallel_for(0, num_bodies, target, MIN_TARGETS_PER_THREAD);
+    }
+}
+
+template<typename T>
+void BasicSystem<T>::eval_deriv( T* deriv_result )
+{
+    assert( deriv_result );
+    size_t num_bodies = bodies.size();
+
+	// bodies on rails go where the rails put them, so their
+	// acceleration is never used
+	for(size_t i = 0; i < num_bodies; i++)
+		bodies[i].railed = rails && rails->on_rails(i, time);
 
-	// calculate acceleration due to thrust
+	// calculate acceleration due to gravity
+	if(gravity)
+		gravity->accelerations(bodies, softening_kernel);
+	else
+		direct_gravity();
+
+	// calculate acceleration due to thrust; massless test particles
+	// can't be pushed
 	for(size_t i = 0; i < num_bodies; i++) {
-		Vector3 & t = bodies[i].thrust;
-		double m = bodies[i].mass;
-		bodies[i].acc_accumulator += t/m;
+		Vec & t = bodies[i].thrust;
+		T m = bodies[i].mass;
+		if(m > T(0) && t != Vec::Zero)
+			bodies[i].acc_accumulator += t/m;
 	}
+	if(thrust_model)
+		thrust_model->accelerations(bodies, time);
 
     // compute derivative
     for ( size_t i = 0; i < num_bodies; ++i ) {
         size_t idx = PARTICLE_SIZE * i;
         const Body& p = bodies[i];
-        *(Vector3*)(deriv_result+idx+0) = p.velocity;
-        *(Vector3*)(deriv_result+idx+3) = p.acc_accumulator;
+        *(Vec*)(deriv_result+idx+0) = p.velocity;
+        *(Vec*)(deriv_result+idx+3) = p.acc_accumulator;
     }
 }
 
-} // NEWTON
\ No newline at end of file
+template class BasicSystem< float >;
+template class BasicSystem< double >;
+template class BasicSystem< dd_real >;
+
+} // NEWTON
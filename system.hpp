@@ -1,15 +1,17 @@
 #ifndef _SYSTEM_HPP_
 #define _SYSTEM_HPP_
 
-#include "SDL.h"
-#include "SDL_opengl.h"
+#include <cassert>
+#include <vector>
 
 #include "vector.hpp"
+#include "compensated.hpp"
+#include "softening.hpp"
 #include "integrator.hpp"
 
 namespace NEWTON {
 
-extern const GLdouble G;
+extern const real_t G;
 
 #define PARTICLE_SIZE 6
 
@@ -25,39 +27,136 @@ extern const GLdouble G;
 #define URANUS    8
 #define NEPTUNE   9
 
-struct Body
+template<typename T>
+struct BasicBody
 { 
+    typedef Vector<3, T> Vec;
+
     // particle members, part of integrator state
-    Vector3 position;
-    Vector3 velocity;
+    Vec position;
+    Vec velocity;
 
     // other info, not part of integrator state
-    Vector3 acc_accumulator;
-    real_t mass;
+    Vec acc_accumulator;
+    T mass;
 	bool exerts_grav;
 //	bool subject_to_grav;
-	Vector3 thrust;
+	Vec thrust;
+    T softening; // Plummer-equivalent length, 0 for a point mass
+    bool railed; // placed by System::rails; set by eval_deriv
+};
+
+// Computes the gravitational part of eval_deriv. An implementation sets
+// every body's acc_accumulator to the acceleration due to all bodies with
+// exerts_grav set; thrust is added by the system afterwards. Bodies
+// with railed set are placed by the system's rails whatever their
+// acceleration, so a solver may skip them as targets and leave them
+// zero (direct_gravity and TiledGravity do). kernel is
+// the system's softening_kernel. Solvers that honour it say so; the rest
+// treat bodies as points and assert that kernel is SOFTENING_NONE.
+template<typename T>
+class BasicGravitySolver {
+public:
+    virtual ~BasicGravitySolver() { }
+    virtual void accelerations( std::vector< BasicBody<T> >& bodies, SofteningKernel kernel ) = 0;
 };
 
-class System : public IntegrableSystem {
+// Adds the accelerations of scheduled engine burns to acc_accumulator,
+// for the system's state at the given time. eval_deriv calls it after
+// gravity and the per-body thrust.
+template<typename T>
+class BasicThrustModel {
 public:
-    virtual ~System() { }
+    virtual ~BasicThrustModel() { }
+    virtual void accelerations( std::vector< BasicBody<T> >& bodies, T time ) = 0;
+};
+
+// Places bodies that follow closed-form trajectories rather than being
+// integrated. set_state calls it after taking the integrator's state, so
+// at every stage and at the end of every step those bodies are wherever
+// apply() puts them for that time.
+template<typename T>
+class BasicRails {
+public:
+    virtual ~BasicRails() { }
+    virtual void apply( std::vector< BasicBody<T> >& bodies, T time ) = 0;
+    // Whether apply() places the body at time. eval_deriv copies it to
+    // Body::railed so gravity isn't computed on bodies it would discard.
+    virtual bool on_rails( size_t, T ) const { return false; }
+};
+
+// An N-body system integrated in scalar type T. The game runs System
+// (real_t); other precisions are for batch runs, see
+// bench/precision_bench.cpp.
+template<typename T>
+class BasicSystem : public BasicIntegrableSystem<T> {
+public:
+    typedef Vector<3, T> Vec;
+    typedef BasicBody<T> Body;
+
+    BasicSystem() : time(0), compensated(false), softening_kernel(SOFTENING_NONE), gravity(0), thrust_model(0), rails(0), generation(0) { }
+    virtual ~BasicSystem() { }
     bool initialize();
-	void translate(Vector3 const & t);
-	size_t add_body(real_t mass, Vector3 const & pos, Vector3 const & vel, bool exerts_grav = true);
-    void set_body( size_t index, const Vector3& position, const Vector3& velocity, real_t mass );
+	void translate(Vec const & t);
+	size_t add_body(T mass, Vec const & pos, Vec const & vel, bool exerts_grav = true);
+    void set_body( size_t index, const Vec& position, const Vec& velocity, T mass );
 
     // integrable system interface
     virtual size_t size() const;
-    virtual void get_state( real_t* arr, real_t* time ) const;
-    virtual void set_state( const real_t* arr, const real_t time );
-    virtual void eval_deriv( real_t* deriv_result );
+    virtual void get_state( T* arr, T* time ) const;
+    virtual void set_state( const T* arr, const T time );
+    virtual void eval_deriv( T* deriv_result );
+    virtual unsigned long force_generation() const { return generation; }
+
+    // Call after changing what the forces depend on without changing the
+    // state, so integrators don't reuse a stale derivative.
+    void forces_changed() { ++generation; }
+
+    // gravity by summing over every ordered pair with an exerting source:
+    // M x M plus T x M for M massive bodies and T test particles
+    // (exerts_grav false, mass may be 0), never T x T
+    void direct_gravity();
+    template<SofteningKernel K> void direct_gravity_softened();
 
 //private:
     std::vector< Body > bodies;
-    real_t time;
+    T time;
+
+    // Sum each body's accelerations with compensated_add. Costs about
+    // four extra flops per pair; worthwhile when many small terms are
+    // added to a few large ones.
+    bool compensated;
+
+    // How bodies' softening lengths shape the pair forces, in
+    // direct_gravity and passed on to gravity; see softening.hpp.
+    SofteningKernel softening_kernel;
+
+    // Solver used for gravity, not owned. Null means the built-in direct
+    // summation over all pairs.
+    BasicGravitySolver<T>* gravity;
+
+    // Scheduled thrust on top of Body::thrust, not owned; may be null.
+    BasicThrustModel<T>* thrust_model;
+
+    // Bodies on rails, not owned; may be null.
+    BasicRails<T>* rails;
+
+    // indices of the bodies with exerts_grav, rebuilt by direct_gravity
+    std::vector< size_t > sources;
+
+    unsigned long generation;
 };
 
+typedef BasicBody< real_t > Body;
+typedef BasicGravitySolver< real_t > GravitySolver;
+typedef BasicThrustModel< real_t > ThrustModel;
+typedef BasicRails< real_t > Rails;
+typedef BasicSystem< real_t > System;
+
+extern template class BasicSystem< float >;
+extern template class BasicSystem< double >;
+extern template class BasicSystem< dd_real >;
+
 } // NEWTON
 
-#endif
\ No newline at end of file
+#endif
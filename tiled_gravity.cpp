@@ -0,0 +1,197 @@
+#include "tiled_gravity.hpp"
+#include "cache_info.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+namespace NEWTON {
+
+// Views of the SoA arrays handed to the tile kernels.
+template<typename T>
+struct SourceArrays
+{
+    const T *x, *y, *z, *gm, *eps;
+};
+
+template<typename T>
+struct TargetArrays
+{
+    const T *x, *y, *z, *eps;
+    T *ax, *ay, *az;
+};
+
+// Adds to a[i] the acceleration from sources [j0, j1) for each target
+// i in [i0, i1).
+template<SofteningKernel K, typename T>
+static void source_tile( const SourceArrays<T>& s, size_t j0, size_t j1,
+                         const TargetArrays<T>& t, size_t i0, size_t i1 )
+{
+    using std::max;
+    for ( size_t i = i0; i < i1; ++i ) {
+        const T xi = t.x[i], yi = t.y[i], zi = t.z[i], epsi = t.eps[i];
+        T axi = T( 0 ), ayi = T( 0 ), azi = T( 0 );
+        for ( size_t j = j0; j < j1; ++j ) {
+            T dx = s.x[j] - xi, dy = s.y[j] - yi, dz = s.z[j] - zi;
+            T r_s = dx * dx + dy * dy + dz * dz;
+            T f = s.gm[j] * softened_inv_r3<K>( r_s, max( epsi, s.eps[j] ) );
+            axi += dx * f; ayi += dy * f; azi += dz * f;
+        }
+        t.ax[i] += axi;
+        t.ay[i] += ayi;
+        t.az[i] += azi;
+    }
+}
+
+#if SIMD_HAVE_AVX2
+
+// softened_inv_r3 four pairs at a time. Every branch of the kernel is
+// evaluated and the lanes blended, so lanes that don't take a branch may
+// hold inf or NaN there without harm.
+template<SofteningKernel K>
+SIMD_AVX2 static inline __m256d avx2_softened_inv_r3( __m256d r_s, __m256d eps )
+{
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd( 1.0 );
+    if ( K == SOFTENING_PLUMMER ) {
+        __m256d s = _mm256_fmadd_pd( eps, eps, r_s );
+        __m256d f = _mm256_div_pd( one, _mm256_mul_pd( s, _mm256_sqrt_pd( s ) ) );
+        return _mm256_and_pd( f, _mm256_cmp_pd( s, zero, _CMP_GT_OQ ) );
+    }
+    __m256d r = _mm256_sqrt_pd( r_s );
+    __m256d f = _mm256_div_pd( one, _mm256_mul_pd( r_s, r ) );
+    f = _mm256_and_pd( f, _mm256_cmp_pd( r_s, zero, _CMP_GT_OQ ) );
+    if ( K == SOFTENING_SPLINE ) {
+        __m256d h = _mm256_mul_pd( _mm256_set1_pd( SPLINE_SUPPORT ), eps );
+        __m256d inv_h = _mm256_div_pd( one, h );
+        __m256d u = _mm256_mul_pd( r, inv_h );
+        __m256d u2 = _mm256_mul_pd( u, u ), u3 = _mm256_mul_pd( u2, u );
+        __m256d inv_h3 = _mm256_mul_pd( _mm256_mul_pd( inv_h, inv_h ), inv_h );
+        // 32/3 + u^2 (32 u - 38.4)
+        __m256d inner = _mm256_fmadd_pd( u2, _mm256_fmsub_pd( _mm256_set1_pd( 32.0 ), u, _mm256_set1_pd( 38.4 ) ),
+                                         _mm256_set1_pd( 32.0 / 3.0 ) );
+        // 64/3 - 48 u + 38.4 u^2 - 32/3 u^3 - 1 / (15 u^3)
+        __m256d outer = _mm256_fmadd_pd( _mm256_set1_pd( -32.0 / 3.0 ), u3,
+                        _mm256_fmadd_pd( _mm256_set1_pd( 38.4 ), u2,
+                        _mm256_fmadd_pd( _mm256_set1_pd( -48.0 ), u, _mm256_set1_pd( 64.0 / 3.0 ) ) ) );
+        outer = _mm256_sub_pd( outer, _mm256_div_pd( one, _mm256_mul_pd( _mm256_set1_pd( 15.0 ), u3 ) ) );
+        __m256d near = _mm256_blendv_pd( outer, inner, _mm256_cmp_pd( u, _mm256_set1_pd( 0.5 ), _CMP_LT_OQ ) );
+        f = _mm256_blendv_pd( f, _mm256_mul_pd( inv_h3, near ), _mm256_cmp_pd( r, h, _CMP_LT_OQ ) );
+    }
+    return f;
+}
+
+// j0 and j1 must be multiples of four
+template<SofteningKernel K>
+SIMD_AVX2 static void avx2_source_tile( const SourceArrays<double>& s, size_t j0, size_t j1,
+                                        const TargetArrays<double>& t, size_t i0, size_t i1 )
+{
+    const __m256d zero = _mm256_setzero_pd();
+    for ( size_t i = i0; i < i1; ++i ) {
+        const __m256d xi = _mm256_set1_pd( t.x[i] ), yi = _mm256_set1_pd( t.y[i] ), zi = _mm256_set1_pd( t.z[i] );
+        const __m256d epsi = _mm256_set1_pd( t.eps[i] );
+        __m256d axi = zero, ayi = zero, azi = zero;
+        for ( size_t j = j0; j < j1; j += 4 ) {
+            __m256d dx = _mm256_sub_pd( _mm256_loadu_pd( s.x + j ), xi );
+            __m256d dy = _mm256_sub_pd( _mm256_loadu_pd( s.y + j ), yi );
+            __m256d dz = _mm256_sub_pd( _mm256_loadu_pd( s.z + j ), zi );
+            __m256d r_s = _mm256_fmadd_pd( dx, dx, _mm256_fmadd_pd( dy, dy, _mm256_mul_pd( dz, dz ) ) );
+            __m256d e = K == SOFTENING_NONE ? zero : _mm256_max_pd( epsi, _mm256_loadu_pd( s.eps + j ) );
+            __m256d f = _mm256_mul_pd( _mm256_loadu_pd( s.gm + j ), avx2_softened_inv_r3<K>( r_s, e ) );
+            axi = _mm256_fmadd_pd( dx, f, axi );
+            ayi = _mm256_fmadd_pd( dy, f, ayi );
+            azi = _mm256_fmadd_pd( dz, f, azi );
+        }
+        t.ax[i] += hsum( axi );
+        t.ay[i] += hsum( ayi );
+        t.az[i] += hsum( azi );
+    }
+}
+
+#endif /* SIMD_HAVE_AVX2 */
+
+template<SofteningKernel K>
+static void source_tile( const SourceArrays<double>& s, size_t j0, size_t j1,
+                         const TargetArrays<double>& t, size_t i0, size_t i1 )
+{
+#if SIMD_HAVE_AVX2
+    if ( use_avx2() )
+        return avx2_source_tile<K>( s, j0, j1, t, i0, i1 );
+#endif
+    source_tile<K, double>( s, j0, j1, t, i0, i1 );
+}
+
+template<typename T>
+GravityTiles BasicTiledGravity<T>::default_tiles()
+{
+    const CacheSizes& c = cache_sizes();
+    GravityTiles t;
+    t.sources = std::max< size_t >( 4, c.l1d / 2 / ( 5 * sizeof( T ) ) / 4 * 4 );
+    t.targets = std::max< size_t >( 1, c.l2 / 2 / ( 7 * sizeof( T ) ) );
+    return t;
+}
+
+template<typename T>
+template<SofteningKernel K>
+void BasicTiledGravity<T>::blocks_pass( size_t n, size_t block, size_t source_tile_size )
+{
+    const SourceArrays<T> s = { sx.data(), sy.data(), sz.data(), sgm.data(), seps.data() };
+    const TargetArrays<T> t = { x.data(), y.data(), z.data(), eps.data(), ax.data(), ay.data(), az.data() };
+    size_t padded = sx.size();
+    size_t blocks = block ? ( n + block - 1 ) / block : 0;
+    parallel_for( 0, blocks, [&]( size_t b ) {
+        size_t i0 = b * block, i1 = std::min( n, i0 + block );
+        for ( size_t j0 = 0; j0 < padded; j0 += source_tile_size )
+            source_tile<K>( s, j0, std::min( padded, j0 + source_tile_size ), t, i0, i1 );
+    } );
+}
+
+template<typename T>
+void BasicTiledGravity<T>::accelerations( std::vector< BasicBody<T> >& bodies, SofteningKernel kernel )
+{
+    const T g = T( G );
+    x.clear(); y.clear(); z.clear(); eps.clear(); targets.clear();
+    sx.clear(); sy.clear(); sz.clear(); sgm.clear(); seps.clear();
+    for ( size_t i = 0; i < bodies.size(); ++i ) {
+        const BasicBody<T>& b = bodies[i];
+        if ( !b.railed ) {
+            targets.push_back( i );
+            x.push_back( b.position.x ); y.push_back( b.position.y ); z.push_back( b.position.z );
+            eps.push_back( b.softening );
+        }
+        if ( b.exerts_grav ) {
+            sx.push_back( b.position.x ); sy.push_back( b.position.y ); sz.push_back( b.position.z );
+            sgm.push_back( g * b.mass );
+            seps.push_back( b.softening );
+        }
+    }
+    size_t n = targets.size();
+    ax.assign( n, T( 0 ) ); ay.assign( n, T( 0 ) ); az.assign( n, T( 0 ) );
+    size_t padded = ( sx.size() + 3 ) / 4 * 4;
+    sx.resize( padded, T( 0 ) ); sy.resize( padded, T( 0 ) ); sz.resize( padded, T( 0 ) );
+    sgm.resize( padded, T( 0 ) ); seps.resize( padded, T( 0 ) );
+
+    size_t block = block_size( n );
+    size_t source_tile_size = std::max< size_t >( 4, tiles.sources / 4 * 4 );
+    switch ( kernel ) {
+    case SOFTENING_PLUMMER: blocks_pass<SOFTENING_PLUMMER>( n, block, source_tile_size ); break;
+    case SOFTENING_SPLINE: blocks_pass<SOFTENING_SPLINE>( n, block, source_tile_size ); break;
+    default: blocks_pass<SOFTENING_NONE>( n, block, source_tile_size ); break;
+    }
+
+    for ( size_t i = 0; i < bodies.size(); ++i )
+        if ( bodies[i].railed )
+            bodies[i].acc_accumulator = Vector<3, T>::Zero;
+    for ( size_t i = 0; i < n; ++i )
+        bodies[targets[i]].acc_accumulator = Vector<3, T>( ax[i], ay[i], az[i] );
+}
+
+template<typename T>
+size_t BasicTiledGravity<T>::block_size( size_t n ) const
+{
+    // at least one block per worker
+    return std::max< size_t >( 1, std::min( tiles.targets, ( n + num_workers() - 1 ) / num_workers() ) );
+}
+
+template class BasicTiledGravity< float >;
+template class BasicTiledGravity< double >;
+template class BasicTiledGravity< dd_real >;
+
+} // NEWTON
@@ -0,0 +1,80 @@
+#ifndef _TILED_GRAVITY_HPP_
+#define _TILED_GRAVITY_HPP_
+
+#include <vector>
+
+#include "system.hpp"
+
+namespace NEWTON {
+
+// Bodies per source tile and per target block.
+struct GravityTiles
+{
+    size_t sources;
+    size_t targets;
+};
+
+/*
+Direct summation blocked for the cache, for N too large for all bodies
+to stay in L1/L2.
+
+Targets are split into blocks, one or more per thread. A block walks
+the sources one tile at a time and applies each tile to every target in
+the block before moving on, so a source tile is read from memory once
+per block rather than once per target and the inner loop runs out of
+L1. With the default tiles the kernel stays compute-bound well past
+1e5 bodies; memory traffic per step is O(N^2 / targets) rather than
+O(N^2).
+
+The default tile sizes come from the cache sizes the OS reports: a
+source tile (position, G m and softening) fills half of L1, a target
+block (position, softening and acceleration) half of L2. For doubles the pair loop runs
+four sources at a time with AVX2 where available.
+
+Honours the softening kernel (softening.hpp), with the kernel fixed per
+call so the pair loops, AVX2 included, stay free of branches on it.
+
+Only bodies with exerts_grav are copied into the source arrays, so test
+particles cost one pass over the massive bodies each: M x M plus T x M,
+never T x T. Railed bodies are left out of the targets and get zero.
+Unsoftened pairs at zero distance, including each body with itself,
+are skipped.
+*/
+template<typename T>
+class BasicTiledGravity : public BasicGravitySolver<T> {
+public:
+    BasicTiledGravity() : tiles( default_tiles() ) { }
+    explicit BasicTiledGravity( const GravityTiles& tiles ) : tiles( tiles ) { }
+    virtual ~BasicTiledGravity() { }
+    virtual void accelerations( std::vector< BasicBody<T> >& bodies, SofteningKernel kernel );
+
+    void set_tiles( const GravityTiles& t ) { tiles = t; }
+    const GravityTiles& get_tiles() const { return tiles; }
+    // Targets per block actually used for n bodies: the configured size,
+    // cut down so every worker gets at least one block.
+    size_t block_size( size_t n ) const;
+
+    static GravityTiles default_tiles();
+
+private:
+    template<SofteningKernel K> void blocks_pass( size_t n, size_t block, size_t source_tile_size );
+
+    GravityTiles tiles;
+
+    // SoA copies of the bodies off rails as targets, and of the exerting
+    // bodies as sources, padded to a multiple of four with massless entries
+    std::vector< size_t > targets; // body index of each target
+    std::vector< T > x, y, z, eps;
+    std::vector< T > ax, ay, az;
+    std::vector< T > sx, sy, sz, sgm, seps;
+};
+
+typedef BasicTiledGravity< real_t > TiledGravity;
+
+extern template class BasicTiledGravity< float >;
+extern template class BasicTiledGravity< double >;
+extern template class BasicTiledGravity< dd_real >;
+
+} // NEWTON
+
+#endif
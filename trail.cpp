@@ -0,0 +1,59 @@
+#include "trail.hpp"
+
+namespace NEWTON {
+
+OrbitTrails::OrbitTrails()
+    : enabled( false ), num_bodies( 0 ), capacity( 0 ), decimation( 1 ), steps( 0 ) { }
+
+void OrbitTrails::configure( size_t n, size_t cap, size_t dec )
+{
+    num_bodies = cap > 0 ? n : 0;
+    capacity = cap;
+    decimation = dec > 0 ? dec : 1;
+    steps = 0;
+
+    std::vector<Vector3>( num_bodies * capacity ).swap( samples );
+    counts.reset( new std::atomic<size_t>[num_bodies] );
+    for ( size_t i = 0; i < num_bodies; ++i )
+        counts[i].store( 0, std::memory_order_relaxed );
+
+    enabled = enabled && capacity > 0;
+}
+
+void OrbitTrails::record( const System& sys )
+{
+    if ( !enabled )
+        return;
+    if ( ++steps < decimation )
+        return;
+    steps = 0;
+
+    size_t n = std::min( num_bodies, sys.bodies.size() );
+    for ( size_t i = 0; i < n; ++i ) {
+        size_t c = counts[i].load( std::memory_order_relaxed );
+        samples[i * capacity + c % capacity] = sys.bodies[i].position;
+        counts[i].store( c + 1, std::memory_order_release );
+    }
+}
+
+size_t OrbitTrails::read( size_t body, size_t first, std::vector<Vector3>& out ) const
+{
+    assert( body < num_bodies );
+    const Vector3* ring = &samples[body * capacity];
+    for ( ;; ) {
+        size_t end = counts[body].load( std::memory_order_acquire );
+        size_t begin = std::max( first, end > capacity ? end - capacity : 0 );
+        out.clear();
+        for ( size_t k = begin; k < end; ++k )
+            out.push_back( ring[k % capacity] );
+
+        // sample k is being overwritten once the count reaches k + capacity
+        std::atomic_thread_fence( std::memory_order_acquire );
+        size_t now = counts[body].load( std::memory_order_relaxed );
+        if ( now < begin + capacity )
+            return begin;
+        first = begin + 1;
+    }
+}
+
+} // NEWTON
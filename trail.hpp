@@ -0,0 +1,70 @@
+#ifndef _TRAIL_HPP_
+#define _TRAIL_HPP_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "system.hpp"
+#include "vector.hpp"
+
+namespace NEWTON {
+
+/*
+Past positions of every body, kept for drawing orbit trails.
+
+Each body owns a fixed ring of `capacity` samples, so memory is bounded
+at capacity * sizeof(Vector3) per body no matter how long the run is.
+record() is called once per simulation step and stores a sample every
+`decimation` steps; when trails are disabled it returns immediately.
+
+The rings are single-producer/single-consumer and lock free: the
+simulation is the only writer and publishes each sample by bumping the
+body's sample count with release ordering. A reader copies samples and
+then re-checks the count, retrying if the writer lapped it meanwhile.
+*/
+class OrbitTrails {
+public:
+    OrbitTrails();
+
+    // Discards all samples and sizes the rings. A capacity of zero
+    // releases the storage and disables recording.
+    void configure( size_t num_bodies, size_t capacity, size_t decimation );
+
+    void set_enabled( bool e ) { enabled = e && capacity > 0; }
+    bool is_enabled() const { return enabled; }
+
+    // Producer side: called after every simulation step.
+    void record( const System& sys );
+
+    size_t get_capacity() const { return capacity; }
+    size_t get_num_bodies() const { return num_bodies; }
+
+    // Total number of samples ever written for a body; the ring holds the
+    // last min(count, capacity) of them.
+    size_t get_count( size_t body ) const {
+        return counts[body].load( std::memory_order_acquire );
+    }
+
+    // Consumer side: copies samples [first, get_count(body)) into out,
+    // clamped to those still in the ring. Returns the index of the first
+    // sample copied.
+    size_t read( size_t body, size_t first, std::vector<Vector3>& out ) const;
+
+private:
+    OrbitTrails( const OrbitTrails& );
+    OrbitTrails& operator=( const OrbitTrails& );
+
+    bool enabled;
+    size_t num_bodies;
+    size_t capacity;
+    size_t decimation;
+    size_t steps;
+
+    std::vector<Vector3> samples; // num_bodies rings of capacity samples
+    std::unique_ptr< std::atomic<size_t>[] > counts;
+};
+
+} // NEWTON
+
+#endif
@@ -0,0 +1,128 @@
+#include "trail_renderer.hpp"
+
+namespace NEWTON {
+
+TrailRenderer::TrailRenderer()
+    : buffer( 0 ), num_bodies( 0 ), capacity( 0 ), stride( 0 ) { }
+
+void TrailRenderer::destroy()
+{
+    if ( buffer )
+        gl_ext.DeleteBuffers( 1, &buffer );
+    buffer = 0;
+    num_bodies = capacity = stride = 0;
+    uploaded.clear();
+    anchors.clear();
+    mirror.clear();
+}
+
+void TrailRenderer::reset( size_t n, size_t cap )
+{
+    destroy();
+    num_bodies = n;
+    capacity = cap;
+    stride = cap + 1;
+    uploaded.assign( n, 0 );
+    anchors.assign( n, Vector3::Zero );
+    mirror.assign( n * stride * 3, 0.0f );
+
+    load_gl_extensions();
+    if ( gl_ext.has_buffers && !mirror.empty() ) {
+        gl_ext.GenBuffers( 1, &buffer );
+        gl_ext.BindBuffer( GL_ARRAY_BUFFER, buffer );
+        gl_ext.BufferData( GL_ARRAY_BUFFER, GLsizeiptr( mirror.size() * sizeof( float ) ), &mirror[0], GL_DYNAMIC_DRAW );
+        gl_ext.BindBuffer( GL_ARRAY_BUFFER, 0 );
+    }
+}
+
+// Sends count slots of a body's mirror, starting at slot, to the GPU.
+void TrailRenderer::upload( size_t body, size_t slot, size_t count )
+{
+    if ( !buffer || count == 0 )
+        return;
+    size_t offset = ( body * stride + slot ) * 3;
+    gl_ext.BufferSubData( GL_ARRAY_BUFFER, GLintptr( offset * sizeof( float ) ),
+                          GLsizeiptr( count * 3 * sizeof( float ) ), &mirror[offset] );
+}
+
+void TrailRenderer::render( const OrbitTrails& trails, const Vector3& eye )
+{
+    if ( !trails.is_enabled() )
+        return;
+    if ( trails.get_num_bodies() != num_bodies || trails.get_capacity() != capacity )
+        reset( trails.get_num_bodies(), trails.get_capacity() );
+    if ( num_bodies == 0 )
+        return;
+
+    if ( buffer )
+        gl_ext.BindBuffer( GL_ARRAY_BUFFER, buffer );
+
+    // pull in whatever was recorded since the last frame
+    for ( size_t b = 0; b < num_bodies; ++b ) {
+        if ( trails.get_count( b ) < uploaded[b] )
+            uploaded[b] = 0; // trails were cleared
+        size_t first = trails.read( b, uploaded[b], scratch );
+        if ( scratch.empty() )
+            continue;
+        if ( uploaded[b] == 0 )
+            anchors[b] = scratch[0];
+
+        float* ring = &mirror[b * stride * 3];
+        size_t run_start = first % capacity;
+        size_t run_length = 0;
+        for ( size_t k = 0; k < scratch.size(); ++k ) {
+            size_t slot = ( first + k ) % capacity;
+            if ( slot == 0 && run_length > 0 ) {
+                upload( b, run_start, run_length );
+                run_start = 0;
+                run_length = 0;
+            }
+            Vector3 p = scratch[k] - anchors[b];
+            ring[3 * slot + 0] = float( p.x );
+            ring[3 * slot + 1] = float( p.y );
+            ring[3 * slot + 2] = float( p.z );
+            if ( slot == 0 ) {
+                ring[3 * capacity + 0] = ring[0];
+                ring[3 * capacity + 1] = ring[1];
+                ring[3 * capacity + 2] = ring[2];
+                upload( b, capacity, 1 );
+            }
+            run_length++;
+        }
+        upload( b, run_start, run_length );
+        uploaded[b] = first + scratch.size();
+    }
+
+    glPushAttrib( GL_ENABLE_BIT | GL_CURRENT_BIT );
+    glColor3f( 0.4f, 0.4f, 0.6f );
+    glEnableClientState( GL_VERTEX_ARRAY );
+    for ( size_t b = 0; b < num_bodies; ++b ) {
+        size_t count = uploaded[b];
+        if ( count < 2 )
+            continue;
+
+        const GLvoid* base = buffer ? (const GLvoid*)( b * stride * 3 * sizeof( float ) )
+                                    : (const GLvoid*)( &mirror[b * stride * 3] );
+        glVertexPointer( 3, GL_FLOAT, 0, base );
+
+        Vector3 offset = anchors[b] - eye;
+        glPushMatrix();
+        glTranslatef( (GLfloat) offset.x, (GLfloat) offset.y, (GLfloat) offset.z );
+        size_t oldest = count > capacity ? count % capacity : 0;
+        if ( count <= capacity || oldest == 0 ) {
+            glDrawArrays( GL_LINE_STRIP, 0, GLsizei( std::min( count, capacity ) ) );
+        } else {
+            // oldest..end, through the duplicate of slot 0, then on to the newest
+            glDrawArrays( GL_LINE_STRIP, GLint( oldest ), GLsizei( capacity + 1 - oldest ) );
+            glDrawArrays( GL_LINE_STRIP, 0, GLsizei( oldest ) );
+        }
+        glPopMatrix();
+    }
+    glDisableClientState( GL_VERTEX_ARRAY );
+    glPopAttrib();
+
+    if ( buffer )
+        gl_ext.BindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+} // NEWTON
@@ -0,0 +1,48 @@
+#ifndef _TRAIL_RENDERER_HPP_
+#define _TRAIL_RENDERER_HPP_
+
+#include <vector>
+
+#include "gl_ext.hpp"
+#include "trail.hpp"
+
+namespace NEWTON {
+
+/*
+Draws OrbitTrails as one line strip per body.
+
+The GPU copy mirrors the rings: each body has capacity + 1 float slots,
+the extra one duplicating slot 0 so a wrapped ring still draws as two
+strips that meet. Only samples recorded since the previous frame are
+uploaded. Samples are stored relative to the body's first sample (its
+anchor) so they stay small enough for float, and each strip is placed
+with a single translation from the anchor to the eye.
+*/
+class TrailRenderer {
+public:
+    TrailRenderer();
+
+    // Must be called with a current context.
+    void render( const OrbitTrails& trails, const Vector3& eye );
+    void destroy();
+
+private:
+    TrailRenderer( const TrailRenderer& );
+    TrailRenderer& operator=( const TrailRenderer& );
+
+    void reset( size_t num_bodies, size_t capacity );
+    void upload( size_t body, size_t slot, size_t count );
+
+    GLuint buffer;
+    size_t num_bodies;
+    size_t capacity;
+    size_t stride;                  // capacity + 1 slots per body
+    std::vector<size_t> uploaded;   // samples seen per body
+    std::vector<Vector3> anchors;
+    std::vector<float> mirror;      // what the GPU buffer holds
+    std::vector<Vector3> scratch;
+};
+
+} // NEWTON
+
+#endif
@@ -2,37 +2,13 @@
 
 namespace NEWTON {
 
-const Vector2 Vector2::Zero = Vector2( 0, 0 );
-const Vector2 Vector2::Ones = Vector2( 1, 1 );
-const Vector2 Vector2::UnitX = Vector2( 1, 0 );
-const Vector2 Vector2::UnitY = Vector2( 0, 1 );
-
-std::ostream& operator<<( std::ostream& os, const Vector2& v )
-{
-    return os << '(' << v.x << ',' << v.y << ')';
-}
-
-const Vector3 Vector3::Zero = Vector3( 0, 0, 0 );
-const Vector3 Vector3::Ones = Vector3( 1, 1, 1 );
-const Vector3 Vector3::UnitX = Vector3( 1, 0, 0 );
-const Vector3 Vector3::UnitY = Vector3( 0, 1, 0 );
-const Vector3 Vector3::UnitZ = Vector3( 0, 0, 1 );
-
-std::ostream& operator<<( std::ostream& os, const Vector3& v )
-{
-    return os << '(' << v.x << ',' << v.y << ',' << v.z << ')';
-}
-
-const Vector4 Vector4::Zero = Vector4( 0, 0, 0, 0 );
-const Vector4 Vector4::Ones = Vector4( 1, 1, 1, 1 );
-const Vector4 Vector4::UnitX = Vector4( 1, 0, 0, 0 );
-const Vector4 Vector4::UnitY = Vector4( 0, 1, 0, 0 );
-const Vector4 Vector4::UnitZ = Vector4( 0, 0, 1, 0 );
-const Vector4 Vector4::UnitW = Vector4( 0, 0, 0, 1 );
-
-std::ostream& operator<<( std::ostream& os, const Vector4& v )
-{
-    return os << '(' << v.x << ',' << v.y << ',' << v.z << ',' << v.w << ')';
-}
-
-} /* NEWTON */
\ No newline at end of file
+// The common instances are compiled once here; vector.hpp declares them
+// extern so other translation units don't instantiate them again.
+template class Vector<2, real_t>;
+template class Vector<3, real_t>;
+template class Vector<4, real_t>;
+template class Vector<2, float>;
+template class Vector<3, float>;
+template class Vector<4, float>;
+
+} /* NEWTON */
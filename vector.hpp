@@ -7,12 +7,21 @@
 #include <cmath>
 #include <iostream>
 
+#if defined( __SSE__ ) || defined( _M_X64 )
+#include <xmmintrin.h>
+#endif
+#if defined( __AVX__ )
+#include <immintrin.h>
+#endif
+
 namespace NEWTON {
 
 /*
-This file defines 3 different vector classes: 2D, 3D, and 4D.
-Each class overrides most sensible operators and have functions
-for other operators such as dot product, length, and normalization.
+This file defines a single vector template, Vector<N, T>, for 2, 3 and
+4 components of any scalar type. Vector2, Vector3 and Vector4 are the
+real_t instances; Vector2f, Vector3f and Vector4f use float. Each
+overrides most sensible operators and there are functions for other
+operations such as dot product, length, and normalization.
 
 All named functions do not mutate their arguments but rather return
 a new vector. So, for example, you must do
@@ -20,490 +29,407 @@ a new vector. So, for example, you must do
 in order to make v a unit vector. Some operators (e.g., +=) mutate
 their first argument, as with built-in numerical types.
 
-Most operations are inline functions because it results in a noticeable
-speed increase in most applications.
-*/
-
-class Vector2
-{
-public:
-	static const size_t DIM = 2;
-    static const Vector2 Zero;
-    static const Vector2 Ones;
-    static const Vector2 UnitX;
-    static const Vector2 UnitY;
-    real_t x, y;
-
-	Vector2() {}
-    Vector2( real_t x, real_t y )
-        : x( x ), y( y ) {}
-
-    // uses default copy and assignment
-
-    Vector2 operator+( const Vector2& rhs ) const {
-        return Vector2( x + rhs.x, y + rhs.y );
-    }
-
-    Vector2& operator+=( const Vector2& rhs ) {
-        x += rhs.x;
-        y += rhs.y;
-        return *this;
-    }
-
-    Vector2 operator-( const Vector2& rhs ) const {
-        return Vector2( x - rhs.x, y - rhs.y );
-    }
+Everything except the functions that need a square root is constexpr,
+so vectors built from constants fold away at compile time. Components
+are stored as plain named members, so an array of Vector3 is a packed
+array of scalars that can be handed to OpenGL or viewed as raw state.
 
-    Vector2& operator-=( const Vector2& rhs ) {
-        x -= rhs.x;
-        y -= rhs.y;
-        return *this;
-    }
-
-    Vector2 operator*( real_t s ) const {
-        return Vector2( x * s, y * s );
-    }
-
-    Vector2& operator*=( real_t s ) {
-        x *= s;
-        y *= s;
-        return *this;
-    }
+madd( a, v, s ) computes a + v * s in one pass. Scalar factors should
+be combined before they touch a vector, i.e. write
+    acc = madd( acc, r, G * m / ( r_s * r_len ) );
+rather than acc += r_hat * G * m / r_s, which costs three vector passes.
 
-    Vector2 operator/( real_t s ) const {
-        real_t inv = 1.0 / s;
-        return Vector2( x * inv, y * inv );
-    }
+Vector4f and (when built with AVX) Vector4 have overloads of the basic
+arithmetic that use one SSE/AVX register per vector. Those overloads
+are not constexpr. Vector3 is deliberately left unpadded so its memory
+layout stays packed.
+*/
 
-    Vector2& operator/=( real_t s ) {
-        real_t inv = 1.0 / s;
-        x *= inv;
-        y *= inv;
-        return *this;
-    }
+template<size_t N, typename T = real_t> class Vector;
 
-    Vector2 operator-() const {
-        return Vector2( -x, -y );
-    }
+// Keeps a scalar parameter out of template argument deduction so that
+// e.g. v / 2 works for any T.
+template<typename T> struct non_deduced { typedef T type; };
 
-    const real_t& operator[]( size_t i ) const {
-        // assumes all members are in a contiguous block
-        assert( i >= 0 && i < DIM );
-        return ( &x )[i];
-    }
+struct VectorFill {};
 
-    real_t& operator[]( size_t i ) {
-        // assumes all members are in a contiguous block
-        assert( i >= 0 && i < DIM );
-        return ( &x )[i];
-    }
+// Component storage, specialized per dimension so components have names.
+template<size_t N, typename T> struct VectorData;
 
-    bool operator==( const Vector2& rhs ) const {
-        return x == rhs.x && y == rhs.y;
-    }
+template<typename T>
+struct VectorData<2, T>
+{
+    T x, y;
 
-    bool operator!=( const Vector2& rhs ) const {
-        return !operator==( rhs );
-    }
+    VectorData() {}
+    constexpr VectorData( T x, T y )
+        : x( x ), y( y ) {}
+    constexpr VectorData( VectorFill, T s )
+        : x( s ), y( s ) {}
 
-    void to_array( float arr[DIM] ) const {
-        arr[0] = float( x );
-        arr[1] = float( y );
-    }
+    constexpr const T& at( size_t i ) const { return i == 0 ? x : y; }
+    constexpr T& at( size_t i ) { return i == 0 ? x : y; }
 };
 
-inline real_t dot( const Vector2& lhs, const Vector2& rhs ) {
-    return lhs.x * rhs.x + lhs.y * rhs.y;
-}
-
-inline real_t squared_length( const Vector2& v ) {
-    return v.x * v.x + v.y * v.y;
-}
-
-inline real_t length( const Vector2& v ) {
-    return sqrt( squared_length( v ) );
-}
+template<typename T>
+struct VectorData<3, T>
+{
+    static const Vector<3, T> UnitZ;
+    T x, y, z;
 
-// Calculate the positive distance between two vectors.
-inline real_t distance( const Vector2& lhs, const Vector2& rhs ) {
-    return length( lhs - rhs );
-}
+    VectorData() {}
+    constexpr VectorData( T x, T y, T z )
+        : x( x ), y( y ), z( z ) {}
+    constexpr VectorData( VectorFill, T s )
+        : x( s ), y( s ), z( s ) {}
 
-inline real_t squared_distance( const Vector2& lhs, const Vector2& rhs ) {
-    return squared_length( lhs - rhs );
-}
+    // Create a vector from a 2d vector.
+    constexpr VectorData( const Vector<2, T>& v, T z )
+        : x( v.x ), y( v.y ), z( z ) { }
 
-// Returns the unit vector pointing in the same direction as this vector.
-inline Vector2 normalize( const Vector2& v ) {
-    return v / length( v );
-}
+    // Create a vector from a float array.
+    explicit VectorData( const float arr[3] )
+        : x( arr[0] ), y( arr[1] ), z( arr[2] ) { }
 
-//Returns a vector whose elements are the absolute values of all the elements of this vector.
-inline Vector2 vabs( const Vector2& v ) {
-    return Vector2( fabs( v.x ), fabs( v.y ) );
-}
+    constexpr const T& at( size_t i ) const { return i == 0 ? x : i == 1 ? y : z; }
+    constexpr T& at( size_t i ) { return i == 0 ? x : i == 1 ? y : z; }
+};
 
-// Returns the element-wise maximum of the two vectors.
-inline Vector2 vmax( const Vector2& lhs, const Vector2& rhs ) {
-    return Vector2(
-        std::max( lhs.x, rhs.x ),
-        std::max( lhs.y, rhs.y )
-    );
-}
+// Four float components fit one SSE register; align them to match.
+template<typename T>
+struct alignas( sizeof( T ) == 4 ? 16 : alignof( T ) ) VectorData<4, T>
+{
+    static const Vector<4, T> UnitZ;
+    static const Vector<4, T> UnitW;
+    T x, y, z, w;
 
-// Returns the element-wise minimum of the two vectors.
-inline Vector2 vmin( const Vector2& lhs, const Vector2& rhs ) {
-    return Vector2(
-        std::min( lhs.x, rhs.x ),
-        std::min( lhs.y, rhs.y )
-    );
-}
+    VectorData() {}
+    constexpr VectorData( T x, T y, T z, T w )
+        : x( x ), y( y ), z( z ), w( w ) {}
+    constexpr VectorData( VectorFill, T s )
+        : x( s ), y( s ), z( s ), w( s ) {}
+    constexpr VectorData( const Vector<3, T>& v, T w )
+        : x( v.x ), y( v.y ), z( v.z ), w( w ) {}
 
-inline Vector2 operator*( real_t s, const Vector2& rhs ) {
-    return rhs * s;
-}
+    // Returns the first three components, ignoring the fourth
+    constexpr Vector<3, T> xyz() const {
+        return Vector<3, T>( x, y, z );
+    }
 
-// Outputs a vector text formatted as "(x,y,z)".
-std::ostream& operator<<( std::ostream& os, const Vector2& rhs );
+    constexpr const T& at( size_t i ) const { return i == 0 ? x : i == 1 ? y : i == 2 ? z : w; }
+    constexpr T& at( size_t i ) { return i == 0 ? x : i == 1 ? y : i == 2 ? z : w; }
+};
 
-class Vector3
+template<size_t N, typename T>
+class Vector : public VectorData<N, T>
 {
 public:
-    static const size_t DIM = 3;
-    static const Vector3 Zero;
-    static const Vector3 Ones;
-    static const Vector3 UnitX;
-    static const Vector3 UnitY;
-    static const Vector3 UnitZ;
-    real_t x, y, z;
-
-    Vector3() {}
-    Vector3( real_t x, real_t y, real_t z )
-        : x( x ), y( y ), z( z ) {}
+    typedef T value_type;
+    static const size_t DIM = N;
+    static const Vector Zero;
+    static const Vector Ones;
+    static const Vector UnitX;
+    static const Vector UnitY;
 
-    // Create a vector from a 2d vector.
-    Vector3( const Vector2& v, real_t z )
-        : x( v.x ), y( v.y ), z( z ) { }
-
-    // Create a vector from a float array.
-    explicit Vector3( const float arr[3] )
-        : x( arr[0] ), y( arr[1] ), z( arr[2] ) { }
+    Vector() {}
+    using VectorData<N, T>::VectorData;
 
     // uses default copy and assignment
 
-    Vector3 operator+( const Vector3& rhs ) const {
-        return Vector3( x + rhs.x, y + rhs.y, z + rhs.z );
-    }
-
-    Vector3& operator+=( const Vector3& rhs ) {
-        x += rhs.x;
-        y += rhs.y;
-        z += rhs.z;
-        return *this;
+    // Returns a vector with every component set to s.
+    static constexpr Vector filled( T s ) {
+        return Vector( VectorFill(), s );
     }
 
-    Vector3 operator-( const Vector3& rhs ) const {
-        return Vector3( x - rhs.x, y - rhs.y, z - rhs.z );
+    // Returns the unit vector along the i-th axis.
+    static constexpr Vector unit( size_t i ) {
+        Vector rv = filled( T( 0 ) );
+        rv[i] = T( 1 );
+        return rv;
     }
 
-    Vector3& operator-=( const Vector3& rhs ) {
-        x -= rhs.x;
-        y -= rhs.y;
-        z -= rhs.z;
+    constexpr Vector& operator+=( const Vector& rhs ) {
+        for ( size_t i = 0; i < N; ++i )
+            ( *this )[i] += rhs[i];
         return *this;
     }
 
-    Vector3 operator*( real_t s ) const {
-        return Vector3( x * s, y * s, z * s );
-    }
-
-    Vector3& operator*=( real_t s ) {
-        x *= s;
-        y *= s;
-        z *= s;
+    constexpr Vector& operator-=( const Vector& rhs ) {
+        for ( size_t i = 0; i < N; ++i )
+            ( *this )[i] -= rhs[i];
         return *this;
     }
 
-    Vector3 operator/( real_t s ) const {
-        real_t inv = 1.0 / s;
-        return Vector3( x * inv, y * inv, z * inv );
+    constexpr Vector& operator*=( T s ) {
+        for ( size_t i = 0; i < N; ++i )
+            ( *this )[i] *= s;
+        return *this;
     }
 
-    Vector3& operator/=( real_t s ) {
-        real_t inv = 1.0 / s;
-        x *= inv;
-        y *= inv;
-        z *= inv;
+    constexpr Vector& operator/=( T s ) {
+        for ( size_t i = 0; i < N; ++i )
+            ( *this )[i] /= s;
         return *this;
     }
 
-    Vector3 operator-() const {
-        return Vector3( -x, -y, -z );
+    constexpr Vector operator-() const {
+        Vector rv( *this );
+        for ( size_t i = 0; i < N; ++i )
+            rv[i] = -rv[i];
+        return rv;
     }
 
-    const real_t& operator[]( size_t i ) const {
-        // assumes all members are in a contiguous block
-        assert( i >= 0 && i < DIM );
-        return ( &x )[i];
+    constexpr const T& operator[]( size_t i ) const {
+        assert( i < DIM );
+        return this->at( i );
     }
 
-    real_t& operator[]( size_t i ) {
-        // assumes all members are in a contiguous block
-        assert( i >= 0 && i < DIM );
-        return ( &x )[i];
+    constexpr T& operator[]( size_t i ) {
+        assert( i < DIM );
+        return this->at( i );
     }
 
-    bool operator==( const Vector3& rhs ) const {
-        return x == rhs.x && y == rhs.y && z == rhs.z;
+    constexpr bool operator==( const Vector& rhs ) const {
+        for ( size_t i = 0; i < N; ++i )
+            if ( ( *this )[i] != rhs[i] )
+                return false;
+        return true;
     }
 
-    bool operator!=( const Vector3& rhs ) const {
+    constexpr bool operator!=( const Vector& rhs ) const {
         return !operator==( rhs );
     }
 
     void to_array( float arr[DIM] ) const {
-        arr[0] = float( x );
-        arr[1] = float( y );
-        arr[2] = float( z );
+        for ( size_t i = 0; i < N; ++i )
+            arr[i] = float( ( *this )[i] );
     }
 };
 
-inline real_t dot( const Vector3& lhs, const Vector3& rhs ) {
-    return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z;
+template<size_t N, typename T> const Vector<N, T> Vector<N, T>::Zero = Vector<N, T>::filled( 0 );
+template<size_t N, typename T> const Vector<N, T> Vector<N, T>::Ones = Vector<N, T>::filled( 1 );
+template<size_t N, typename T> const Vector<N, T> Vector<N, T>::UnitX = Vector<N, T>::unit( 0 );
+template<size_t N, typename T> const Vector<N, T> Vector<N, T>::UnitY = Vector<N, T>::unit( 1 );
+template<typename T> const Vector<3, T> VectorData<3, T>::UnitZ = Vector<3, T>::unit( 2 );
+template<typename T> const Vector<4, T> VectorData<4, T>::UnitZ = Vector<4, T>::unit( 2 );
+template<typename T> const Vector<4, T> VectorData<4, T>::UnitW = Vector<4, T>::unit( 3 );
+
+typedef Vector<2, real_t> Vector2;
+typedef Vector<3, real_t> Vector3;
+typedef Vector<4, real_t> Vector4;
+typedef Vector<2, float> Vector2f;
+typedef Vector<3, float> Vector3f;
+typedef Vector<4, float> Vector4f;
+
+// A Vector3 must be exactly three scalars; System views state arrays as
+// Vector3s and meshes hand their vertices to OpenGL as packed triples.
+static_assert( sizeof( Vector3 ) == 3 * sizeof( real_t ), "Vector3 must be packed" );
+static_assert( sizeof( Vector3f ) == 3 * sizeof( float ), "Vector3f must be packed" );
+
+template<size_t N, typename T>
+constexpr Vector<N, T> operator+( const Vector<N, T>& lhs, const Vector<N, T>& rhs ) {
+    Vector<N, T> rv( lhs );
+    return rv += rhs;
+}
+
+template<size_t N, typename T>
+constexpr Vector<N, T> operator-( const Vector<N, T>& lhs, const Vector<N, T>& rhs ) {
+    Vector<N, T> rv( lhs );
+    return rv -= rhs;
+}
+
+template<size_t N, typename T>
+constexpr Vector<N, T> operator*( const Vector<N, T>& lhs, typename non_deduced<T>::type s ) {
+    Vector<N, T> rv( lhs );
+    return rv *= s;
+}
+
+template<size_t N, typename T>
+constexpr Vector<N, T> operator*( typename non_deduced<T>::type s, const Vector<N, T>& rhs ) {
+    return rhs * s;
+}
+
+template<size_t N, typename T>
+constexpr Vector<N, T> operator/( const Vector<N, T>& lhs, typename non_deduced<T>::type s ) {
+    Vector<N, T> rv( lhs );
+    return rv /= s;
 }
 
-inline Vector3 cross( const Vector3& lhs, const Vector3& rhs ) {
-    return Vector3(
+// Returns a + v * s, the fused form of a scaled accumulate.
+template<size_t N, typename T>
+constexpr Vector<N, T> madd( const Vector<N, T>& a, const Vector<N, T>& v, typename non_deduced<T>::type s ) {
+    Vector<N, T> rv( a );
+    for ( size_t i = 0; i < N; ++i )
+        rv[i] += v[i] * s;
+    return rv;
+}
+
+template<size_t N, typename T>
+constexpr T dot( const Vector<N, T>& lhs, const Vector<N, T>& rhs ) {
+    T rv = lhs[0] * rhs[0];
+    for ( size_t i = 1; i < N; ++i )
+        rv += lhs[i] * rhs[i];
+    return rv;
+}
+
+template<typename T>
+constexpr Vector<3, T> cross( const Vector<3, T>& lhs, const Vector<3, T>& rhs ) {
+    return Vector<3, T>(
         lhs.y * rhs.z - lhs.z * rhs.y,
         lhs.z * rhs.x - lhs.x * rhs.z,
         lhs.x * rhs.y - lhs.y * rhs.x
     );
 }
 
-inline real_t squared_length( const Vector3& v ) {
-    return v.x * v.x + v.y * v.y + v.z * v.z;
+// Returns the 3d vector corresponding to this 4d vector.
+// If w==0, returns (x,y,z).
+template<typename T>
+constexpr Vector<3, T> project( const Vector<4, T>& v ) {
+    T winv = v.w == T( 0 ) ? T( 1 ) : T( 1 ) / v.w;
+    return Vector<3, T>( v.x * winv, v.y * winv, v.z * winv );
 }
 
-inline real_t length( const Vector3& v ) {
+template<size_t N, typename T>
+constexpr T squared_length( const Vector<N, T>& v ) {
+    return dot( v, v );
+}
+
+template<size_t N, typename T>
+inline T length( const Vector<N, T>& v ) {
+    using std::sqrt; // or T's own sqrt, found by argument-dependent lookup
     return sqrt( squared_length( v ) );
 }
 
 // Calculate the positive distance between two vectors.
-inline real_t distance( const Vector3& lhs, const Vector3& rhs ) {
+template<size_t N, typename T>
+inline T distance( const Vector<N, T>& lhs, const Vector<N, T>& rhs ) {
     return length( lhs - rhs );
 }
 
-inline real_t squared_distance( const Vector3& lhs, const Vector3& rhs ) {
+template<size_t N, typename T>
+constexpr T squared_distance( const Vector<N, T>& lhs, const Vector<N, T>& rhs ) {
     return squared_length( lhs - rhs );
 }
 
 // Returns the unit vector pointing in the same direction as this vector.
-inline Vector3 normalize( const Vector3& v ) {
+template<size_t N, typename T>
+inline Vector<N, T> normalize( const Vector<N, T>& v ) {
     return v / length( v );
 }
 
-// Returns a vector whose elements are the absolute values of all the
-inline Vector3 vabs( const Vector3& v ) {
-    return Vector3( fabs( v.x ), fabs( v.y ), fabs( v.z ) );
+// Returns a vector whose elements are the absolute values of all the elements of this vector.
+template<size_t N, typename T>
+constexpr Vector<N, T> vabs( const Vector<N, T>& v ) {
+    Vector<N, T> rv( v );
+    for ( size_t i = 0; i < N; ++i )
+        rv[i] = rv[i] < T( 0 ) ? -rv[i] : rv[i];
+    return rv;
 }
 
 // Returns the element-wise maximum of the two vectors.
-inline Vector3 vmax( const Vector3& lhs, const Vector3& rhs ) {
-    return Vector3(
-        std::max( lhs.x, rhs.x ),
-        std::max( lhs.y, rhs.y ),
-        std::max( lhs.z, rhs.z )
-    );
+template<size_t N, typename T>
+constexpr Vector<N, T> vmax( const Vector<N, T>& lhs, const Vector<N, T>& rhs ) {
+    Vector<N, T> rv( lhs );
+    for ( size_t i = 0; i < N; ++i )
+        rv[i] = std::max( lhs[i], rhs[i] );
+    return rv;
 }
 
 // Returns the element-wise minimum of the two vectors.
-inline Vector3 vmin( const Vector3& lhs, const Vector3& rhs ) {
-    return Vector3(
-        std::min( lhs.x, rhs.x ),
-        std::min( lhs.y, rhs.y ),
-        std::min( lhs.z, rhs.z )
-    );
-}
-
-inline Vector3 operator*( real_t s, const Vector3& rhs ) {
-    return rhs * s;
+template<size_t N, typename T>
+constexpr Vector<N, T> vmin( const Vector<N, T>& lhs, const Vector<N, T>& rhs ) {
+    Vector<N, T> rv( lhs );
+    for ( size_t i = 0; i < N; ++i )
+        rv[i] = std::min( lhs[i], rhs[i] );
+    return rv;
 }
 
 // Outputs a vector text formatted as "(x,y,z)".
-std::ostream& operator<<( std::ostream& os, const Vector3& rhs );
-
-class Vector4
+template<size_t N, typename T>
+std::ostream& operator<<( std::ostream& os, const Vector<N, T>& rhs )
 {
-public:
-    static const size_t DIM = 4;
-    static const Vector4 Zero;
-    static const Vector4 Ones;
-    static const Vector4 UnitX;
-    static const Vector4 UnitY;
-    static const Vector4 UnitZ;
-    static const Vector4 UnitW;
-    real_t x, y, z, w;
-
-    Vector4() {}
-    Vector4( real_t x, real_t y, real_t z, real_t w )
-        : x( x ), y( y ), z( z ), w( w ) {}
-    Vector4( const Vector3& v, real_t w )
-        : x( v.x ), y( v.y ), z( v.z ), w( w ) {}
-
-    // also uses default copy and assignment
-
-    Vector4 operator+( const Vector4& rhs ) const {
-        return Vector4( x + rhs.x, y + rhs.y, z + rhs.z, w + rhs.w );
-    }
-
-    Vector4& operator+=( const Vector4& rhs ) {
-        x += rhs.x;
-        y += rhs.y;
-        z += rhs.z;
-        w += rhs.w;
-        return *this;
-    }
-
-    Vector4 operator-( const Vector4& rhs ) const {
-        return Vector4( x - rhs.x, y - rhs.y, z - rhs.z, w - rhs.w );
-    }
-
-    Vector4& operator-=( const Vector4& rhs ) {
-        x -= rhs.x;
-        y -= rhs.y;
-        z -= rhs.z;
-        w -= rhs.w;
-        return *this;
-    }
-
-    Vector4 operator*( real_t s ) const {
-        return Vector4( x * s, y * s, z * s, w * s );
-    }
-
-    Vector4& operator*=( real_t s ) {
-        x *= s;
-        y *= s;
-        z *= s;
-        w *= s;
-        return *this;
-    }
-
-    Vector4 operator/( real_t s ) const {
-        real_t inv = 1.0 / s;
-        return Vector4( x * inv, y * inv, z * inv, w * inv );
-    }
-
-    Vector4& operator/=( real_t s ) {
-        real_t inv = 1.0 / s;
-        x *= inv;
-        y *= inv;
-        z *= inv;
-        w *= inv;
-        return *this;
-    }
-
-    Vector4 operator-() const {
-        return Vector4( -x, -y, -z, -w );
-    }
-
-    const real_t& operator[]( size_t i ) const {
-        // assumes all members are in a contiguous block
-        assert( i >= 0 && i < DIM );
-        return ( &x )[i];
-    }
-
-    real_t& operator[]( size_t i ) {
-        // assumes all members are in a contiguous block
-        assert( i >= 0 && i < DIM );
-        return ( &x )[i];
-    }
-
-    bool operator==( const Vector4& rhs ) const {
-        return x == rhs.x && y == rhs.y && z == rhs.z && w == rhs.w;
-    }
+    os << '(' << rhs[0];
+    for ( size_t i = 1; i < N; ++i )
+        os << ',' << rhs[i];
+    return os << ')';
+}
 
-    bool operator!=( const Vector4& rhs ) const {
-        return !operator==( rhs );
-    }
+// Register-wide overloads. Being non-templates they win over the generic
+// versions above for these exact types.
 
-    // Returns the first three components, ignoring the fourth
-    Vector3 xyz() const {
-        return Vector3( x, y, z );
-    }
+#if defined( __SSE__ ) || defined( _M_X64 )
+inline __m128 simd_load( const Vector4f& v ) { return _mm_load_ps( &v.x ); }
+inline Vector4f simd_store( __m128 r ) { Vector4f v; _mm_store_ps( &v.x, r ); return v; }
 
-    void to_array( float arr[DIM] ) const {
-        arr[0] = float( x );
-        arr[1] = float( y );
-        arr[2] = float( z );
-        arr[3] = float( w );
-    }
-};
+inline Vector4f operator+( const Vector4f& lhs, const Vector4f& rhs ) {
+    return simd_store( _mm_add_ps( simd_load( lhs ), simd_load( rhs ) ) );
+}
 
-// Returns the 3d vector corresponding to this 4d vector.
-// If w==0, returns (x,y,z).
-inline Vector3 project( const Vector4& v ) {
-    real_t winv = v.w == 0.0 ? 1.0 : 1.0 / v.w;
-    return Vector3( v.x * winv, v.y * winv, v.z * winv );
+inline Vector4f operator-( const Vector4f& lhs, const Vector4f& rhs ) {
+    return simd_store( _mm_sub_ps( simd_load( lhs ), simd_load( rhs ) ) );
 }
 
-inline real_t dot( const Vector4& lhs, const Vector4& rhs ) {
-    return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z + lhs.w * rhs.w;
+inline Vector4f operator*( const Vector4f& lhs, float s ) {
+    return simd_store( _mm_mul_ps( simd_load( lhs ), _mm_set1_ps( s ) ) );
 }
 
-inline real_t squared_length( const Vector4& v ) {
-    return v.x * v.x + v.y * v.y + v.z * v.z + v.w * v.w;
+inline Vector4f operator*( float s, const Vector4f& rhs ) {
+    return rhs * s;
 }
 
-inline real_t length( const Vector4& v ) {
-    return sqrt( squared_length( v ) );
+inline Vector4f madd( const Vector4f& a, const Vector4f& v, float s ) {
+    return simd_store( _mm_add_ps( simd_load( a ), _mm_mul_ps( simd_load( v ), _mm_set1_ps( s ) ) ) );
 }
 
-// Calculate the positive distance between two vectors.
-inline real_t distance( const Vector4& lhs, const Vector4& rhs ) {
-    return length( lhs - rhs );
+inline float dot( const Vector4f& lhs, const Vector4f& rhs ) {
+    __m128 m = _mm_mul_ps( simd_load( lhs ), simd_load( rhs ) );
+    __m128 shuf = _mm_shuffle_ps( m, m, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+    __m128 sums = _mm_add_ps( m, shuf );
+    shuf = _mm_movehl_ps( shuf, sums );
+    return _mm_cvtss_f32( _mm_add_ss( sums, shuf ) );
 }
+#endif
 
-inline real_t squared_distance( const Vector4& lhs, const Vector4& rhs ) {
-    return squared_length( lhs - rhs );
+#if defined( __AVX__ )
+// Vector4 is only 8-byte aligned (std::vector can't promise more before
+// C++17), so these use unaligned loads and stores.
+inline __m256d simd_load( const Vector<4, double>& v ) { return _mm256_loadu_pd( &v.x ); }
+inline Vector<4, double> simd_store( __m256d r ) { Vector<4, double> v; _mm256_storeu_pd( &v.x, r ); return v; }
+
+inline Vector<4, double> operator+( const Vector<4, double>& lhs, const Vector<4, double>& rhs ) {
+    return simd_store( _mm256_add_pd( simd_load( lhs ), simd_load( rhs ) ) );
 }
 
-// Returns the unit vector pointing in the same direction as this vector.
-inline Vector4 normalize( const Vector4& v ) {
-    return v / length( v );
+inline Vector<4, double> operator-( const Vector<4, double>& lhs, const Vector<4, double>& rhs ) {
+    return simd_store( _mm256_sub_pd( simd_load( lhs ), simd_load( rhs ) ) );
 }
 
-// Returns a vector whose elements are the absolute values of all the elements of this vector.
-inline Vector4 vabs( const Vector4& v ) {
-    return Vector4( fabs( v.x ), fabs( v.y ), fabs( v.z ), fabs( v.w ) );
+inline Vector<4, double> operator*( const Vector<4, double>& lhs, double s ) {
+    return simd_store( _mm256_mul_pd( simd_load( lhs ), _mm256_set1_pd( s ) ) );
 }
 
-// Returns the element-wise maximum of the two vectors.
-inline Vector4 vmax( const Vector4& lhs, const Vector4& rhs ) {
-    return Vector4(
-        std::max( lhs.x, rhs.x ),
-        std::max( lhs.y, rhs.y ),
-        std::max( lhs.z, rhs.z ),
-        std::max( lhs.w, rhs.w )
-    );
+inline Vector<4, double> operator*( double s, const Vector<4, double>& rhs ) {
+    return rhs * s;
 }
 
-// Returns the element-wise minimum of the two vectors.
-inline Vector4 vmin( const Vector4& lhs, const Vector4& rhs ) {
-    return Vector4(
-        std::min( lhs.x, rhs.x ),
-        std::min( lhs.y, rhs.y ),
-        std::min( lhs.z, rhs.z ),
-        std::min( lhs.w, rhs.w )
-    );
+inline Vector<4, double> madd( const Vector<4, double>& a, const Vector<4, double>& v, double s ) {
+    return simd_store( _mm256_add_pd( simd_load( a ), _mm256_mul_pd( simd_load( v ), _mm256_set1_pd( s ) ) ) );
 }
 
-inline Vector4 operator*( real_t s, const Vector4& rhs ) {
-    return rhs * s;
+inline double dot( const Vector<4, double>& lhs, const Vector<4, double>& rhs ) {
+    __m256d m = _mm256_mul_pd( simd_load( lhs ), simd_load( rhs ) );
+    __m128d s = _mm_add_pd( _mm256_castpd256_pd128( m ), _mm256_extractf128_pd( m, 1 ) );
+    return _mm_cvtsd_f64( _mm_add_sd( s, _mm_unpackhi_pd( s, s ) ) );
 }
+#endif
 
-// Outputs a vector text formatted as "(x,y,z)".
-std::ostream& operator<<( std::ostream& os, const Vector4& rhs );
+extern template class Vector<2, real_t>;
+extern template class Vector<3, real_t>;
+extern template class Vector<4, real_t>;
+extern template class Vector<2, float>;
+extern template class Vector<3, float>;
+extern template class Vector<4, float>;
 
 } /* NEWTON */
 
-#endif /* _VECTOR_HPP_ */
\ No newline at end of file
+#endif /* _VECTOR_HPP_ */